@@ -0,0 +1,523 @@
+/** Includes. */
+#include "string.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "stdarg.h"
+#include "math.h"
+#include "math_funcs.h"
+#include "program.h"
+#include "aot.h"
+
+#ifdef __unix__
+#include "dlfcn.h"
+#include "unistd.h"
+#include "sys/stat.h"
+#define MP_AOT_NATIVE
+#endif
+
+/** Compiler flags. Contraction is off so results match the interpreter exactly. */
+#define MP_AOT_CFLAGS "-O3 -fPIC -shared -fno-math-errno -ffp-contract=off -fno-builtin-pow"
+
+/** Initial size of the source buffer. */
+#define MP_AOT_SOURCE_INIT_SIZE 4096
+
+/**
+ * C translation of a built-in function.
+ */
+typedef struct
+{
+	/** Function name. */
+	const char* name;
+
+	/** Number of arguments. */
+	size_t argc;
+
+	/** Format string taking the arguments. */
+	const char* format;
+
+} mp_aot_func;
+
+/** Every built-in function the generator can translate. */
+static const mp_aot_func mp_aot_funcs[] =
+{
+	{ "if", 3, "(%s != 0.0 ? %s : %s)" },
+	{ "sqrt", 1, "sqrt(%s)" },
+	{ "exp", 1, "exp(%s)" },
+	{ "log", 1, "log(%s)" },
+	{ "sin", 1, "sin(%s)" },
+	{ "cos", 1, "cos(%s)" },
+	{ "tan", 1, "tan(%s)" },
+	{ "abs", 1, "fabs(%s)" },
+	{ "floor", 1, "floor(%s)" },
+	{ "ceil", 1, "ceil(%s)" },
+	{ "min", 2, "fmin(%s, %s)" },
+	{ "max", 2, "fmax(%s, %s)" },
+};
+
+/** Declarations every generated source starts with. (mp_aot_table must match aot.h) */
+static const char mp_aot_prelude[] =
+	"/* Generated by mp from a compiled program. Do not edit. */\n"
+	"#include <math.h>\n"
+	"#include <stddef.h>\n"
+	"#include <stdint.h>\n"
+	"\n"
+	"#ifdef FP_FAST_FMA\n"
+	"#define MP_FMA(a, b, c) fma(a, b, c)\n"
+	"#else\n"
+	"#define MP_FMA(a, b, c) ((a) * (b) + (c))\n"
+	"#endif\n"
+	"\n"
+	"typedef struct\n"
+	"{\n"
+	"\tuint32_t abi_version;\n"
+	"\tuint32_t var_len;\n"
+	"\tuint32_t out_len;\n"
+	"\tuint64_t hash;\n"
+	"\tvoid (*eval)(const double* vars, double* out);\n"
+	"\tvoid (*eval_batch)(const double* const* vars, size_t rows, double* const* out);\n"
+	"\tdouble (*const* formulas)(const double* vars);\n"
+	"} mp_aot_table;\n";
+
+// Source being generated
+typedef struct
+{
+	/** Characters. (Always null terminated) */
+	char* str;
+
+	/** Number of characters. */
+	size_t len;
+
+	/** Number of characters allocated. */
+	size_t allocated;
+
+} mp_aot_source;
+
+/**
+ * Append formatted text to a source.
+ * @param Source.
+ * @param Format string.
+ * @param Format arguments.
+ */
+static void mp_aot_printf(mp_aot_source* src, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	const int len = vsnprintf(src->str + src->len, src->allocated - src->len, format, args);
+	va_end(args);
+
+	// Grow and try again if it didn't fit
+	if(src->len + (size_t)len >= src->allocated)
+	{
+		while(src->len + (size_t)len >= src->allocated) src->allocated *= 2;
+		src->str = realloc(src->str, src->allocated);
+
+		va_start(args, format);
+		vsnprintf(src->str + src->len, src->allocated - src->len, format, args);
+		va_end(args);
+	}
+
+	src->len += (size_t)len;
+}
+
+/**
+ * Hash a string.
+ * @param String.
+ * @param Length of the string.
+ * @param Hash to continue from.
+ * @return Hash.
+ */
+static uint64_t mp_aot_hash(const char* str, size_t len, uint64_t h)
+{
+	for(size_t i = 0; i < len; ++i)
+	{
+		h ^= (unsigned char)str[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+/**
+ * Find the translation of a built-in function.
+ * @param Index of the function in mp_funcs.
+ * @return Translation, or NULL if there is none.
+ */
+static const mp_aot_func* mp_aot_find_func(size_t func)
+{
+	for(size_t i = 0; i < sizeof(mp_aot_funcs) / sizeof(mp_aot_func); ++i)
+		if(mp_aot_funcs[i].argc == mp_funcs[func].argc && strcmp(mp_aot_funcs[i].name, mp_funcs[func].name) == 0)
+			return &mp_aot_funcs[i];
+
+	return NULL;
+}
+
+/**
+ * Append the statement computing a node.
+ * @param Source.
+ * @param Program.
+ * @param Node index.
+ * @param Set to read variables from per row columns (v0[r], v1[r], ...) instead of v[slot].
+ */
+static void mp_aot_node(mp_aot_source* src, const mp_program* prog, size_t i, char batch)
+{
+	const mp_node* n = &prog->nodes[i];
+	mp_aot_printf(src, "\t\tconst double t%zu = ", i);
+
+	// Operand names
+	char args[MP_NODE_MAX_ARGS][32];
+	for(size_t k = 0; k < mp_node_argc(n); ++k)
+		snprintf(args[k], sizeof(args[k]), "t%zu", n->args[k]);
+
+	switch(n->op)
+	{
+	case MP_TOKEN_NUM:
+		if(isnan(n->val)) mp_aot_printf(src, "NAN");
+		else if(isinf(n->val)) mp_aot_printf(src, n->val < 0.0 ? "-INFINITY" : "INFINITY");
+		else mp_aot_printf(src, "%a", n->val);
+		break;
+
+	case MP_TOKEN_VAR:
+		mp_aot_printf(src, batch ? "v%zu[r]" : "v[%zu]", n->slot);
+		break;
+
+	case MP_TOKEN_NEG: mp_aot_printf(src, "-%s", args[0]); break;
+	case MP_TOKEN_ADD: mp_aot_printf(src, "%s + %s", args[0], args[1]); break;
+	case MP_TOKEN_SUB: mp_aot_printf(src, "%s - %s", args[0], args[1]); break;
+	case MP_TOKEN_MUL: mp_aot_printf(src, "%s * %s", args[0], args[1]); break;
+	case MP_TOKEN_DIV: mp_aot_printf(src, "%s / %s", args[0], args[1]); break;
+	case MP_TOKEN_EXP: mp_aot_printf(src, "pow(%s, %s)", args[0], args[1]); break;
+	case MP_TOKEN_LT: mp_aot_printf(src, "%s < %s", args[0], args[1]); break;
+	case MP_TOKEN_LE: mp_aot_printf(src, "%s <= %s", args[0], args[1]); break;
+	case MP_TOKEN_GT: mp_aot_printf(src, "%s > %s", args[0], args[1]); break;
+	case MP_TOKEN_GE: mp_aot_printf(src, "%s >= %s", args[0], args[1]); break;
+	case MP_TOKEN_EQ: mp_aot_printf(src, "%s == %s", args[0], args[1]); break;
+	case MP_TOKEN_NE: mp_aot_printf(src, "%s != %s", args[0], args[1]); break;
+	case MP_TOKEN_AND: mp_aot_printf(src, "%s != 0.0 && %s != 0.0", args[0], args[1]); break;
+	case MP_TOKEN_OR: mp_aot_printf(src, "%s != 0.0 || %s != 0.0", args[0], args[1]); break;
+	case MP_TOKEN_COL: mp_aot_printf(src, "%s != 0.0 ? %s : %s", args[0], args[1], args[2]); break;
+	case MP_NODE_FMA: mp_aot_printf(src, "MP_FMA(%s, %s, %s)", args[0], args[1], args[2]); break;
+
+	case MP_TOKEN_FUN:
+		mp_aot_printf(src, mp_aot_find_func(n->slot)->format, args[0], args[1], args[2]);
+		break;
+
+	default:
+		mp_aot_printf(src, "0.0");
+		break;
+	}
+
+	mp_aot_printf(src, ";\n");
+}
+
+/**
+ * Mark the nodes an output depends on.
+ * @param Program.
+ * @param Root node of the output.
+ * @param Flag per node. (Set for every node the output depends on)
+ */
+static void mp_aot_mark(const mp_program* prog, size_t root, char* used)
+{
+	used[root] = 1;
+
+	// Operands always come before their users
+	for(size_t i = root + 1; i-- > 0;)
+	{
+		if(!used[i]) continue;
+
+		const mp_node* n = &prog->nodes[i];
+		for(size_t k = 0; k < mp_node_argc(n); ++k)
+			used[n->args[k]] = 1;
+	}
+}
+
+char* mp_aot_generate(const mp_program* prog, size_t* len)
+{
+	// Every function must have a translation. (Numeric builtins run their body in the interpreter)
+	for(size_t i = 0; i < prog->len; ++i)
+		if(
+			(prog->nodes[i].op == MP_TOKEN_FUN && mp_aot_find_func(prog->nodes[i].slot) == NULL) ||
+			MP_NODE_IS_NUMERIC(prog->nodes[i].op)
+		)
+			return NULL;
+
+	mp_aot_source src;
+	src.allocated = MP_AOT_SOURCE_INIT_SIZE;
+	src.str = malloc(src.allocated);
+	src.len = 0;
+	mp_aot_printf(&src, "%s", mp_aot_prelude);
+
+	char* used = malloc(prog->len + 1);
+
+	// One function per output, computing only the nodes it needs
+	for(size_t o = 0; o < prog->out_len; ++o)
+	{
+		memset(used, 0, prog->len + 1);
+		mp_aot_mark(prog, prog->outputs[o], used);
+
+		mp_aot_printf(&src, "\nstatic double mp_formula_%zu(const double* v)\n{\n\t{\n", o);
+		for(size_t i = 0; i < prog->len; ++i)
+			if(used[i]) mp_aot_node(&src, prog, i, 0);
+		mp_aot_printf(&src, "\t\treturn t%zu;\n\t}\n}\n", prog->outputs[o]);
+	}
+
+	// Shared subexpressions are computed once for every output
+	memset(used, 0, prog->len + 1);
+	for(size_t o = 0; o < prog->out_len; ++o)
+		mp_aot_mark(prog, prog->outputs[o], used);
+
+	mp_aot_printf(&src, "\nstatic void mp_eval(const double* v, double* o)\n{\n\t(void)v;\n\t{\n");
+	for(size_t i = 0; i < prog->len; ++i)
+		if(used[i]) mp_aot_node(&src, prog, i, 0);
+	for(size_t o = 0; o < prog->out_len; ++o)
+		mp_aot_printf(&src, "\t\to[%zu] = t%zu;\n", o, prog->outputs[o]);
+	mp_aot_printf(&src, "\t}\n}\n");
+
+	// Batch loop over columns, which the compiler can vectorize
+	mp_aot_printf(&src, "\nstatic void mp_eval_batch(const double* const* v, size_t rows, double* const* o)\n{\n\t(void)v;\n");
+	for(size_t s = 0; s < prog->var_len; ++s)
+		mp_aot_printf(&src, "\tconst double* restrict v%zu = v[%zu];\n", s, s);
+	for(size_t o = 0; o < prog->out_len; ++o)
+		mp_aot_printf(&src, "\tdouble* restrict o%zu = o[%zu];\n", o, o);
+	mp_aot_printf(&src, "\tfor(size_t r = 0; r < rows; ++r)\n\t{\n");
+	for(size_t i = 0; i < prog->len; ++i)
+		if(used[i]) mp_aot_node(&src, prog, i, 1);
+	for(size_t o = 0; o < prog->out_len; ++o)
+		mp_aot_printf(&src, "\t\to%zu[r] = t%zu;\n", o, prog->outputs[o]);
+	mp_aot_printf(&src, "\t}\n}\n");
+
+	// Formula table (NULL terminated, so it is never empty)
+	mp_aot_printf(&src, "\nstatic double (*const mp_formulas[])(const double*) =\n{\n");
+	for(size_t o = 0; o < prog->out_len; ++o)
+		mp_aot_printf(&src, "\tmp_formula_%zu,\n", o);
+	mp_aot_printf(&src, "\tNULL\n};\n");
+
+	free(used);
+	*len = src.len;
+	return src.str;
+}
+
+/**
+ * Get the C compiler command.
+ * @return $CC, or cc if it is unset.
+ */
+static const char* mp_aot_compiler()
+{
+	const char* cc = getenv("CC");
+	return cc != NULL && cc[0] != '\0' ? cc : "cc";
+}
+
+#ifdef MP_AOT_NATIVE
+
+/**
+ * Check that only the current user can change a file.
+ * @param File status.
+ * @return 1 if the file is owned by the current user and not writable by anyone else, 0 otherwise.
+ */
+static char mp_aot_private(const struct stat* st)
+{
+	return st->st_uid == geteuid() && (st->st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+/**
+ * Get the default cache directory, creating it if needed.
+ * @return $XDG_CACHE_HOME/mp-aot, or ~/.cache/mp-aot. (Allocated with malloc)
+ * NULL if there is no home directory.
+ */
+static char* mp_aot_default_cache()
+{
+	// Find the user's cache directory, creating it if needed
+	const char* xdg = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	char* dir;
+	if(xdg != NULL && xdg[0] == '/')
+	{
+		dir = malloc(strlen(xdg) + 16);
+		strcpy(dir, xdg);
+	}
+	else if(home != NULL && home[0] == '/')
+	{
+		dir = malloc(strlen(home) + 16);
+		sprintf(dir, "%s/.cache", home);
+	}
+	else return NULL;
+	mkdir(dir, 0700);
+
+	// Existing directories are checked by the caller
+	strcat(dir, "/mp-aot");
+	mkdir(dir, 0700);
+	return dir;
+}
+
+/**
+ * Load a library and check its function table.
+ * @param Compiled program to store the library in.
+ * @param Library path.
+ * @return 1 if the library was loaded, 0 otherwise.
+ */
+static char mp_aot_load(mp_aot* aot, const char* path)
+{
+	// Only libraries no one else could have written are loaded
+	struct stat st;
+	if(lstat(path, &st) != 0 || !S_ISREG(st.st_mode) || !mp_aot_private(&st)) return 0;
+
+	void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if(handle == NULL) return 0;
+
+	// Stale or foreign libraries are rejected
+	const mp_aot_table* table = dlsym(handle, MP_AOT_SYMBOL);
+	if(
+		table == NULL ||
+		table->abi_version != MP_AOT_ABI_VERSION ||
+		table->hash != aot->hash ||
+		table->var_len != aot->prog->var_len ||
+		table->out_len != aot->prog->out_len
+	)
+	{
+		dlclose(handle);
+		return 0;
+	}
+
+	aot->handle = handle;
+	aot->table = table;
+	return 1;
+}
+
+/**
+ * Build a library with the C compiler.
+ * @param Source.
+ * @param Length of the source.
+ * @param Library path. (Replaced atomically, so concurrent builds are safe)
+ * @return 1 if the library was built, 0 otherwise.
+ */
+static char mp_aot_build(const char* src, size_t len, const char* path)
+{
+	// Build next to the final path under names of our own
+	const size_t path_len = strlen(path);
+	char* src_path = malloc(path_len + 32);
+	char* tmp_path = malloc(path_len + 32);
+	snprintf(src_path, path_len + 32, "%s.%ld.c", path, (long)getpid());
+	snprintf(tmp_path, path_len + 32, "%s.%ld.tmp", path, (long)getpid());
+
+	char ok = 0;
+	FILE* file = fopen(src_path, "wb");
+	if(file != NULL)
+	{
+		ok = fwrite(src, 1, len, file) == len;
+		ok &= fclose(file) == 0;
+	}
+
+	if(ok)
+	{
+		const char* cc = mp_aot_compiler();
+		const size_t cmd_len = strlen(cc) + path_len * 2 + sizeof(MP_AOT_CFLAGS) + 128;
+		char* cmd = malloc(cmd_len);
+		snprintf(cmd, cmd_len, "%s " MP_AOT_CFLAGS " -o '%s' '%s' -lm > /dev/null 2>&1", cc, tmp_path, src_path);
+		ok = system(cmd) == 0 && chmod(tmp_path, 0700) == 0 && rename(tmp_path, path) == 0;
+		free(cmd);
+	}
+
+	remove(src_path);
+	remove(tmp_path);
+	free(src_path);
+	free(tmp_path);
+	return ok;
+}
+
+#endif
+
+mp_aot* mp_aot_create(const mp_program* prog, const char* cache_dir)
+{
+	mp_aot* aot = malloc(sizeof(mp_aot));
+	aot->prog = mp_program_optimize(prog);
+	aot->table = NULL;
+	aot->handle = NULL;
+	aot->hash = 0;
+	aot->cached = 0;
+
+	size_t len;
+	char* src = mp_aot_generate(aot->prog, &len);
+	if(src == NULL) return aot;
+
+	// The hash covers everything that affects the library
+	const char* cc = mp_aot_compiler();
+	uint64_t h = mp_aot_hash(src, len, 14695981039346656037ull);
+	h = mp_aot_hash(cc, strlen(cc), h);
+	h = mp_aot_hash(MP_AOT_CFLAGS, sizeof(MP_AOT_CFLAGS) - 1, h);
+	aot->hash = h;
+
+	// Export the function table
+	mp_aot_source full;
+	full.str = src;
+	full.len = len;
+	full.allocated = len + 1;
+	mp_aot_printf(
+		&full,
+		"\nconst mp_aot_table " MP_AOT_SYMBOL " =\n{\n\t%d,\n\t%zu,\n\t%zu,\n\t0x%016llxull,\n\tmp_eval,\n\tmp_eval_batch,\n\tmp_formulas\n};\n",
+		MP_AOT_ABI_VERSION,
+		aot->prog->var_len,
+		aot->prog->out_len,
+		(unsigned long long)h
+	);
+	src = full.str;
+	len = full.len;
+
+#ifdef MP_AOT_NATIVE
+	char* default_dir = NULL;
+	if(cache_dir == NULL) cache_dir = getenv("MP_AOT_CACHE");
+	if(cache_dir == NULL || cache_dir[0] == '\0') cache_dir = default_dir = mp_aot_default_cache();
+
+	// Libraries are only cached where no one else can add or replace them,
+	// and paths are quoted for the shell
+	struct stat st;
+	if(
+		cache_dir != NULL &&
+		strchr(cache_dir, '\'') == NULL &&
+		stat(cache_dir, &st) == 0 &&
+		S_ISDIR(st.st_mode) &&
+		mp_aot_private(&st)
+	)
+	{
+		const size_t path_len = strlen(cache_dir) + 64;
+		char* path = malloc(path_len);
+		snprintf(path, path_len, "%s/mp-aot-%016llx.so", cache_dir, (unsigned long long)h);
+
+		// Reuse the cached library, or (re)build it
+		aot->cached = mp_aot_load(aot, path);
+		if(!aot->cached && mp_aot_build(src, len, path))
+			mp_aot_load(aot, path);
+
+		free(path);
+	}
+	free(default_dir);
+#else
+	(void)cache_dir;
+#endif
+
+	free(src);
+	return aot;
+}
+
+void mp_aot_destroy(mp_aot* aot)
+{
+#ifdef MP_AOT_NATIVE
+	if(aot->handle != NULL) dlclose(aot->handle);
+#endif
+	mp_program_destroy(aot->prog);
+	free(aot);
+}
+
+void mp_aot_eval(const mp_aot* aot, const double* vars, double* out)
+{
+	if(aot->table != NULL) aot->table->eval(vars, out);
+	else mp_program_eval(aot->prog, vars, out);
+}
+
+void mp_aot_eval_batch(
+	const mp_aot* aot,
+	const double* const* vars,
+	size_t rows,
+	double* const* out
+)
+{
+	if(aot->table != NULL) aot->table->eval_batch(vars, rows, out);
+	else mp_program_eval_batch(aot->prog, vars, rows, out);
+}
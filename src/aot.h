@@ -0,0 +1,125 @@
+#ifndef MP_AOT_H
+#define MP_AOT_H
+
+/**
+ * Ahead-of-time compiled programs. A program is translated into C, with
+ * one function per output plus functions evaluating every output for a row
+ * or a batch of rows, and built into a shared library with the system C
+ * compiler ($CC, or cc). The library is loaded back with dlopen through a
+ * single function table (See mp_aot_table) and cached by a hash of its
+ * source, so later runs with the same program skip the compiler.
+ * Programs which can't be built (No compiler, no dlopen, or functions the
+ * generator doesn't know) are evaluated by the interpreter instead.
+ */
+
+/** Includes. */
+#include "stddef.h"
+#include "stdint.h"
+#include "program.h"
+
+/** Version of mp_aot_table. Libraries built for another version are rebuilt. */
+#define MP_AOT_ABI_VERSION 1
+
+/** Name of the function table exported by generated libraries. */
+#define MP_AOT_SYMBOL "mp_aot_entry"
+
+// Function table exported by generated libraries. (Fields are only ever appended)
+typedef struct
+{
+	/** Version of the table. (MP_AOT_ABI_VERSION) */
+	uint32_t abi_version;
+
+	/** Number of variable slots. */
+	uint32_t var_len;
+
+	/** Number of outputs. */
+	uint32_t out_len;
+
+	/** Hash of the generated source. */
+	uint64_t hash;
+
+	/**
+	 * Evaluate every output for a single set of variable values.
+	 * (Same arguments as mp_program_eval)
+	 */
+	void (*eval)(const double* vars, double* out);
+
+	/**
+	 * Evaluate every output for many sets of variable values.
+	 * (Same arguments as mp_program_eval_batch)
+	 */
+	void (*eval_batch)(const double* const* vars, size_t rows, double* const* out);
+
+	/** One function per output, computing only that output. Indexed by output. */
+	double (*const* formulas)(const double* vars);
+
+} mp_aot_table;
+
+// Ahead-of-time compiled program
+typedef struct
+{
+	/** Optimized copy of the program. Evaluated directly when there is no library. */
+	mp_program* prog;
+
+	/** Function table of the loaded library, or NULL when falling back to the interpreter. */
+	const mp_aot_table* table;
+
+	/** Library handle, or NULL. */
+	void* handle;
+
+	/** Hash of the generated source. (0 if no source was generated) */
+	uint64_t hash;
+
+	/** Set if the library was loaded from the cache instead of being built. */
+	char cached;
+
+} mp_aot;
+
+/**
+ * Generate the C source of a program.
+ * @param Program.
+ * @param Pointer to write the length of the source to.
+ * @return Source (Allocated with malloc, must be freed), or NULL if the
+ * program uses a function the generator can't translate or a numeric builtin.
+ */
+extern char* mp_aot_generate(const mp_program* prog, size_t* len);
+
+/**
+ * Compile a program ahead of time, reusing a cached library if there is one.
+ * @param Program. (Copied)
+ * @param Directory to cache libraries in, or NULL for $MP_AOT_CACHE. (Or $XDG_CACHE_HOME/mp-aot,
+ * ~/.cache/mp-aot if unset, created with mode 0700) Nothing is cached unless the directory is
+ * owned by the current user and not writable by anyone else.
+ * @return New compiled program. Falls back to the interpreter if the library can't be built or loaded.
+ * @note Must be destroyed with mp_aot_destroy.
+ */
+extern mp_aot* mp_aot_create(const mp_program* prog, const char* cache_dir);
+
+/**
+ * Destroy a compiled program, unloading its library.
+ * @param Compiled program.
+ */
+extern void mp_aot_destroy(mp_aot* aot);
+
+/**
+ * Evaluate every output of a compiled program for a single set of variable values.
+ * @param Compiled program.
+ * @param Variable values, indexed by slot.
+ * @param Array to write the outputs to, indexed by output.
+ */
+extern void mp_aot_eval(const mp_aot* aot, const double* vars, double* out);
+
+/**
+ * Evaluate every output of a compiled program for many sets of variable values.
+ * @param Compiled program.
+ * @param Variable columns, indexed by slot. Each column holds one value per row.
+ * @param Number of rows.
+ * @param Output columns, indexed by output. Each column receives one value per row.
+ */
+extern void mp_aot_eval_batch(
+	const mp_aot* aot,
+	const double* const* vars,
+	size_t rows,
+	double* const* out
+);
+#endif
@@ -0,0 +1,1091 @@
+/** Includes. */
+#include "string.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "time.h"
+#include "parser.h"
+#include "program.h"
+#include "script.h"
+#include "symbols.h"
+#include "server.h"
+#include "tiered.h"
+#include "csv.h"
+#include "check.h"
+#include "aot.h"
+#include "bench.h"
+
+#ifdef __linux__
+#include "pthread.h"
+#include "unistd.h"
+#include "sys/socket.h"
+#include "sys/un.h"
+#include "sys/stat.h"
+#endif
+
+/** Number of rows evaluated per benchmark run. */
+#define MP_BENCH_ROWS (1 << 20)
+
+/** Number of times each benchmark run is repeated. */
+#define MP_BENCH_REPEATS 10
+
+/** Number of terms in the program lexed by the tokens benchmark. (12 tokens each) */
+#define MP_BENCH_TOKEN_TERMS 1000000
+
+/** Number of lines in the model run by the script benchmark. */
+#define MP_BENCH_SCRIPT_LINES 10000
+
+/** Number of formulas validated by the check benchmark. */
+#define MP_BENCH_CHECK_FORMULAS (1 << 20)
+
+/** Number of rows in the file evaluated by the csv benchmark. */
+#define MP_BENCH_CSV_ROWS (1 << 22)
+
+/** Number of rows evaluated by the numeric benchmark. */
+#define MP_BENCH_NUMERIC_ROWS 200
+
+/** Number of load generator clients. */
+#define MP_BENCH_CLIENTS 8
+
+/** Number of requests sent by each load generator client. */
+#define MP_BENCH_CLIENT_REQUESTS 20000
+
+/** Maximum number of unanswered requests per load generator client. */
+#define MP_BENCH_CLIENT_WINDOW 32
+
+// Benchmark data type
+typedef struct
+{
+	/** Benchmark name. */
+	const char* name;
+	
+	/** Benchmark function. */
+	void (*func)(void);
+	
+} mp_bench;
+
+/**
+ * Get the current wall clock time.
+ * @return Time in seconds.
+ */
+static double mp_bench_time()
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Compare single and double precision batch evaluation.
+ */
+static void mp_bench_precision()
+{
+	// Formulas to benchmark
+	const char* exprs[] =
+	{
+		"x * y + 1",
+		"sqrt(x * x + y * y)",
+		"x > 0.5 ? x * y : y - x",
+		"a * x^3 + b * x^2 + c * x + d",
+		"exp(-x) * sin(y)",
+	};
+	const size_t expr_count = sizeof(exprs) / sizeof(exprs[0]);
+	
+	printf("%-32s %10s %10s %10s %12s %12s\n", "precision", "f64 Mr/s", "f32 Mr/s", "mix Mr/s", "f32 err", "mix err");
+	
+	for(size_t e = 0; e < expr_count; ++e)
+	{
+		mp_program* prog = mp_program_create();
+		mp_program_add(prog, exprs[e]);
+		
+		// Fill every variable with the same random values in both precisions
+		double** vars = malloc(sizeof(double*) * (prog->var_len + 1));
+		float** vars_f = malloc(sizeof(float*) * (prog->var_len + 1));
+		srand(1);
+		for(size_t i = 0; i < prog->var_len; ++i)
+		{
+			vars[i] = malloc(sizeof(double) * MP_BENCH_ROWS);
+			vars_f[i] = malloc(sizeof(float) * MP_BENCH_ROWS);
+			for(size_t j = 0; j < MP_BENCH_ROWS; ++j)
+			{
+				vars_f[i][j] = (float)rand() / (float)RAND_MAX;
+				vars[i][j] = vars_f[i][j];
+			}
+		}
+		
+		// Output columns
+		double* out = malloc(sizeof(double) * MP_BENCH_ROWS);
+		float* out_f = malloc(sizeof(float) * MP_BENCH_ROWS);
+		float* out_m = malloc(sizeof(float) * MP_BENCH_ROWS);
+		
+		// Time every precision
+		double t[3];
+		for(size_t p = 0; p < 3; ++p)
+		{
+			const double start = mp_bench_time();
+			for(size_t r = 0; r < MP_BENCH_REPEATS; ++r)
+			{
+				if(p == 0)
+					mp_program_eval_batch(prog, (const double* const*)vars, MP_BENCH_ROWS, &out);
+				else
+					mp_program_eval_batch_f32(
+						prog,
+						(const float* const*)vars_f,
+						MP_BENCH_ROWS,
+						p == 1 ? &out_f : &out_m,
+						p == 1 ? MP_PRECISION_SINGLE : MP_PRECISION_MIXED
+					);
+			}
+			t[p] = mp_bench_time() - start;
+		}
+		
+		// Largest relative error against double precision
+		double err_f = 0.0;
+		double err_m = 0.0;
+		for(size_t j = 0; j < MP_BENCH_ROWS; ++j)
+		{
+			const double scale = fabs(out[j]) > 1e-30 ? fabs(out[j]) : 1e-30;
+			err_f = fmax(err_f, fabs(out_f[j] - out[j]) / scale);
+			err_m = fmax(err_m, fabs(out_m[j] - out[j]) / scale);
+		}
+		
+		const double rows = (double)MP_BENCH_ROWS * MP_BENCH_REPEATS * 1e-6;
+		printf(
+			"%-32s %10.1f %10.1f %10.1f %12.3e %12.3e\n",
+			exprs[e],
+			rows / t[0],
+			rows / t[1],
+			rows / t[2],
+			err_f,
+			err_m
+		);
+		
+		// Cleanup
+		for(size_t i = 0; i < prog->var_len; ++i)
+		{
+			free(vars[i]);
+			free(vars_f[i]);
+		}
+		free(vars);
+		free(vars_f);
+		free(out);
+		free(out_f);
+		free(out_m);
+		mp_program_destroy(prog);
+	}
+}
+
+/**
+ * Compare batch evaluation of polynomials as written and rewritten.
+ */
+static void mp_bench_poly()
+{
+	// Formulas to benchmark
+	const char* exprs[] =
+	{
+		"a * x^3 + b * x^2 + c * x + d",
+		"3 * x^5 - 2 * x^4 + x^3 / 7 + 5 * x^2 - x + 1",
+		"1 + x + x^2 / 2 + x^3 / 6 + x^4 / 24 + x^5 / 120 + x^6 / 720 + x^7 / 5040 + x^8 / 40320",
+		"sqrt(y^2 + 2 * y + 5) * (x^4 - 3 * x^2 + 2)",
+	};
+	const size_t expr_count = sizeof(exprs) / sizeof(exprs[0]);
+	
+	printf("%-32s %10s %10s %10s %12s %12s\n", "poly", "orig Mr/s", "hrnr Mr/s", "estr Mr/s", "hrnr err", "estr err");
+	
+	for(size_t e = 0; e < expr_count; ++e)
+	{
+		mp_program* progs[3];
+		progs[0] = mp_program_create();
+		mp_program_add(progs[0], exprs[e]);
+		progs[1] = mp_program_rewrite_polynomials(progs[0], MP_POLY_HORNER);
+		progs[2] = mp_program_rewrite_polynomials(progs[0], MP_POLY_ESTRIN);
+		
+		// Fill every variable with random values in [-1, 1]
+		const size_t var_len = progs[0]->var_len;
+		double** vars = malloc(sizeof(double*) * (var_len + 1));
+		srand(1);
+		for(size_t i = 0; i < var_len; ++i)
+		{
+			vars[i] = malloc(sizeof(double) * MP_BENCH_ROWS);
+			for(size_t j = 0; j < MP_BENCH_ROWS; ++j)
+				vars[i][j] = 2.0 * (double)rand() / (double)RAND_MAX - 1.0;
+		}
+		
+		// Time every form
+		double* outs[3];
+		double t[3];
+		for(size_t p = 0; p < 3; ++p)
+		{
+			outs[p] = malloc(sizeof(double) * MP_BENCH_ROWS);
+			const double start = mp_bench_time();
+			for(size_t r = 0; r < MP_BENCH_REPEATS; ++r)
+				mp_program_eval_batch(progs[p], (const double* const*)vars, MP_BENCH_ROWS, &outs[p]);
+			t[p] = mp_bench_time() - start;
+		}
+		
+		// Largest relative error against the formula as written
+		double err[3] = { 0.0, 0.0, 0.0 };
+		for(size_t p = 1; p < 3; ++p)
+			for(size_t j = 0; j < MP_BENCH_ROWS; ++j)
+			{
+				const double scale = fabs(outs[0][j]) > 1e-30 ? fabs(outs[0][j]) : 1e-30;
+				err[p] = fmax(err[p], fabs(outs[p][j] - outs[0][j]) / scale);
+			}
+		
+		const double rows = (double)MP_BENCH_ROWS * MP_BENCH_REPEATS * 1e-6;
+		printf(
+			"%-32.32s %10.1f %10.1f %10.1f %12.3e %12.3e\n",
+			exprs[e],
+			rows / t[0],
+			rows / t[1],
+			rows / t[2],
+			err[1],
+			err[2]
+		);
+		
+		// Cleanup
+		for(size_t i = 0; i < var_len; ++i)
+			free(vars[i]);
+		free(vars);
+		for(size_t p = 0; p < 3; ++p)
+		{
+			free(outs[p]);
+			mp_program_destroy(progs[p]);
+		}
+	}
+}
+
+/** Number of single evaluations per tier in the tiering benchmark. */
+#define MP_BENCH_EVALS 2000000
+
+/**
+ * Compare single evaluations at every tier of a tiered expression.
+ */
+static void mp_bench_tiered()
+{
+	// Formulas to benchmark
+	const char* exprs[] =
+	{
+		"x * y + 1",
+		"sqrt(x * x + y * y)",
+		"x > 0.5 ? x * y : y - x",
+		"a * x^3 + b * x^2 + c * x + d",
+		"(x * 2 * 1 + 0) ^ 2 - 3 * 4 * y",
+	};
+	const size_t expr_count = sizeof(exprs) / sizeof(exprs[0]);
+	
+	printf("%-32s %10s %10s %10s %12s\n", "tiered", "t0 ns", "t1 ns", "t2 ns", "max diff");
+	
+	for(size_t e = 0; e < expr_count; ++e)
+	{
+		// One expression held at every tier
+		mp_tiered* tiers[3];
+		for(int t = 0; t < 3; ++t)
+		{
+			mp_tier_policy policy = mp_tier_default_policy();
+			policy.max_tier = t;
+			tiers[t] = mp_tiered_create(exprs[e], &policy);
+			mp_tiered_promote(tiers[t], t);
+		}
+		
+		// Random variable values, cycled through while evaluating
+		const size_t var_len = mp_tiered_var_count(tiers[0]);
+		double* vars = malloc(sizeof(double) * (var_len + 1) * 1024);
+		srand(1);
+		for(size_t i = 0; i < var_len * 1024; ++i)
+			vars[i] = (double)rand() / (double)RAND_MAX;
+		
+		// Time every tier
+		double t[3];
+		double sums[3];
+		for(int tier = 0; tier < 3; ++tier)
+		{
+			sums[tier] = 0.0;
+			const double start = mp_bench_time();
+			for(size_t i = 0; i < MP_BENCH_EVALS; ++i)
+				sums[tier] += mp_tiered_eval(tiers[tier], &vars[(i & 1023) * var_len]);
+			t[tier] = mp_bench_time() - start;
+		}
+		
+		// Largest difference between the tiers
+		double diff = 0.0;
+		for(size_t i = 0; i < 1024; ++i)
+		{
+			const double r = mp_tiered_eval(tiers[0], &vars[i * var_len]);
+			diff = fmax(diff, fabs(mp_tiered_eval(tiers[1], &vars[i * var_len]) - r));
+			diff = fmax(diff, fabs(mp_tiered_eval(tiers[2], &vars[i * var_len]) - r));
+		}
+		
+		printf(
+			"%-32s %10.1f %10.1f %10.1f %12.3e\n",
+			exprs[e],
+			t[0] * 1e9 / MP_BENCH_EVALS,
+			t[1] * 1e9 / MP_BENCH_EVALS,
+			t[2] * 1e9 / MP_BENCH_EVALS,
+			diff
+		);
+		
+		// Cleanup
+		free(vars);
+		for(int tier = 0; tier < 3; ++tier)
+			mp_tiered_destroy(tiers[tier]);
+	}
+	
+	// Show automatic promotion with a background thread
+	mp_tier_policy policy = mp_tier_default_policy();
+	policy.background = 1;
+	mp_tiered* expr = mp_tiered_create("x * y + 1", &policy);
+	const double vars[2] = { 2.0, 3.0 };
+	int tier = mp_tiered_tier(expr);
+	for(size_t i = 0; i < 100000; ++i)
+	{
+		mp_tiered_eval(expr, vars);
+		if(mp_tiered_tier(expr) != tier)
+		{
+			tier = mp_tiered_tier(expr);
+			printf("promoted to tier %d after %zu executions\n", tier, mp_tiered_executions(expr));
+		}
+	}
+	mp_tiered_destroy(expr);
+}
+
+#ifdef __linux__
+
+// Load generator client
+typedef struct
+{
+	/** Server socket path. */
+	const char* path;
+	
+	/** Latency of every request, in seconds. */
+	double* latencies;
+	
+} mp_bench_client;
+
+/**
+ * Server thread for the load generator.
+ * @param Socket path.
+ * @return NULL.
+ */
+static void* mp_bench_server_main(void* arg)
+{
+	mp_serve(arg, 0);
+	return NULL;
+}
+
+/**
+ * Load generator client thread. Keeps a window of pipelined requests in flight.
+ * @param Client.
+ * @return NULL.
+ */
+static void* mp_bench_client_main(void* arg)
+{
+	mp_bench_client* client = arg;
+	
+	const char* exprs[] =
+	{
+		"1 + 2 * 3\n",
+		"sqrt(2) * (4 - 1) / 7\n",
+		"(1 < 2) ? 3^2 : 4\n",
+		"max(3, 4) - min(1, 2)\n",
+	};
+	
+	// Connect, retrying until the server is listening
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, client->path);
+	int fd = -1;
+	while(fd < 0)
+	{
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		{
+			close(fd);
+			fd = -1;
+			usleep(1000);
+		}
+	}
+	
+	double* sent_at = malloc(sizeof(double) * MP_BENCH_CLIENT_REQUESTS);
+	size_t sent = 0;
+	size_t received = 0;
+	char buff[4096];
+	
+	while(received < MP_BENCH_CLIENT_REQUESTS)
+	{
+		// Fill the window
+		size_t len = 0;
+		const double now = mp_bench_time();
+		while(sent < MP_BENCH_CLIENT_REQUESTS && sent - received < MP_BENCH_CLIENT_WINDOW)
+		{
+			const char* e = exprs[sent % (sizeof(exprs) / sizeof(exprs[0]))];
+			memcpy(buff + len, e, strlen(e));
+			len += strlen(e);
+			sent_at[sent++] = now;
+		}
+		for(size_t off = 0; off < len;)
+		{
+			const ssize_t n = send(fd, buff + off, len - off, 0);
+			if(n <= 0) goto client_done;
+			off += (size_t)n;
+		}
+		
+		// Match responses to requests
+		const ssize_t n = recv(fd, buff, sizeof(buff), 0);
+		if(n <= 0) break;
+		const double done = mp_bench_time();
+		for(ssize_t i = 0; i < n; ++i)
+			if(buff[i] == '\n')
+			{
+				client->latencies[received] = done - sent_at[received];
+				++received;
+			}
+	}
+	
+	client_done:
+	close(fd);
+	free(sent_at);
+	return NULL;
+}
+
+/**
+ * Compare two doubles for qsort.
+ */
+static int mp_bench_compare(const void* a, const void* b)
+{
+	const double x = *(const double*)a;
+	const double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Measure server latency and throughput with pipelining clients.
+ */
+static void mp_bench_serve()
+{
+	// Start a server on a private socket
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/mp-bench-%ld.sock", (long)getpid());
+	pthread_t server;
+	pthread_create(&server, NULL, mp_bench_server_main, path);
+	
+	// Run the clients
+	const size_t total = (size_t)MP_BENCH_CLIENTS * MP_BENCH_CLIENT_REQUESTS;
+	double* latencies = calloc(total, sizeof(double));
+	mp_bench_client clients[MP_BENCH_CLIENTS];
+	pthread_t threads[MP_BENCH_CLIENTS];
+	const double start = mp_bench_time();
+	for(size_t i = 0; i < MP_BENCH_CLIENTS; ++i)
+	{
+		clients[i].path = path;
+		clients[i].latencies = latencies + i * MP_BENCH_CLIENT_REQUESTS;
+		pthread_create(&threads[i], NULL, mp_bench_client_main, &clients[i]);
+	}
+	for(size_t i = 0; i < MP_BENCH_CLIENTS; ++i)
+		pthread_join(threads[i], NULL);
+	const double elapsed = mp_bench_time() - start;
+	
+	mp_stop_server();
+	pthread_join(server, NULL);
+	
+	// Report percentiles
+	qsort(latencies, total, sizeof(double), mp_bench_compare);
+	printf(
+		"serve: %zu clients, window %d: %.0f req/s, p50 %.1f us, p99 %.1f us\n",
+		(size_t)MP_BENCH_CLIENTS,
+		MP_BENCH_CLIENT_WINDOW,
+		(double)total / elapsed,
+		latencies[total / 2] * 1e6,
+		latencies[total * 99 / 100] * 1e6
+	);
+	
+	free(latencies);
+}
+
+#else
+
+static void mp_bench_serve()
+{
+	printf("serve: requires Linux\n");
+}
+
+#endif
+
+/**
+ * Measure the memory and lexing time of a long program.
+ */
+static void mp_bench_tokens()
+{
+	// Build a program of repeated terms over a handful of variables
+	const char* term = "x * 1.5 + y_b * (z - 2) + ";
+	const size_t terms = MP_BENCH_TOKEN_TERMS;
+	const size_t term_len = strlen(term);
+	char* str = malloc(term_len * terms + 2);
+	for(size_t i = 0; i < terms; ++i)
+		memcpy(str + i * term_len, term, term_len);
+	memcpy(str + term_len * terms, "1", 2);
+	
+	const size_t symbols = mp_symbol_count();
+	const double start = mp_bench_time();
+	const char lexed = mp_lex_string(str);
+	const double elapsed = mp_bench_time() - start;
+	
+	size_t len;
+	mp_get_polish_tokens(&len);
+	const size_t literals = terms * 2 + 1;
+	
+	// Names are shared through the symbol table and numbers sit in the literal pool
+	printf("%-32s %10s %10s %10s %12s\n", "tokens", "tokens", "Mtok/s", "B/token", "new symbols");
+	printf(
+		"%-32s %10zu %10.1f %10.2f %12zu\n",
+		lexed ? "lexed" : "failed",
+		len,
+		(double)len / elapsed * 1e-6,
+		(double)(sizeof(token) * len + sizeof(double) * literals) / (double)len,
+		mp_symbol_count() - symbols
+	);
+	
+	mp_flush_parser_tokens();
+	free(str);
+}
+
+/**
+ * Write a variable name made of letters for an index.
+ * @param Buffer. (At least 16 characters)
+ * @param Index.
+ */
+static void mp_bench_name(char* buf, size_t index)
+{
+	size_t len = 0;
+	buf[len++] = 'v';
+	do
+	{
+		buf[len++] = (char)('a' + index % 26);
+		index /= 26;
+	} while(index != 0);
+	buf[len] = '\0';
+}
+
+/**
+ * Measure how fast formulas are validated, compared to lexing them and converting them to polish notation.
+ */
+static void mp_bench_check()
+{
+	// Formulas over a handful of names, every tenth one malformed
+	static const char* formats[] =
+	{
+		"price_%s * (1 + tax) - discount",
+		"w = sqrt(x_%s * x_%s + y * y) / 2.5",
+		"a_%s > 0 ? max(a_%s, b) : -min(a_%s, b) + if(c, 1, 2)",
+		"(rate * (1 - fee)) ^ years_%s + 100.25",
+	};
+	static const char* malformed[] =
+	{
+		"price_%s * (1 + tax)) - discount",
+		"sqrt(x_%s, y) + 1",
+	};
+	
+	const size_t formulas = MP_BENCH_CHECK_FORMULAS;
+	char** strs = malloc(sizeof(char*) * formulas);
+	size_t* lens = malloc(sizeof(size_t) * formulas);
+	size_t bytes = 0;
+	for(size_t i = 0; i < formulas; ++i)
+	{
+		const char* format = i % 10 == 9 ? malformed[i / 10 % 2] : formats[i % 4];
+		char buf[128];
+		char suffix[16];
+		mp_bench_name(suffix, i % 64);
+		lens[i] = (size_t)snprintf(buf, sizeof(buf), format, suffix, suffix, suffix);
+		strs[i] = malloc(lens[i] + 1);
+		memcpy(strs[i], buf, lens[i] + 1);
+		bytes += lens[i];
+	}
+	
+	// Validate only
+	mp_checker* checker = mp_checker_create();
+	mp_check_result res;
+	size_t valid = 0;
+	size_t vars = 0;
+	double start = mp_bench_time();
+	for(size_t i = 0; i < formulas; ++i)
+	{
+		valid += mp_check(checker, strs[i], lens[i], &res);
+		vars += res.var_len;
+	}
+	const double t_check = mp_bench_time() - start;
+	mp_checker_destroy(checker);
+	
+	// Lex and convert to polish notation (Messages of malformed formulas are silenced)
+	FILE* out = stdout;
+	stdout = fopen("/dev/null", "w");
+	size_t lexed = 0;
+	start = mp_bench_time();
+	for(size_t i = 0; i < formulas; ++i)
+	{
+		if(mp_lex_string(strs[i]))
+		{
+			size_t len;
+			mp_get_polish_tokens(&len);
+			++lexed;
+		}
+		mp_flush_parser_tokens();
+	}
+	const double t_lex = mp_bench_time() - start;
+	if(stdout != NULL) fclose(stdout);
+	stdout = out;
+	
+	printf("%-32s %10s %10s %10s %10s\n", "check", "formulas", "valid", "M/s", "MB/s");
+	printf("%-32s %10zu %10zu %10.2f %10.1f\n", "mp_check", formulas, valid, formulas / t_check * 1e-6, bytes / t_check * 1e-6);
+	printf("%-32s %10zu %10zu %10.2f %10.1f\n", "lex + polish", formulas, lexed, formulas / t_lex * 1e-6, bytes / t_lex * 1e-6);
+	printf("%-32s %10.1f\n", "variables per formula", (double)vars / formulas);
+	
+	for(size_t i = 0; i < formulas; ++i)
+		free(strs[i]);
+	free(strs);
+	free(lens);
+}
+
+#ifdef __linux__
+
+/**
+ * Compare the interpreter with ahead-of-time compiled code, and building a library with loading it from the cache.
+ */
+static void mp_bench_aot()
+{
+	// Formulas to benchmark
+	const char* exprs[] =
+	{
+		"x * y + sqrt(x * x + y * y) - 3.5",
+		"(x - 1) ^ 2 + (y + 2) ^ 2 > 4 ? exp(-x) : log(abs(y) + 1)",
+		"sin(x) * cos(y) + x * x * x - 2 * x * y",
+		"min(max(x, -0.5), 0.5) * 100 + floor(y * 10) / 10",
+	};
+	const size_t expr_count = sizeof(exprs) / sizeof(exprs[0]);
+	
+	// Build into an empty cache
+	char cache[64];
+	snprintf(cache, sizeof(cache), "/tmp/mp-bench-aot-%ld", (long)getpid());
+	if(mkdir(cache, 0700) != 0)
+	{
+		printf("aot: unable to create %s\n", cache);
+		return;
+	}
+	
+	printf("%-32s %10s %10s %10s %10s %10s %10s\n", "aot", "intp Mr/s", "aot Mr/s", "func Mr/s", "build ms", "load ms", "mismatch");
+	
+	for(size_t e = 0; e < expr_count; ++e)
+	{
+		mp_program* prog = mp_program_create();
+		mp_program_add(prog, exprs[e]);
+		
+		double start = mp_bench_time();
+		mp_aot* aot = mp_aot_create(prog, cache);
+		const double t_build = mp_bench_time() - start;
+		
+		start = mp_bench_time();
+		mp_aot* cached = mp_aot_create(prog, cache);
+		const double t_load = mp_bench_time() - start;
+		
+		if(aot->table == NULL || !cached->cached)
+		{
+			printf("%-32.32s %10s\n", exprs[e], "no compiler, interpreted");
+			mp_aot_destroy(cached);
+			mp_aot_destroy(aot);
+			mp_program_destroy(prog);
+			continue;
+		}
+		
+		// Fill every variable with random values in [-2, 2]
+		const size_t var_len = prog->var_len;
+		double** vars = malloc(sizeof(double*) * (var_len + 1));
+		srand(1);
+		for(size_t i = 0; i < var_len; ++i)
+		{
+			vars[i] = malloc(sizeof(double) * MP_BENCH_ROWS);
+			for(size_t j = 0; j < MP_BENCH_ROWS; ++j)
+				vars[i][j] = 4.0 * (double)rand() / (double)RAND_MAX - 2.0;
+		}
+		
+		double* outs[3];
+		for(size_t p = 0; p < 3; ++p)
+			outs[p] = malloc(sizeof(double) * MP_BENCH_ROWS);
+		
+		// Interpreter and library batches
+		double t[3];
+		start = mp_bench_time();
+		for(size_t r = 0; r < MP_BENCH_REPEATS; ++r)
+			mp_program_eval_batch(aot->prog, (const double* const*)vars, MP_BENCH_ROWS, &outs[0]);
+		t[0] = mp_bench_time() - start;
+		
+		start = mp_bench_time();
+		for(size_t r = 0; r < MP_BENCH_REPEATS; ++r)
+			mp_aot_eval_batch(aot, (const double* const*)vars, MP_BENCH_ROWS, &outs[1]);
+		t[1] = mp_bench_time() - start;
+		
+		// The formula's own function, one row at a time
+		double (*formula)(const double*) = aot->table->formulas[0];
+		double row[2] = { 0.0, 0.0 };
+		start = mp_bench_time();
+		for(size_t r = 0; r < MP_BENCH_REPEATS; ++r)
+			for(size_t j = 0; j < MP_BENCH_ROWS; ++j)
+			{
+				for(size_t i = 0; i < var_len; ++i)
+					row[i] = vars[i][j];
+				outs[2][j] = formula(row);
+			}
+		t[2] = mp_bench_time() - start;
+		
+		// Results must match the interpreter bit for bit
+		size_t mismatch = 0;
+		for(size_t j = 0; j < MP_BENCH_ROWS; ++j)
+			for(size_t p = 1; p < 3; ++p)
+				mismatch += memcmp(&outs[0][j], &outs[p][j], sizeof(double)) != 0;
+		
+		const double rows = (double)MP_BENCH_ROWS * MP_BENCH_REPEATS * 1e-6;
+		printf(
+			"%-32.32s %10.1f %10.1f %10.1f %10.1f %10.3f %10zu\n",
+			exprs[e],
+			rows / t[0],
+			rows / t[1],
+			rows / t[2],
+			t_build * 1e3,
+			t_load * 1e3,
+			mismatch
+		);
+		
+		// Cleanup
+		char path[128];
+		snprintf(path, sizeof(path), "%s/mp-aot-%016llx.so", cache, (unsigned long long)aot->hash);
+		remove(path);
+		for(size_t i = 0; i < var_len; ++i)
+			free(vars[i]);
+		free(vars);
+		for(size_t p = 0; p < 3; ++p)
+			free(outs[p]);
+		mp_aot_destroy(cached);
+		mp_aot_destroy(aot);
+		mp_program_destroy(prog);
+	}
+	
+	rmdir(cache);
+}
+
+/**
+ * Measure CSV evaluation throughput on one thread and on every core.
+ */
+static void mp_bench_csv()
+{
+	// Write a file of random rows
+	char in_path[64];
+	snprintf(in_path, sizeof(in_path), "/tmp/mp-bench-%ld.csv", (long)getpid());
+	FILE* file = fopen(in_path, "wb");
+	if(file == NULL)
+	{
+		printf("csv: unable to write %s\n", in_path);
+		return;
+	}
+	fprintf(file, "id,x,y,label\n");
+	srand(1);
+	for(size_t i = 0; i < MP_BENCH_CSV_ROWS; ++i)
+		fprintf(file, "%zu,%.6f,%.6f,row\n", i, (double)rand() / RAND_MAX, (double)rand() / RAND_MAX * 100.0);
+	fclose(file);
+	
+	printf("%-32s %10s %10s %10s %10s\n", "csv", "rows", "MB/s in", "MB/s out", "seconds");
+	
+	const size_t threads[] = { 1, 0 };
+	for(size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); ++i)
+	{
+		mp_csv_stats stats;
+		memset(&stats, 0, sizeof(stats));
+		
+		const double start = mp_bench_time();
+		mp_csv_run(in_path, "z = x * y + 1; r = sqrt(x * x + y * y)", "/dev/null", threads[i], 0, &stats);
+		const double elapsed = mp_bench_time() - start;
+		
+		char name[32];
+		if(threads[i] == 0) snprintf(name, sizeof(name), "%ld threads", sysconf(_SC_NPROCESSORS_ONLN));
+		else snprintf(name, sizeof(name), "%zu thread", threads[i]);
+		printf(
+			"%-32s %10zu %10.1f %10.1f %10.3f\n",
+			name,
+			stats.rows,
+			(double)stats.bytes_in / elapsed * 1e-6,
+			(double)stats.bytes_out / elapsed * 1e-6,
+			elapsed
+		);
+	}
+	
+	remove(in_path);
+}
+
+#else
+
+static void mp_bench_aot()
+{
+	printf("aot: requires Linux\n");
+}
+
+static void mp_bench_csv()
+{
+	printf("csv: requires Linux\n");
+}
+
+#endif
+
+/**
+ * Evaluate an expression the way callers driving the parser from a loop do,
+ * lexing and compiling it again for every evaluation.
+ * @param Expression.
+ * @param Variable values, in order of first use.
+ * @return Result.
+ */
+static double mp_bench_relex(const char* expr, const double* vars)
+{
+	mp_program* prog = mp_program_create();
+	mp_program_add(prog, expr);
+	double out = 0.0;
+	mp_program_eval(prog, vars, &out);
+	mp_program_destroy(prog);
+	return out;
+}
+
+/**
+ * Compare numeric builtins with root finding, quadrature and sums driven
+ * from outside the parser, one expression evaluation at a time.
+ */
+static void mp_bench_numeric()
+{
+	const size_t rows = MP_BENCH_NUMERIC_ROWS;
+	double* params = malloc(sizeof(double) * rows);
+	double* loop = malloc(sizeof(double) * rows);
+	double* builtin = malloc(sizeof(double) * rows);
+	for(size_t i = 0; i < rows; ++i)
+		params[i] = 1.0 + (double)i / rows;
+	
+	// Expressions as callers would loop over them, and the same through a builtin
+	static const char* names[] = { "solve (bisection)", "integrate (simpson 256)", "sum (1000 terms)" };
+	static const char* exprs[] =
+	{
+		"x^3 - 2*x - c",
+		"exp(0 - x^2*c)",
+		"1 / (x^2 + c)"
+	};
+	static const char* builtins[] =
+	{
+		"solve(x^3 - 2*x - c, x, 0, 10)",
+		"integrate(exp(0 - x^2*c), x, 0, 2)",
+		"sum(1 / (x^2 + c), x, 1, 1000)"
+	};
+	
+	printf("%-32s %10s %10s %10s %10s %10s\n", "numeric", "loop ms", "builtin ms", "speedup", "evals/row", "diff");
+	for(size_t b = 0; b < 3; ++b)
+	{
+		// The loop re-lexes the expression for every evaluation
+		size_t evals = 0;
+		double start = mp_bench_time();
+		for(size_t i = 0; i < rows; ++i)
+		{
+			double vars[2] = { 0.0, params[i] };
+			if(b == 0)
+			{
+				// Bisection down to the builtin's tolerance
+				double lo = 0.0;
+				double hi = 10.0;
+				vars[0] = lo;
+				const double f_lo = mp_bench_relex(exprs[b], vars);
+				++evals;
+				while(hi - lo > 1e-10)
+				{
+					vars[0] = 0.5 * (lo + hi);
+					const double f = mp_bench_relex(exprs[b], vars);
+					++evals;
+					if((f < 0.0) == (f_lo < 0.0)) lo = vars[0];
+					else hi = vars[0];
+				}
+				loop[i] = 0.5 * (lo + hi);
+			}
+			else if(b == 1)
+			{
+				// Composite Simpson's rule over [0, 2]
+				const size_t n = 256;
+				double acc = 0.0;
+				for(size_t k = 0; k <= n; ++k)
+				{
+					vars[0] = 2.0 * (double)k / n;
+					const double w = k == 0 || k == n ? 1.0 : k % 2 == 1 ? 4.0 : 2.0;
+					acc += w * mp_bench_relex(exprs[b], vars);
+					++evals;
+				}
+				loop[i] = acc * (2.0 / n) / 3.0;
+			}
+			else
+			{
+				double acc = 0.0;
+				for(size_t k = 1; k <= 1000; ++k)
+				{
+					vars[0] = (double)k;
+					acc += mp_bench_relex(exprs[b], vars);
+					++evals;
+				}
+				loop[i] = acc;
+			}
+		}
+		const double t_loop = mp_bench_time() - start;
+		
+		// The builtin compiles its expression once and evaluates every row in one batch
+		start = mp_bench_time();
+		mp_program* prog = mp_program_create();
+		mp_program_add(prog, builtins[b]);
+		const double* cols[1] = { params };
+		mp_program_eval_batch(prog, cols, rows, &builtin);
+		mp_program_destroy(prog);
+		const double t_builtin = mp_bench_time() - start;
+		
+		double diff = 0.0;
+		for(size_t i = 0; i < rows; ++i)
+			diff = fmax(diff, fabs(loop[i] - builtin[i]));
+		
+		printf(
+			"%-32s %10.2f %10.2f %9.1fx %10zu %10.3e\n",
+			names[b],
+			t_loop * 1e3,
+			t_builtin * 1e3,
+			t_loop / t_builtin,
+			evals / rows,
+			diff
+		);
+	}
+	
+	free(params);
+	free(loop);
+	free(builtin);
+}
+
+/**
+ * Compare running a long model one statement at a time with running it as a script.
+ */
+static void mp_bench_script()
+{
+	// Build the model, every variable depending on the two before it.
+	// Every tenth line overwrites a scratch variable nothing reads.
+	const size_t lines = MP_BENCH_SCRIPT_LINES;
+	char** stmts = malloc(sizeof(char*) * (lines + 1));
+	size_t src_len = 0;
+	for(size_t i = 0, v = 0; i < lines; ++i)
+	{
+		char name[16], a[16], b[16];
+		mp_bench_name(name, v);
+		mp_bench_name(a, v < 1 ? 0 : v - 1);
+		mp_bench_name(b, v < 2 ? 0 : v - 2);
+		
+		stmts[i] = malloc(96);
+		if(i % 10 == 9) snprintf(stmts[i], 96, "scratch = %s * %zu", a, i);
+		else if(v++ < 2) snprintf(stmts[i], 96, "%s = seed * %zu", name, v);
+		else snprintf(stmts[i], 96, "%s = %s * 0.5 + sin(%s) / 3", name, a, b);
+		src_len += strlen(stmts[i]) + 1;
+	}
+	char* src = malloc(src_len + 1);
+	src[0] = '\0';
+	for(size_t i = 0, len = 0; i < lines; ++i)
+	{
+		const size_t stmt_len = strlen(stmts[i]);
+		memcpy(src + len, stmts[i], stmt_len);
+		src[len + stmt_len] = '\n';
+		src[len += stmt_len + 1] = '\0';
+	}
+	
+	// Last variable the model assigns
+	char last[16];
+	mp_bench_name(last, lines - lines / 10 - 1);
+	
+	// One statement at a time
+	mp_lex_string("seed = 0.25");
+	mp_parse_all();
+	double start = mp_bench_time();
+	for(size_t i = 0; i < lines; ++i)
+	{
+		mp_lex_string(stmts[i]);
+		mp_parse_all();
+	}
+	const double t_lines = mp_bench_time() - start;
+	double line_val = 0.0;
+	mp_get_variable(last, &line_val);
+	mp_flush_variables();
+	
+	// As one script
+	mp_lex_string("seed = 0.25");
+	mp_parse_all();
+	start = mp_bench_time();
+	mp_parse_script(src);
+	const double t_script = mp_bench_time() - start;
+	double script_val = 0.0;
+	mp_get_variable(last, &script_val);
+	mp_flush_variables();
+	
+	// Re-running a compiled script is a single evaluation
+	mp_script* script = mp_script_create(src, NULL);
+	double* out = malloc(sizeof(double) * (script->prog->out_len + 1));
+	const double seed = 0.25;
+	start = mp_bench_time();
+	for(size_t i = 0; i < MP_BENCH_REPEATS; ++i)
+		mp_program_eval(script->prog, &seed, out);
+	const double t_rerun = (mp_bench_time() - start) / MP_BENCH_REPEATS;
+	
+	printf("%-32s %10s %10s %10s %10s %10s %10s\n", "script", "lines ms", "script ms", "rerun us", "nodes", "dead", "diff");
+	printf(
+		"%-32zu %10.2f %10.2f %10.2f %10zu %10zu %10.3e\n",
+		lines,
+		t_lines * 1e3,
+		t_script * 1e3,
+		t_rerun * 1e6,
+		script->prog->len,
+		script->dead_len,
+		fabs(line_val - script_val)
+	);
+	
+	free(out);
+	mp_script_destroy(script);
+	for(size_t i = 0; i < lines; ++i)
+		free(stmts[i]);
+	free(stmts);
+	free(src);
+}
+
+/** Every benchmark. */
+static const mp_bench mp_benches[] =
+{
+	{ "precision", mp_bench_precision },
+	{ "poly", mp_bench_poly },
+	{ "tiered", mp_bench_tiered },
+	{ "tokens", mp_bench_tokens },
+	{ "check", mp_bench_check },
+	{ "script", mp_bench_script },
+	{ "numeric", mp_bench_numeric },
+	{ "aot", mp_bench_aot },
+	{ "csv", mp_bench_csv },
+	{ "serve", mp_bench_serve },
+};
+
+int mp_run_benchmarks(const char* name)
+{
+	// Programs are compiled through the parser
+	mp_init_parser();
+	
+	char found = 0;
+	for(size_t i = 0; i < sizeof(mp_benches) / sizeof(mp_bench); ++i)
+		if(name == NULL || strcmp(mp_benches[i].name, name) == 0)
+		{
+			mp_benches[i].func();
+			found = 1;
+		}
+	
+	if(found == 0)
+	{
+		printf("Unknown benchmark \"%s\"\n", name);
+		return 1;
+	}
+	
+	mp_flush_parser_tokens();
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef MP_BENCH_H
+#define MP_BENCH_H
+
+/**
+ * Benchmarks run with "mp --bench [name]".
+ */
+
+/**
+ * Run benchmarks and print their results.
+ * @param Name of the benchmark to run, or NULL to run every benchmark.
+ * @return Process exit code.
+ */
+extern int mp_run_benchmarks(const char* name);
+#endif
\ No newline at end of file
@@ -0,0 +1,600 @@
+/** Includes. */
+#include "string.h"
+#include "stdlib.h"
+#include "stdint.h"
+#include "math_funcs.h"
+#include "numeric.h"
+#include "check.h"
+
+/** Initial number of entries of every scratch array. */
+#define MP_CHECK_INIT_SIZE 16
+
+/** Description of every error code. */
+static const char* mp_check_messages[MP_CHECK_COUNT] =
+{
+	"Valid",
+	"Unexpected character",
+	"Invalid number",
+	"Expected a value",
+	"Expected an operator",
+	"Unmatched left parenthesis",
+	"Unmatched right parenthesis",
+	"Unmatched ternary operator",
+	"Comma outside of a function call",
+	"Assignment must come right after the first variable",
+	"Unknown function or wrong number of arguments",
+	"Invalid array",
+	"Expected a variable name"
+};
+
+/**
+ * Open parenthesis or function call.
+ */
+typedef struct
+{
+	/** Offset of the left parenthesis. */
+	size_t pos;
+
+	/** Function name. (len is 0 for plain parentheses and the whole expression) */
+	mp_check_name func;
+
+	/** Number of arguments so far. */
+	size_t argc;
+
+	/** Number of ternary conditions still waiting for their alternative. */
+	size_t ternary;
+
+	/**
+	 * Variable bound by a numeric builtin call. (len is 0 for other calls, or
+	 * if the second argument isn't a name, with begin at the second argument)
+	 */
+	mp_check_name bound;
+
+} mp_check_frame;
+
+struct mp_checker
+{
+	/** Stack of open parentheses. The bottom frame is the whole expression. */
+	mp_check_frame* frames;
+
+	/** Number of frames allocated. */
+	size_t frame_allocated;
+
+	/** Variables read by the last expression. */
+	mp_check_name* vars;
+
+	/** Number of variables allocated. */
+	size_t var_allocated;
+
+	/**
+	 * Hash table of the variables, as the check number in the high bits and
+	 * the variable index + 1 in the low bits. Entries of older checks count
+	 * as empty, so the table is never cleared between checks.
+	 */
+	uint64_t* table;
+
+	/** Size of the hash table. (Always a power of two) */
+	size_t table_len;
+
+	/** Number of the current check. */
+	uint32_t generation;
+};
+
+mp_checker* mp_checker_create()
+{
+	mp_checker* checker = malloc(sizeof(mp_checker));
+	checker->frames = malloc(sizeof(mp_check_frame) * MP_CHECK_INIT_SIZE);
+	checker->frame_allocated = MP_CHECK_INIT_SIZE;
+	checker->vars = malloc(sizeof(mp_check_name) * MP_CHECK_INIT_SIZE);
+	checker->var_allocated = MP_CHECK_INIT_SIZE;
+	checker->table = calloc(MP_CHECK_INIT_SIZE * 2, sizeof(uint64_t));
+	checker->table_len = MP_CHECK_INIT_SIZE * 2;
+	checker->generation = 0;
+	return checker;
+}
+
+void mp_checker_destroy(mp_checker* checker)
+{
+	free(checker->frames);
+	free(checker->vars);
+	free(checker->table);
+	free(checker);
+}
+
+const char* mp_check_message(int code)
+{
+	return code >= 0 && code < MP_CHECK_COUNT ? mp_check_messages[code] : "Unknown error";
+}
+
+/**
+ * Hash a name.
+ * @param Name.
+ * @param Length of the name.
+ * @return Hash.
+ */
+static size_t mp_check_hash(const char* name, size_t len)
+{
+	uint64_t h = 14695981039346656037ull;
+	for(size_t i = 0; i < len; ++i)
+	{
+		h ^= (unsigned char)name[i];
+		h *= 1099511628211ull;
+	}
+	return (size_t)h;
+}
+
+/**
+ * Add a variable to the set of variables read, unless it is already in it.
+ * @param Checker.
+ * @param Expression.
+ * @param Variable name.
+ * @param Number of variables so far. (Incremented if the variable is new)
+ */
+static void mp_check_add_var(mp_checker* checker, const char* str, mp_check_name name, size_t* var_len)
+{
+	const uint64_t gen = (uint64_t)checker->generation << 32;
+	size_t mask = checker->table_len - 1;
+	size_t slot = mp_check_hash(str + name.begin, name.len) & mask;
+
+	// Look for the name
+	for(;; slot = (slot + 1) & mask)
+	{
+		const uint64_t entry = checker->table[slot];
+		if((entry & ~(uint64_t)UINT32_MAX) != gen) break;
+
+		const mp_check_name* var = &checker->vars[(entry & UINT32_MAX) - 1];
+		if(var->len == name.len && memcmp(str + var->begin, str + name.begin, name.len) == 0)
+			return;
+	}
+
+	// Add it
+	if(*var_len == checker->var_allocated)
+	{
+		checker->var_allocated *= 2;
+		checker->vars = realloc(checker->vars, sizeof(mp_check_name) * checker->var_allocated);
+	}
+	checker->vars[(*var_len)++] = name;
+	checker->table[slot] = gen | *var_len;
+
+	// Keep the table at most half full
+	if(*var_len * 2 < checker->table_len) return;
+
+	free(checker->table);
+	checker->table_len *= 2;
+	checker->table = calloc(checker->table_len, sizeof(uint64_t));
+	mask = checker->table_len - 1;
+	for(size_t i = 0; i < *var_len; ++i)
+	{
+		const mp_check_name* var = &checker->vars[i];
+		slot = mp_check_hash(str + var->begin, var->len) & mask;
+		while(checker->table[slot] != 0) slot = (slot + 1) & mask;
+		checker->table[slot] = gen | (i + 1);
+	}
+}
+
+/**
+ * Determine if a character can be part of a name.
+ * @param Character.
+ * @return 1 if the character is a letter or an underscore, 0 otherwise.
+ */
+static char mp_check_is_name(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+/**
+ * Read a number the way the lexer does.
+ * @param Expression.
+ * @param Length of the expression.
+ * @param Offset of the number. Moved past it.
+ * @return 1 if the number is valid, 0 otherwise.
+ */
+static char mp_check_number(const char* str, size_t len, size_t* i)
+{
+	size_t digits = 0;
+	size_t points = 0;
+	for(; *i < len && ((str[*i] >= '0' && str[*i] <= '9') || str[*i] == '.'); ++*i)
+	{
+		if(str[*i] == '.') ++points;
+		else ++digits;
+	}
+
+	return digits != 0 && points <= 1;
+}
+
+/**
+ * Check an array literal, like [1, -2, 3.5], which must end the expression.
+ * @param Expression.
+ * @param Length of the expression.
+ * @param Offset of the left bracket.
+ * @param Result to write errors to.
+ * @return 1 if the array is valid, 0 otherwise.
+ */
+static char mp_check_array(const char* str, size_t len, size_t i, mp_check_result* result)
+{
+	size_t values = 0;
+	for(++i;; ++i)
+	{
+		while(i < len && str[i] == ' ') ++i;
+		if(i < len && str[i] == ']') break;
+
+		// Separate values with commas
+		if(values != 0)
+		{
+			if(i == len || str[i] != ',') goto array_failure;
+			++i;
+			while(i < len && str[i] == ' ') ++i;
+		}
+
+		// Optional negation
+		if(i < len && str[i] == '-') ++i;
+		while(i < len && str[i] == ' ') ++i;
+
+		// Value
+		const size_t begin = i;
+		if(i == len || !((str[i] >= '0' && str[i] <= '9') || str[i] == '.')) goto array_failure;
+		if(!mp_check_number(str, len, &i))
+		{
+			result->code = MP_CHECK_INVALID_NUMBER;
+			result->pos = begin;
+			return 0;
+		}
+		++values;
+		--i;
+	}
+
+	// Nothing may follow the right bracket
+	for(++i; i < len && str[i] == ' '; ++i);
+	if(i == len) return 1;
+
+	// Failure jump point
+	array_failure:
+
+	result->code = MP_CHECK_INVALID_ARRAY;
+	result->pos = i;
+	return 0;
+}
+
+/**
+ * Find a built-in function by a name which isn't null terminated.
+ * @param Function name.
+ * @param Length of the name.
+ * @param Number of arguments.
+ * @return 1 if the function exists, 0 otherwise.
+ */
+static char mp_check_func(const char* name, size_t len, size_t argc)
+{
+	for(size_t i = 0; i < mp_func_count; ++i)
+		if(
+			mp_funcs[i].argc == argc &&
+			strncmp(mp_funcs[i].name, name, len) == 0 &&
+			mp_funcs[i].name[len] == '\0'
+		)
+			return 1;
+
+	return 0;
+}
+
+/**
+ * Find the variable bound by a numeric builtin call, the name making up
+ * its whole second argument.
+ * @param Expression.
+ * @param Length of the expression.
+ * @param Offset just after the left parenthesis of the call.
+ * @param Name to write to. (len is 0 if the second argument isn't a name)
+ */
+static void mp_check_bound(const char* str, size_t len, size_t i, mp_check_name* bound)
+{
+	bound->begin = i;
+	bound->len = 0;
+
+	// Find the comma ending the first argument
+	size_t depth = 0;
+	for(; i < len; ++i)
+	{
+		if(str[i] == '(') ++depth;
+		else if(str[i] == ')' && depth-- == 0) return;
+		else if(str[i] == ',' && depth == 0) break;
+	}
+	if(i == len) return;
+
+	// The second argument must be a lone name
+	for(++i; i < len && str[i] == ' '; ++i);
+	size_t j = i;
+	while(j < len && mp_check_is_name(str[j])) ++j;
+	size_t k = j;
+	while(k < len && str[k] == ' ') ++k;
+
+	bound->begin = i;
+	if(j != i && k < len && str[k] == ',') bound->len = j - i;
+}
+
+/**
+ * Determine if a variable is bound by a numeric builtin whose expression is being read.
+ * @param Expression.
+ * @param Open frames.
+ * @param Index of the innermost frame.
+ * @param Variable name.
+ * @return 1 if the variable is bound, 0 otherwise.
+ */
+static char mp_check_is_bound(const char* str, const mp_check_frame* frames, size_t depth, mp_check_name name)
+{
+	for(size_t d = depth; d > 0; --d)
+		if(
+			frames[d].argc == 1 &&
+			frames[d].bound.len == name.len &&
+			memcmp(str + frames[d].bound.begin, str + name.begin, name.len) == 0
+		)
+			return 1;
+
+	return 0;
+}
+
+/**
+ * Check an expression. (See mp_check)
+ * @param Checker.
+ * @param Expression.
+ * @param Length of the expression.
+ * @param Result to write to. (Except for the variables)
+ * @return 1 if the expression is valid, 0 otherwise.
+ */
+static char mp_check_expression(mp_checker* checker, const char* str, size_t len, mp_check_result* result)
+{
+	// Entries of the previous check become empty
+	if(++checker->generation == 0)
+	{
+		memset(checker->table, 0, sizeof(uint64_t) * checker->table_len);
+		checker->generation = 1;
+	}
+
+	result->code = MP_CHECK_OK;
+	result->pos = 0;
+	result->var_len = 0;
+	result->target.begin = 0;
+	result->target.len = 0;
+
+	// Bottom frame for the whole expression
+	mp_check_frame* frames = checker->frames;
+	size_t depth = 0;
+	memset(frames, 0, sizeof(mp_check_frame));
+
+	size_t i = 0;
+	while(i < len && str[i] == ' ') ++i;
+
+	// Assignments look like "name = ..."
+	if(i < len && mp_check_is_name(str[i]))
+	{
+		size_t j = i;
+		while(j < len && mp_check_is_name(str[j])) ++j;
+		size_t k = j;
+		while(k < len && str[k] == ' ') ++k;
+
+		if(k < len && str[k] == '=' && (k + 1 == len || str[k + 1] != '='))
+		{
+			result->target.begin = i;
+			result->target.len = j - i;
+
+			// Assigning an array literal
+			for(i = k + 1; i < len && str[i] == ' '; ++i);
+			if(i < len && str[i] == '[') return mp_check_array(str, len, i, result);
+		}
+	}
+
+	// A value is expected at the start and after every operator
+	char operand = 1;
+
+	for(; i < len; ++i)
+	{
+		const char c = str[i];
+		if(c == ' ') continue;
+
+		// Values and prefixes
+		if(operand)
+		{
+			// Negation
+			if(c == '-') continue;
+
+			// Parenthesis
+			if(c == '(')
+			{
+				if(++depth == checker->frame_allocated)
+				{
+					checker->frame_allocated *= 2;
+					checker->frames = frames = realloc(frames, sizeof(mp_check_frame) * checker->frame_allocated);
+				}
+				memset(&frames[depth], 0, sizeof(mp_check_frame));
+				frames[depth].pos = i;
+				continue;
+			}
+
+			// Number
+			if((c >= '0' && c <= '9') || c == '.')
+			{
+				const size_t begin = i;
+				if(!mp_check_number(str, len, &i))
+				{
+					result->code = MP_CHECK_INVALID_NUMBER;
+					result->pos = begin;
+					return 0;
+				}
+				--i;
+				operand = 0;
+				continue;
+			}
+
+			// Variable or function name
+			if(mp_check_is_name(c))
+			{
+				mp_check_name name;
+				name.begin = i;
+				while(i < len && mp_check_is_name(str[i])) ++i;
+				name.len = i - name.begin;
+
+				// A name followed by a left paren is a function call
+				size_t j = i;
+				while(j < len && str[j] == ' ') ++j;
+				if(j < len && str[j] == '(')
+				{
+					if(++depth == checker->frame_allocated)
+					{
+						checker->frame_allocated *= 2;
+						checker->frames = frames = realloc(frames, sizeof(mp_check_frame) * checker->frame_allocated);
+					}
+					frames[depth].pos = j;
+					frames[depth].func = name;
+					frames[depth].argc = 1;
+					frames[depth].ternary = 0;
+					frames[depth].bound.begin = 0;
+					frames[depth].bound.len = 0;
+					if(mp_find_numeric(str + name.begin, name.len) != MP_NUMERIC_ERR)
+						mp_check_bound(str, len, j + 1, &frames[depth].bound);
+					i = j;
+					continue;
+				}
+
+				if(!mp_check_is_bound(str, frames, depth, name))
+					mp_check_add_var(checker, str, name, &result->var_len);
+				--i;
+				operand = 0;
+				continue;
+			}
+
+			// A right paren without a value before it
+			if(c == ')' && depth == 0) result->code = MP_CHECK_UNMATCHED_RPN;
+			else if(c == '[' || c == ']') result->code = MP_CHECK_INVALID_ARRAY;
+			else if(strchr("+*/^=<>!&|?:,)", c) != NULL && c != '\0') result->code = MP_CHECK_EXPECTED_OPERAND;
+			else result->code = MP_CHECK_UNEXPECTED_CHAR;
+			result->pos = i;
+			return 0;
+		}
+
+		// Operators and suffixes
+		mp_check_frame* frame = &frames[depth];
+		switch(c)
+		{
+		case '+':
+		case '-':
+		case '*':
+		case '/':
+		case '^':
+			break;
+
+		case '<':
+		case '>':
+			if(i + 1 < len && str[i + 1] == '=') ++i;
+			break;
+
+		case '=':
+		case '!':
+			if(i + 1 < len && str[i + 1] == '=')
+			{
+				++i;
+				break;
+			}
+			result->code = c == '=' ? MP_CHECK_MISPLACED_ASSIGNMENT : MP_CHECK_UNEXPECTED_CHAR;
+			result->pos = i;
+			return 0;
+
+		case '&':
+		case '|':
+			if(i + 1 < len && str[i + 1] == c)
+			{
+				++i;
+				break;
+			}
+			result->code = MP_CHECK_UNEXPECTED_CHAR;
+			result->pos = i;
+			return 0;
+
+		case '?':
+			++frame->ternary;
+			break;
+
+		case ':':
+			if(frame->ternary == 0)
+			{
+				result->code = MP_CHECK_UNMATCHED_TERNARY;
+				result->pos = i;
+				return 0;
+			}
+			--frame->ternary;
+			break;
+
+		case ',':
+			if(frame->func.len == 0 || frame->ternary != 0)
+			{
+				result->code = frame->ternary != 0 ? MP_CHECK_UNMATCHED_TERNARY : MP_CHECK_MISPLACED_COMMA;
+				result->pos = i;
+				return 0;
+			}
+			++frame->argc;
+
+			// The bound variable of a numeric builtin isn't read
+			if(frame->argc == 2 && frame->bound.len != 0)
+			{
+				i = frame->bound.begin + frame->bound.len - 1;
+				continue;
+			}
+			break;
+
+		case ')':
+			if(depth == 0 || frame->ternary != 0)
+			{
+				result->code = depth == 0 ? MP_CHECK_UNMATCHED_RPN : MP_CHECK_UNMATCHED_TERNARY;
+				result->pos = i;
+				return 0;
+			}
+			if(
+				frame->func.len != 0 && frame->argc == MP_NUMERIC_ARGC &&
+				mp_find_numeric(str + frame->func.begin, frame->func.len) != MP_NUMERIC_ERR
+			)
+			{
+				if(frame->bound.len == 0)
+				{
+					result->code = MP_CHECK_EXPECTED_VARIABLE;
+					result->pos = frame->bound.begin;
+					return 0;
+				}
+			}
+			else if(frame->func.len != 0 && !mp_check_func(str + frame->func.begin, frame->func.len, frame->argc))
+			{
+				result->code = MP_CHECK_UNKNOWN_FUNCTION;
+				result->pos = frame->func.begin;
+				return 0;
+			}
+			--depth;
+			continue;
+
+		default:
+			if(c == '[' || c == ']') result->code = MP_CHECK_INVALID_ARRAY;
+			else if(c == '(' || c == '.' || (c >= '0' && c <= '9') || mp_check_is_name(c)) result->code = MP_CHECK_EXPECTED_OPERATOR;
+			else result->code = MP_CHECK_UNEXPECTED_CHAR;
+			result->pos = i;
+			return 0;
+		}
+
+		operand = 1;
+	}
+
+	// The expression must end with a value and close everything it opened
+	result->pos = len;
+	if(operand) result->code = MP_CHECK_EXPECTED_OPERAND;
+	else if(depth != 0)
+	{
+		result->code = MP_CHECK_UNMATCHED_LPN;
+		result->pos = frames[depth].pos;
+	}
+	else if(frames[0].ternary != 0) result->code = MP_CHECK_UNMATCHED_TERNARY;
+	else result->pos = 0;
+
+	return result->code == MP_CHECK_OK;
+}
+
+char mp_check(mp_checker* checker, const char* str, size_t len, mp_check_result* result)
+{
+	const char ok = mp_check_expression(checker, str, len, result);
+
+	// Variables read before an error are returned too
+	result->vars = checker->vars;
+	return ok;
+}
@@ -0,0 +1,103 @@
+#ifndef MP_CHECK_H
+#define MP_CHECK_H
+
+/**
+ * Validation of expressions without evaluating them. A checker reads an
+ * expression in a single pass, reporting the first error with its position
+ * and the names of the variables the expression reads. Names aren't interned
+ * and nothing is allocated per token; a checker's scratch space grows to fit
+ * the largest expression and is reused afterwards.
+ * Accepts exactly what the REPL accepts: an expression, "name = expression"
+ * or "name = [array literal]".
+ */
+
+/** Includes. */
+#include "stddef.h"
+
+// Error codes
+#define MP_CHECK_OK 0
+#define MP_CHECK_UNEXPECTED_CHAR 1
+#define MP_CHECK_INVALID_NUMBER 2
+#define MP_CHECK_EXPECTED_OPERAND 3
+#define MP_CHECK_EXPECTED_OPERATOR 4
+#define MP_CHECK_UNMATCHED_LPN 5
+#define MP_CHECK_UNMATCHED_RPN 6
+#define MP_CHECK_UNMATCHED_TERNARY 7
+#define MP_CHECK_MISPLACED_COMMA 8
+#define MP_CHECK_MISPLACED_ASSIGNMENT 9
+#define MP_CHECK_UNKNOWN_FUNCTION 10
+#define MP_CHECK_INVALID_ARRAY 11
+#define MP_CHECK_EXPECTED_VARIABLE 12
+
+// Number of error codes
+#define MP_CHECK_COUNT 13
+
+// Name in a checked expression
+typedef struct
+{
+	/** Offset of the first character. */
+	size_t begin;
+
+	/** Number of characters. (0 if there is no name) */
+	size_t len;
+
+} mp_check_name;
+
+// Result of a check
+typedef struct
+{
+	/** Error code, or MP_CHECK_OK if the expression is valid. */
+	int code;
+
+	/** Offset of the error. (Of the token responsible, or the end of the expression) */
+	size_t pos;
+
+	/**
+	 * Variables read, once each in order of first use. Variables bound by a
+	 * numeric builtin aren't read within its expression. (Owned by the
+	 * checker, valid until the next check)
+	 */
+	const mp_check_name* vars;
+
+	/** Number of variables read. */
+	size_t var_len;
+
+	/** Assigned variable. (len is 0 if the expression isn't an assignment) */
+	mp_check_name target;
+
+} mp_check_result;
+
+// Reusable checker scratch space
+typedef struct mp_checker mp_checker;
+
+/**
+ * Create a checker.
+ * @return New checker.
+ * @note Must be destroyed with mp_checker_destroy. Threads need a checker each.
+ */
+extern mp_checker* mp_checker_create();
+
+/**
+ * Destroy a checker.
+ * @param Checker.
+ */
+extern void mp_checker_destroy(mp_checker* checker);
+
+/**
+ * Check an expression.
+ * @param Checker.
+ * @param Expression. (Doesn't need to be null terminated)
+ * @param Length of the expression.
+ * @param Pointer to write the result to.
+ * @return 1 if the expression is valid, 0 otherwise.
+ * @note Doesn't touch the parser or the symbol table.
+ */
+extern char mp_check(mp_checker* checker, const char* str, size_t len, mp_check_result* result);
+
+/**
+ * Get the description of an error code.
+ * @param Error code.
+ * @return Description.
+ */
+extern const char* mp_check_message(int code);
+#endif
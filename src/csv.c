@@ -0,0 +1,732 @@
+/** Includes. */
+#include "string.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "stdint.h"
+#include "math.h"
+#include "symbols.h"
+#include "program.h"
+#include "script.h"
+#include "aot.h"
+#include "csv.h"
+
+#ifdef __unix__
+#include "pthread.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#define MP_CSV_THREADS
+#endif
+
+/** Number of chunks each worker may finish ahead of the writer. */
+#define MP_CSV_WINDOW 2
+
+/** Size of the buffer fields are copied to when they need strtod. */
+#define MP_CSV_FIELD_SIZE 128
+
+/** Most characters a formatted value takes. */
+#define MP_CSV_VALUE_SIZE 32
+
+/** Powers of ten which are exact doubles. */
+static const double mp_csv_pow10[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/** Powers of ten which fit 64 bit integers. */
+static const uint64_t mp_csv_pow10_int[] =
+{
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+	100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+	10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+	100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
+/** Every pair of decimal digits, "00" to "99". */
+static const char mp_csv_digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+// Chunk of whole lines
+typedef struct
+{
+	/** First character of the chunk. */
+	const char* begin;
+
+	/** One past the last character of the chunk. */
+	const char* end;
+
+	/** Lines of the chunk with the computed columns appended. (Written out in one piece) */
+	char* out;
+
+	/** Number of output characters. */
+	size_t out_len;
+
+	/** Number of rows in the chunk. */
+	size_t rows;
+
+	/** Set once the chunk has been evaluated. */
+	char done;
+
+} mp_csv_chunk;
+
+// State shared by the workers of a run
+typedef struct
+{
+	/** Program of the script. */
+	const mp_program* prog;
+
+	/** Ahead-of-time compiled program of the script, or NULL to interpret it. */
+	mp_aot* aot;
+
+	/** Variable slot of every header field, or MP_PROGRAM_ERR if the script doesn't read it. */
+	size_t* field_slots;
+
+	/** Number of header fields. */
+	size_t field_len;
+
+	/** Chunks in file order. */
+	mp_csv_chunk* chunks;
+
+	/** Number of chunks. */
+	size_t chunk_len;
+
+	/** Next chunk to evaluate. */
+	size_t next;
+
+	/** Number of chunks written. */
+	size_t written;
+
+	/** Most chunks evaluated but not written at once. */
+	size_t window;
+
+#ifdef MP_CSV_THREADS
+	/** Guards next, written and the done flags. */
+	pthread_mutex_t lock;
+
+	/** Signalled whenever a chunk is evaluated or written. */
+	pthread_cond_t cond;
+#endif
+
+} mp_csv_state;
+
+/**
+ * Parse a numeric field.
+ * @param First character of the field.
+ * @param One past the last character of the field.
+ * @return Value, or NaN if the field isn't a number.
+ * @note Decimal numbers with up to 19 significant digits and small exponents
+ * are converted exactly without strtod. Anything else falls back to strtod.
+ */
+static double mp_csv_number(const char* p, const char* end)
+{
+	const char* begin = p;
+	while(p < end && *p == ' ') ++p;
+
+	// Sign
+	char neg = 0;
+	if(p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+
+	// Digits, keeping at most 19 significant ones
+	uint64_t mant = 0;
+	int digits = 0;
+	int exp = 0;
+	char any = 0;
+	char exact = 1;
+	for(; p < end && *p >= '0' && *p <= '9'; ++p, any = 1)
+	{
+		if(digits < 19)
+		{
+			mant = mant * 10 + (uint64_t)(*p - '0');
+			digits += mant != 0;
+		}
+		else
+		{
+			++exp;
+			exact &= *p == '0';
+		}
+	}
+	if(p < end && *p == '.')
+	{
+		for(++p; p < end && *p >= '0' && *p <= '9'; ++p, any = 1)
+		{
+			if(digits < 19)
+			{
+				mant = mant * 10 + (uint64_t)(*p - '0');
+				digits += mant != 0;
+				--exp;
+			}
+			else exact &= *p == '0';
+		}
+	}
+
+	// Exponent
+	if(any && p < end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		char exp_neg = 0;
+		if(p < end && (*p == '-' || *p == '+')) exp_neg = *p++ == '-';
+
+		int e = 0;
+		char exp_any = 0;
+		for(; p < end && *p >= '0' && *p <= '9'; ++p, exp_any = 1)
+			if(e < 10000) e = e * 10 + (*p - '0');
+		if(!exp_any) any = 0;
+		exp += exp_neg ? -e : e;
+	}
+
+	while(p < end && *p == ' ') ++p;
+
+	// Fast path, exact when the mantissa and the power of ten are both exact doubles
+	if(any && p == end && exact && mant < (1ull << 53) && exp >= -22 && exp <= 22)
+	{
+		const double val = exp < 0 ? (double)mant / mp_csv_pow10[-exp] : (double)mant * mp_csv_pow10[exp];
+		return neg ? -val : val;
+	}
+
+	// Anything else (Long mantissas, large exponents, inf, nan) goes through strtod
+	char buf[MP_CSV_FIELD_SIZE];
+	const size_t len = (size_t)(end - begin);
+	if(len == 0 || len >= MP_CSV_FIELD_SIZE) return NAN;
+	memcpy(buf, begin, len);
+	buf[len] = '\0';
+
+	char* parsed;
+	const double val = strtod(buf, &parsed);
+	while(*parsed == ' ') ++parsed;
+	return parsed != buf && *parsed == '\0' ? val : NAN;
+}
+
+/**
+ * Format a value like printf's %.17g.
+ * @param Buffer. (At least MP_CSV_VALUE_SIZE characters)
+ * @param Value.
+ * @return Number of characters written.
+ * @note Values between about 1e-6 and 1e37 are converted exactly with 128 bit
+ * integers, which is several times faster than printf. Anything else uses snprintf.
+ */
+static size_t mp_csv_format(char* buf, double val)
+{
+#ifdef __SIZEOF_INT128__
+	typedef unsigned __int128 mp_u128;
+
+	// Split into mantissa and binary exponent (val = m * 2^e)
+	uint64_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	const int exp_bits = (int)((bits >> 52) & 0x7FF);
+	const uint64_t m = (bits & ((1ull << 52) - 1)) | (1ull << 52);
+	const int e = exp_bits - 1075;
+
+	// Normal numbers in range only (Zero and subnormals have no exponent bits)
+	if(exp_bits != 0 && e >= -127 && e <= 70)
+	{
+		// Guess the decimal exponent from the binary one (val is in [2^(e+52), 2^(e+53))),
+		// then scale to 17 significant digits
+		int d = (int)floor((double)(e + 52) * 0.30102999566398120);
+		for(int attempt = 0; attempt < 3; ++attempt)
+		{
+			const int k = 16 - d;
+			if(k > 22 || k < -22) break;
+
+			mp_u128 q;
+			char up;
+			if(k >= 0)
+			{
+				// round(m * 10^k / 2^-e), exact since m * 10^k < 2^127
+				const mp_u128 p = k <= 19 ? (mp_u128)mp_csv_pow10_int[k] : (mp_u128)mp_csv_pow10_int[19] * mp_csv_pow10_int[k - 19];
+				const mp_u128 n = (mp_u128)m * p;
+				if(e >= 0)
+				{
+					q = n << e;
+					up = 0;
+				}
+				else
+				{
+					const int shift = -e;
+					q = n >> shift;
+					const mp_u128 rem = n - (q << shift);
+					const mp_u128 half = (mp_u128)1 << (shift - 1);
+					up = rem > half || (rem == half && (q & 1));
+				}
+			}
+			else
+			{
+				// round(m * 2^e / 10^-k), exact since m * 2^e < 2^124
+				if(e < 0) break;
+				const mp_u128 p = -k <= 19 ? (mp_u128)mp_csv_pow10_int[-k] : (mp_u128)mp_csv_pow10_int[19] * mp_csv_pow10_int[-k - 19];
+				const mp_u128 n = (mp_u128)m << e;
+				q = n / p;
+				const mp_u128 rem = n - q * p;
+				up = rem * 2 > p || (rem * 2 == p && (q & 1));
+			}
+
+			// Exactly 17 digits before rounding, otherwise the guess was off
+			if(q >= (mp_u128)100000000000000000ull) { ++d; continue; }
+			if(q < (mp_u128)10000000000000000ull) { --d; continue; }
+
+			// Rounding up to 10^17 moves to the next power of ten
+			q += up;
+			if(q == (mp_u128)100000000000000000ull)
+			{
+				q /= 10;
+				++d;
+			}
+
+			// Digits, two at a time, dropping trailing zeros like %g
+			char digits[18];
+			const uint64_t v = (uint64_t)q;
+			uint32_t hi = (uint32_t)(v / 100000000);
+			uint32_t lo = (uint32_t)(v % 100000000);
+			for(int i = 16; i > 8; i -= 2, lo /= 100)
+				memcpy(&digits[i - 1], &mp_csv_digit_pairs[(lo % 100) * 2], 2);
+			for(int i = 8; i > 0; i -= 2, hi /= 100)
+				memcpy(&digits[i - 1], &mp_csv_digit_pairs[(hi % 100) * 2], 2);
+			digits[0] = (char)('0' + hi);
+			int len = 17;
+			while(len > 1 && digits[len - 1] == '0') --len;
+
+			char* o = buf;
+			if(val < 0) *o++ = '-';
+			if(d < -4 || d >= 17)
+			{
+				// Scientific notation
+				*o++ = digits[0];
+				if(len > 1)
+				{
+					*o++ = '.';
+					memcpy(o, digits + 1, (size_t)(len - 1));
+					o += len - 1;
+				}
+				o += sprintf(o, "e%c%02d", d < 0 ? '-' : '+', d < 0 ? -d : d);
+			}
+			else if(d < 0)
+			{
+				// Leading zeros
+				*o++ = '0';
+				*o++ = '.';
+				for(int i = -1; i > d; --i) *o++ = '0';
+				memcpy(o, digits, (size_t)len);
+				o += len;
+			}
+			else
+			{
+				// Integer digits, then the fraction if any
+				const int whole = d + 1;
+				for(int i = 0; i < whole; ++i) *o++ = i < len ? digits[i] : '0';
+				if(len > whole)
+				{
+					*o++ = '.';
+					memcpy(o, digits + whole, (size_t)(len - whole));
+					o += len - whole;
+				}
+			}
+			*o = '\0';
+			return (size_t)(o - buf);
+		}
+	}
+#endif
+
+	return (size_t)snprintf(buf, MP_CSV_VALUE_SIZE, "%.17g", val);
+}
+
+/**
+ * Parse, evaluate and format every row of a chunk.
+ * @param Run state.
+ * @param Chunk.
+ */
+static void mp_csv_process(const mp_csv_state* run, mp_csv_chunk* chunk)
+{
+	const mp_program* prog = run->prog;
+
+	// Column of every variable and output for one block
+	double* var_mem = calloc((prog->var_len + 1) * MP_CSV_BLOCK_ROWS, sizeof(double));
+	double* out_mem = malloc(sizeof(double) * (prog->out_len + 1) * MP_CSV_BLOCK_ROWS);
+	const double** cols = malloc(sizeof(double*) * (prog->var_len + 1));
+	double** outs = malloc(sizeof(double*) * (prog->out_len + 1));
+	for(size_t i = 0; i < prog->var_len; ++i)
+		cols[i] = var_mem + i * MP_CSV_BLOCK_ROWS;
+	for(size_t i = 0; i < prog->out_len; ++i)
+		outs[i] = out_mem + i * MP_CSV_BLOCK_ROWS;
+
+	// Start and end of every line of the block
+	const char** starts = malloc(sizeof(char*) * MP_CSV_BLOCK_ROWS);
+	const char** ends = malloc(sizeof(char*) * MP_CSV_BLOCK_ROWS);
+
+	size_t out_cap = (size_t)(chunk->end - chunk->begin) + 1;
+	chunk->out = malloc(out_cap);
+	chunk->out_len = 0;
+	chunk->rows = 0;
+
+	const char* p = chunk->begin;
+	while(p < chunk->end)
+	{
+		// Parse a block of rows
+		size_t rows = 0;
+		size_t line_bytes = 0;
+		while(rows < MP_CSV_BLOCK_ROWS && p < chunk->end)
+		{
+			const char* eol = memchr(p, '\n', (size_t)(chunk->end - p));
+			if(eol == NULL) eol = chunk->end;
+			const char* line_end = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+			const char* f = p;
+			p = eol + 1;
+
+			// Blank lines are dropped
+			if(line_end == f) continue;
+			starts[rows] = f;
+			ends[rows] = line_end;
+			line_bytes += (size_t)(line_end - f);
+
+			// Only the fields the script reads are converted
+			for(size_t k = 0; k < run->field_len; ++k)
+			{
+				const char* fe = f <= line_end ? memchr(f, ',', (size_t)(line_end - f)) : NULL;
+				if(fe == NULL) fe = line_end;
+
+				const size_t slot = run->field_slots[k];
+				if(slot != MP_PROGRAM_ERR)
+					var_mem[slot * MP_CSV_BLOCK_ROWS + rows] = f <= line_end ? mp_csv_number(f, fe) : NAN;
+				f = fe + 1;
+			}
+			++rows;
+		}
+		if(rows == 0) break;
+
+		if(run->aot != NULL) mp_aot_eval_batch(run->aot, cols, rows, outs);
+		else mp_program_eval_batch(prog, cols, rows, outs);
+
+		// Make room for the lines and the appended values
+		const size_t need = chunk->out_len + line_bytes + rows * (prog->out_len * MP_CSV_VALUE_SIZE + 1);
+		if(need > out_cap)
+		{
+			out_cap = need * 2;
+			chunk->out = realloc(chunk->out, out_cap);
+		}
+
+		// Copy every line and append its values
+		char* o = chunk->out + chunk->out_len;
+		for(size_t r = 0; r < rows; ++r)
+		{
+			const size_t len = (size_t)(ends[r] - starts[r]);
+			memcpy(o, starts[r], len);
+			o += len;
+			for(size_t i = 0; i < prog->out_len; ++i)
+			{
+				*o++ = ',';
+				o += mp_csv_format(o, outs[i][r]);
+			}
+			*o++ = '\n';
+		}
+		chunk->out_len = (size_t)(o - chunk->out);
+		chunk->rows += rows;
+	}
+
+	free(var_mem);
+	free(out_mem);
+	free(cols);
+	free(outs);
+	free(starts);
+	free(ends);
+}
+
+#ifdef MP_CSV_THREADS
+/**
+ * Worker thread. Evaluates chunks in order until none are left,
+ * staying at most a window of chunks ahead of the writer.
+ * @param Run state.
+ * @return NULL.
+ */
+static void* mp_csv_worker(void* arg)
+{
+	mp_csv_state* run = arg;
+	while(1)
+	{
+		pthread_mutex_lock(&run->lock);
+		while(run->next < run->chunk_len && run->next >= run->written + run->window)
+			pthread_cond_wait(&run->cond, &run->lock);
+		if(run->next == run->chunk_len)
+		{
+			pthread_mutex_unlock(&run->lock);
+			break;
+		}
+		mp_csv_chunk* chunk = &run->chunks[run->next++];
+		pthread_mutex_unlock(&run->lock);
+
+		mp_csv_process(run, chunk);
+
+		pthread_mutex_lock(&run->lock);
+		chunk->done = 1;
+		pthread_cond_broadcast(&run->cond);
+		pthread_mutex_unlock(&run->lock);
+	}
+	return NULL;
+}
+#endif
+
+/**
+ * Map a file into memory.
+ * @param File path.
+ * @param Pointer to write the file size to.
+ * @return File contents, or NULL on failure. (Free with mp_csv_unmap)
+ */
+static const char* mp_csv_map(const char* path, size_t* size)
+{
+#ifdef __unix__
+	const int fd = open(path, O_RDONLY);
+	if(fd < 0) return NULL;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) return NULL;
+
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+	*size = (size_t)st.st_size;
+	return data;
+#else
+	// Read the whole file instead
+	FILE* file = fopen(path, "rb");
+	if(file == NULL) return NULL;
+	fseek(file, 0, SEEK_END);
+	const long len = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char* data = len > 0 ? malloc((size_t)len) : NULL;
+	if(data != NULL && fread(data, 1, (size_t)len, file) != (size_t)len)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+
+	*size = (size_t)len;
+	return data;
+#endif
+}
+
+/**
+ * Unmap a file mapped with mp_csv_map.
+ * @param File contents.
+ * @param File size.
+ */
+static void mp_csv_unmap(const char* data, size_t size)
+{
+#ifdef __unix__
+	munmap((void*)data, size);
+#else
+	(void)size;
+	free((void*)data);
+#endif
+}
+
+/**
+ * Bind the header fields to the variables of a script.
+ * @param Run state. (prog must be set)
+ * @param Script.
+ * @param First character of the header.
+ * @param One past the last character of the header.
+ * @return 1 if every variable the script reads is a column, 0 otherwise.
+ */
+static char mp_csv_bind(mp_csv_state* run, const mp_script* script, const char* header, const char* header_end)
+{
+	const mp_program* prog = run->prog;
+	char* bound = calloc(prog->var_len + 1, 1);
+	char* name = malloc((size_t)(header_end - header) + 1);
+
+	for(const char* f = header; f <= header_end;)
+	{
+		const char* fe = memchr(f, ',', (size_t)(header_end - f));
+		if(fe == NULL) fe = header_end;
+
+		// Trim spaces and quotes around the name
+		const char* b = f;
+		const char* e = fe;
+		while(b < e && (*b == ' ' || *b == '"')) ++b;
+		while(e > b && (e[-1] == ' ' || e[-1] == '"')) --e;
+		memcpy(name, b, (size_t)(e - b));
+		name[e - b] = '\0';
+
+		// The first column with a name wins
+		size_t slot = mp_program_find_var(prog, name);
+		if(slot != MP_PROGRAM_ERR && bound[slot]) slot = MP_PROGRAM_ERR;
+		if(slot != MP_PROGRAM_ERR) bound[slot] = 1;
+
+		run->field_slots = realloc(run->field_slots, sizeof(size_t) * (run->field_len + 1));
+		run->field_slots[run->field_len++] = slot;
+		f = fe + 1;
+	}
+
+	// Every variable the script reads needs a column
+	char ok = 1;
+	for(size_t i = 0; i < prog->var_len && ok; ++i)
+		if(script->used[i] && !bound[i])
+		{
+			fprintf(stderr, "Unable to locate column \"%s\"\n", prog->vars[i]);
+			ok = 0;
+		}
+
+	free(bound);
+	free(name);
+	return ok;
+}
+
+char mp_csv_run(
+	const char* in_path,
+	const char* script_src,
+	const char* out_path,
+	size_t threads,
+	char aot,
+	mp_csv_stats* stats
+)
+{
+	// Compile the script
+	size_t error_line;
+	mp_script* script = mp_script_create(script_src, &error_line);
+	if(script == NULL)
+	{
+		fprintf(stderr, "Invalid statement on line %zu\n", error_line);
+		return 0;
+	}
+
+	// Map the input
+	size_t size;
+	const char* data = mp_csv_map(in_path, &size);
+	if(data == NULL)
+	{
+		fprintf(stderr, "Unable to read \"%s\"\n", in_path);
+		mp_script_destroy(script);
+		return 0;
+	}
+	const char* end = data + size;
+
+	// Header line
+	const char* header_eol = memchr(data, '\n', size);
+	if(header_eol == NULL) header_eol = end;
+	const char* header_end = header_eol > data && header_eol[-1] == '\r' ? header_eol - 1 : header_eol;
+
+	mp_csv_state run;
+	memset(&run, 0, sizeof(run));
+	run.prog = script->prog;
+	FILE* out = NULL;
+	char ok = mp_csv_bind(&run, script, data, header_end);
+	if(!ok) goto csv_end;
+
+	// Native code for the script, if it can be built
+	if(aot) run.aot = mp_aot_create(script->prog, NULL);
+
+	// Open the output
+	out = out_path != NULL ? fopen(out_path, "wb") : stdout;
+	if(out == NULL)
+	{
+		fprintf(stderr, "Unable to write \"%s\"\n", out_path);
+		ok = 0;
+		goto csv_end;
+	}
+
+	// Header with the new columns
+	fwrite(data, 1, (size_t)(header_end - data), out);
+	size_t bytes_out = (size_t)(header_end - data) + 1;
+	for(size_t i = 0; i < run.prog->out_len; ++i)
+	{
+		const char* name = i < script->result_len ? "result" : mp_symbol_name(script->assigns[i - script->result_len]);
+		bytes_out += (size_t)fprintf(out, ",%s", name);
+	}
+	fputc('\n', out);
+
+	// Split the data into chunks of whole lines
+	for(const char* p = header_eol < end ? header_eol + 1 : end; p < end;)
+	{
+		const char* chunk_end = end;
+		if((size_t)(end - p) > MP_CSV_CHUNK_SIZE)
+		{
+			const char* eol = memchr(p + MP_CSV_CHUNK_SIZE, '\n', (size_t)(end - p - MP_CSV_CHUNK_SIZE));
+			if(eol != NULL) chunk_end = eol + 1;
+		}
+
+		run.chunks = realloc(run.chunks, sizeof(mp_csv_chunk) * (run.chunk_len + 1));
+		memset(&run.chunks[run.chunk_len], 0, sizeof(mp_csv_chunk));
+		run.chunks[run.chunk_len].begin = p;
+		run.chunks[run.chunk_len++].end = chunk_end;
+		p = chunk_end;
+	}
+
+#ifdef MP_CSV_THREADS
+	// Start the workers
+	if(threads == 0)
+	{
+		const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cores > 0 ? (size_t)cores : 1;
+	}
+	if(threads > run.chunk_len) threads = run.chunk_len;
+	run.window = threads * MP_CSV_WINDOW;
+	pthread_mutex_init(&run.lock, NULL);
+	pthread_cond_init(&run.cond, NULL);
+	pthread_t* workers = malloc(sizeof(pthread_t) * (threads + 1));
+	for(size_t i = 0; i < threads; ++i)
+		pthread_create(&workers[i], NULL, mp_csv_worker, &run);
+#else
+	(void)threads;
+#endif
+
+	// Write the chunks in order as they are finished
+	for(size_t i = 0; i < run.chunk_len; ++i)
+	{
+		mp_csv_chunk* chunk = &run.chunks[i];
+
+#ifdef MP_CSV_THREADS
+		pthread_mutex_lock(&run.lock);
+		while(!chunk->done) pthread_cond_wait(&run.cond, &run.lock);
+		pthread_mutex_unlock(&run.lock);
+#else
+		mp_csv_process(&run, chunk);
+#endif
+
+		fwrite(chunk->out, 1, chunk->out_len, out);
+		bytes_out += chunk->out_len;
+		if(stats != NULL) stats->rows += chunk->rows;
+		free(chunk->out);
+		chunk->out = NULL;
+
+#ifdef MP_CSV_THREADS
+		pthread_mutex_lock(&run.lock);
+		++run.written;
+		pthread_cond_broadcast(&run.cond);
+		pthread_mutex_unlock(&run.lock);
+#endif
+	}
+
+#ifdef MP_CSV_THREADS
+	for(size_t i = 0; i < threads; ++i)
+		pthread_join(workers[i], NULL);
+	free(workers);
+	pthread_mutex_destroy(&run.lock);
+	pthread_cond_destroy(&run.cond);
+#endif
+
+	if(stats != NULL)
+	{
+		stats->bytes_in = size;
+		stats->bytes_out = bytes_out;
+	}
+
+	// Shared exit path
+	csv_end:
+
+	if(out != NULL && out != stdout) fclose(out);
+	else if(out != NULL) fflush(out);
+	if(run.aot != NULL) mp_aot_destroy(run.aot);
+	free(run.field_slots);
+	free(run.chunks);
+	mp_csv_unmap(data, size);
+	mp_script_destroy(script);
+	return ok;
+}
@@ -0,0 +1,58 @@
+#ifndef MP_CSV_H
+#define MP_CSV_H
+
+/**
+ * Streaming evaluation of CSV files. The input is memory mapped and split
+ * into chunks of whole lines, which worker threads parse and evaluate in
+ * blocks of rows. Every line is written back out in order with the
+ * computed columns appended.
+ *
+ * The first line is a header naming the columns. A script (See script.h)
+ * reads columns as variables by header name; every variable it assigns,
+ * and every expression statement (Named "result"), becomes a new column.
+ * Fields can't contain quoted commas. Empty or non-numeric fields read as NaN.
+ */
+
+/** Includes. */
+#include "stddef.h"
+
+/** Bytes of input per chunk handed to a worker. */
+#define MP_CSV_CHUNK_SIZE (1 << 22)
+
+/** Rows parsed and evaluated at a time. */
+#define MP_CSV_BLOCK_ROWS 1024
+
+// Statistics of a run
+typedef struct
+{
+	/** Number of data rows. */
+	size_t rows;
+
+	/** Bytes of input read. */
+	size_t bytes_in;
+
+	/** Bytes of output written. */
+	size_t bytes_out;
+
+} mp_csv_stats;
+
+/**
+ * Evaluate a script over every row of a CSV file.
+ * @param Input file path.
+ * @param Script source.
+ * @param Output file path, or NULL for the standard output.
+ * @param Number of worker threads, or 0 for one per core.
+ * @param Non-zero to compile the script ahead of time. (See aot.h)
+ * @param Pointer to write statistics to, or NULL.
+ * @return 1 on success, 0 otherwise. (The reason is printed to the standard error)
+ * @note The parser must be initialized.
+ */
+extern char mp_csv_run(
+	const char* in_path,
+	const char* script,
+	const char* out_path,
+	size_t threads,
+	char aot,
+	mp_csv_stats* stats
+);
+#endif
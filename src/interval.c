@@ -0,0 +1,473 @@
+/** Includes. */
+#include "string.h"
+#include "stdlib.h"
+#include "math.h"
+#include "float.h"
+#include "lexer.h"
+#include "math_funcs.h"
+#include "interval.h"
+
+/** Largest magnitude below which every integral double is exact. */
+#define MP_EXACT_INT_LIMIT 9007199254740992.0
+
+/**
+ * Round a value down by at least one unit in the last place.
+ * @param Value.
+ * @return Rounded value.
+ * @note Infinities and NaNs are returned unchanged.
+ */
+static double mp_round_down(double x)
+{
+	return fabs(x) < INFINITY ? x - (fabs(x) * DBL_EPSILON + DBL_TRUE_MIN) : x;
+}
+
+/**
+ * Round a value up by at least one unit in the last place.
+ * @param Value.
+ * @return Rounded value.
+ * @note Infinities and NaNs are returned unchanged.
+ */
+static double mp_round_up(double x)
+{
+	return fabs(x) < INFINITY ? x + (fabs(x) * DBL_EPSILON + DBL_TRUE_MIN) : x;
+}
+
+/** Branch-free minimum. (NaN if either value is NaN, whatever the order) */
+static double mp_min(double a, double b) { return a < b || a != a ? a : b; }
+
+/** Branch-free maximum. (NaN if either value is NaN, whatever the order) */
+static double mp_max(double a, double b) { return a > b || a != a ? a : b; }
+
+/**
+ * Multiply two interval endpoints.
+ * @param First endpoint.
+ * @param Second endpoint.
+ * @return Product, where 0 * inf is 0. (The limit of the products near the endpoints)
+ */
+static double mp_mul_endpoints(double a, double b)
+{
+	const double p = a * b;
+	return p != p && a == a && b == b ? 0.0 : p;
+}
+
+mp_interval mp_interval_widen(mp_interval x)
+{
+	x.lo = mp_round_down(x.lo);
+	x.hi = mp_round_up(x.hi);
+	return x;
+}
+
+/**
+ * Raise an interval to the power of another interval.
+ * @param Base.
+ * @param Exponent.
+ * @return Range of the result.
+ */
+static mp_interval mp_interval_pow(mp_interval a, mp_interval b)
+{
+	mp_interval r;
+
+	// Set when the result can't be negative
+	char non_negative = 1;
+
+	// Exponent is a single integer
+	if(b.lo == b.hi && b.lo == floor(b.lo) && fabs(b.lo) < MP_EXACT_INT_LIMIT)
+	{
+		const double n = b.lo;
+		const char odd = fmod(n, 2.0) != 0.0;
+
+		if(n == 0.0)
+		{
+			r.lo = 1.0;
+			r.hi = 1.0;
+			return r;
+		}
+
+		// Negative powers blow up around zero
+		if(n < 0.0 && a.lo <= 0.0 && a.hi >= 0.0)
+		{
+			r.lo = -INFINITY;
+			r.hi = INFINITY;
+			return r;
+		}
+
+		// Odd powers are monotonic
+		if(odd)
+		{
+			non_negative = a.lo >= 0.0;
+			r.lo = pow(n > 0.0 ? a.lo : a.hi, n);
+			r.hi = pow(n > 0.0 ? a.hi : a.lo, n);
+		}
+		// Even powers depend on the magnitude only
+		else
+		{
+			const double mag_lo = a.lo >= 0.0 ? a.lo : a.hi <= 0.0 ? -a.hi : 0.0;
+			const double mag_hi = mp_max(fabs(a.lo), fabs(a.hi));
+			r.lo = pow(n > 0.0 ? mag_lo : mag_hi, n);
+			r.hi = pow(n > 0.0 ? mag_hi : mag_lo, n);
+		}
+	}
+	// Non-integer powers of negative numbers are undefined
+	else if(a.lo < 0.0)
+	{
+		r.lo = -INFINITY;
+		r.hi = INFINITY;
+		return r;
+	}
+	// Otherwise the extremes are at the corners
+	else
+	{
+		const double p1 = pow(a.lo, b.lo);
+		const double p2 = pow(a.lo, b.hi);
+		const double p3 = pow(a.hi, b.lo);
+		const double p4 = pow(a.hi, b.hi);
+		r.lo = mp_min(mp_min(p1, p2), mp_min(p3, p4));
+		r.hi = mp_max(mp_max(p1, p2), mp_max(p3, p4));
+	}
+
+	// pow is accurate to within an ulp, so widen twice
+	r = mp_interval_widen(mp_interval_widen(r));
+	if(non_negative) r.lo = mp_max(r.lo, 0.0);
+	return r;
+}
+
+/**
+ * Evaluate one block of rows over intervals. Mirrors mp_program_eval_block
+ * with separate lower and upper bound register columns.
+ * @param Program.
+ * @param Variable lower bound columns, offset to the first row of the block.
+ * @param Variable upper bound columns, offset to the first row of the block.
+ * @param Number of rows in the block.
+ * @param Lower bound register columns. (MP_PROGRAM_BLOCK values per node)
+ * @param Upper bound register columns. (MP_PROGRAM_BLOCK values per node)
+ */
+static void mp_program_eval_interval_block(
+	const mp_program* prog,
+	const double* const* vars_lo,
+	const double* const* vars_hi,
+	size_t rows,
+	double* regs_lo,
+	double* regs_hi
+)
+{
+	for(size_t i = 0; i < prog->len; ++i)
+	{
+		const mp_node* n = &prog->nodes[i];
+		double* r_lo = regs_lo + i * MP_PROGRAM_BLOCK;
+		double* r_hi = regs_hi + i * MP_PROGRAM_BLOCK;
+		const double* a_lo = regs_lo + n->args[0] * MP_PROGRAM_BLOCK;
+		const double* a_hi = regs_hi + n->args[0] * MP_PROGRAM_BLOCK;
+		const double* b_lo = regs_lo + n->args[1] * MP_PROGRAM_BLOCK;
+		const double* b_hi = regs_hi + n->args[1] * MP_PROGRAM_BLOCK;
+		const double* c_lo = regs_lo + n->args[2] * MP_PROGRAM_BLOCK;
+		const double* c_hi = regs_hi + n->args[2] * MP_PROGRAM_BLOCK;
+
+		switch(n->op)
+		{
+		case MP_TOKEN_NUM:
+			{
+				// Constants which aren't exact integers may have been rounded when parsed
+				mp_interval v;
+				v.lo = n->val;
+				v.hi = n->val;
+				if(n->val != floor(n->val) || fabs(n->val) >= MP_EXACT_INT_LIMIT)
+					v = mp_interval_widen(v);
+
+				for(size_t j = 0; j < rows; ++j)
+				{
+					r_lo[j] = v.lo;
+					r_hi[j] = v.hi;
+				}
+			}
+			break;
+
+		case MP_TOKEN_VAR:
+			memcpy(r_lo, vars_lo[n->slot], sizeof(double) * rows);
+			memcpy(r_hi, vars_hi[n->slot], sizeof(double) * rows);
+			break;
+
+		case MP_TOKEN_NEG:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				r_lo[j] = -a_hi[j];
+				r_hi[j] = -a_lo[j];
+			}
+			break;
+
+		case MP_TOKEN_ADD:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				r_lo[j] = mp_round_down(a_lo[j] + b_lo[j]);
+				r_hi[j] = mp_round_up(a_hi[j] + b_hi[j]);
+			}
+			break;
+
+		case MP_TOKEN_SUB:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				r_lo[j] = mp_round_down(a_lo[j] - b_hi[j]);
+				r_hi[j] = mp_round_up(a_hi[j] - b_lo[j]);
+			}
+			break;
+
+		case MP_TOKEN_MUL:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				const double p1 = mp_mul_endpoints(a_lo[j], b_lo[j]);
+				const double p2 = mp_mul_endpoints(a_lo[j], b_hi[j]);
+				const double p3 = mp_mul_endpoints(a_hi[j], b_lo[j]);
+				const double p4 = mp_mul_endpoints(a_hi[j], b_hi[j]);
+				r_lo[j] = mp_round_down(mp_min(mp_min(p1, p2), mp_min(p3, p4)));
+				r_hi[j] = mp_round_up(mp_max(mp_max(p1, p2), mp_max(p3, p4)));
+			}
+			break;
+
+		case MP_NODE_FMA:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				const double p1 = mp_mul_endpoints(a_lo[j], b_lo[j]);
+				const double p2 = mp_mul_endpoints(a_lo[j], b_hi[j]);
+				const double p3 = mp_mul_endpoints(a_hi[j], b_lo[j]);
+				const double p4 = mp_mul_endpoints(a_hi[j], b_hi[j]);
+				const double lo = mp_round_down(mp_min(mp_min(p1, p2), mp_min(p3, p4)));
+				const double hi = mp_round_up(mp_max(mp_max(p1, p2), mp_max(p3, p4)));
+				r_lo[j] = mp_round_down(lo + c_lo[j]);
+				r_hi[j] = mp_round_up(hi + c_hi[j]);
+			}
+			break;
+
+		case MP_TOKEN_DIV:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				const double q1 = a_lo[j] / b_lo[j];
+				const double q2 = a_lo[j] / b_hi[j];
+				const double q3 = a_hi[j] / b_lo[j];
+				const double q4 = a_hi[j] / b_hi[j];
+
+				// Dividing by a range containing zero is unbounded, and so is
+				// dividing infinities (inf / inf is undefined at the corners)
+				const char zero =
+					((b_lo[j] <= 0.0) & (b_hi[j] >= 0.0)) |
+					(((fabs(a_lo[j]) == INFINITY) | (fabs(a_hi[j]) == INFINITY)) &
+					((fabs(b_lo[j]) == INFINITY) | (fabs(b_hi[j]) == INFINITY)));
+				r_lo[j] = zero ? -INFINITY : mp_round_down(mp_min(mp_min(q1, q2), mp_min(q3, q4)));
+				r_hi[j] = zero ? INFINITY : mp_round_up(mp_max(mp_max(q1, q2), mp_max(q3, q4)));
+			}
+			break;
+
+		case MP_TOKEN_EXP:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				mp_interval a, b;
+				a.lo = a_lo[j];
+				a.hi = a_hi[j];
+				b.lo = b_lo[j];
+				b.hi = b_hi[j];
+				const mp_interval r = mp_interval_pow(a, b);
+				r_lo[j] = r.lo;
+				r_hi[j] = r.hi;
+			}
+			break;
+
+		// Comparisons are 1 when certainly true, 0 when certainly false and [0, 1] otherwise
+		case MP_TOKEN_LT:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				r_lo[j] = (double)(a_hi[j] < b_lo[j]);
+				r_hi[j] = (double)(a_lo[j] < b_hi[j]);
+			}
+			break;
+
+		case MP_TOKEN_LE:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				r_lo[j] = (double)(a_hi[j] <= b_lo[j]);
+				r_hi[j] = (double)(a_lo[j] <= b_hi[j]);
+			}
+			break;
+
+		case MP_TOKEN_GT:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				r_lo[j] = (double)(a_lo[j] > b_hi[j]);
+				r_hi[j] = (double)(a_hi[j] > b_lo[j]);
+			}
+			break;
+
+		case MP_TOKEN_GE:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				r_lo[j] = (double)(a_lo[j] >= b_hi[j]);
+				r_hi[j] = (double)(a_hi[j] >= b_lo[j]);
+			}
+			break;
+
+		case MP_TOKEN_EQ:
+		case MP_TOKEN_NE:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				// Certainly equal when both are the same single value
+				const char same =
+					(a_lo[j] == a_hi[j]) & (b_lo[j] == b_hi[j]) & (a_lo[j] == b_lo[j]);
+
+				// Possibly equal when the ranges overlap
+				const char overlap = (a_lo[j] <= b_hi[j]) & (b_lo[j] <= a_hi[j]);
+
+				r_lo[j] = (double)(n->op == MP_TOKEN_EQ ? same : !overlap);
+				r_hi[j] = (double)(n->op == MP_TOKEN_EQ ? overlap : !same);
+			}
+			break;
+
+		case MP_TOKEN_AND:
+		case MP_TOKEN_OR:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				// Certainly true when zero is excluded, possibly true unless exactly zero
+				const char a_true = (a_lo[j] > 0.0) | (a_hi[j] < 0.0);
+				const char a_maybe = (a_lo[j] != 0.0) | (a_hi[j] != 0.0);
+				const char b_true = (b_lo[j] > 0.0) | (b_hi[j] < 0.0);
+				const char b_maybe = (b_lo[j] != 0.0) | (b_hi[j] != 0.0);
+
+				r_lo[j] = (double)(n->op == MP_TOKEN_AND ? a_true & b_true : a_true | b_true);
+				r_hi[j] = (double)(n->op == MP_TOKEN_AND ? a_maybe & b_maybe : a_maybe | b_maybe);
+			}
+			break;
+
+		case MP_TOKEN_COL:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				// An undecided condition covers both values
+				const char cond_true = (a_lo[j] > 0.0) | (a_hi[j] < 0.0);
+				const char cond_false = (a_lo[j] == 0.0) & (a_hi[j] == 0.0);
+				r_lo[j] = cond_true ? b_lo[j] : cond_false ? c_lo[j] : mp_min(b_lo[j], c_lo[j]);
+				r_hi[j] = cond_true ? b_hi[j] : cond_false ? c_hi[j] : mp_max(b_hi[j], c_hi[j]);
+			}
+			break;
+
+		case MP_TOKEN_FUN:
+			{
+				const mp_func* f = &mp_funcs[n->slot];
+				mp_interval args[MP_NODE_MAX_ARGS];
+				for(size_t j = 0; j < rows; ++j)
+				{
+					for(size_t k = 0; k < f->argc; ++k)
+					{
+						args[k].lo = regs_lo[n->args[k] * MP_PROGRAM_BLOCK + j];
+						args[k].hi = regs_hi[n->args[k] * MP_PROGRAM_BLOCK + j];
+					}
+					const mp_interval r = f->ifunc(args);
+					r_lo[j] = r.lo;
+					r_hi[j] = r.hi;
+				}
+			}
+			break;
+
+		// Numeric builtins aren't bounded
+		case MP_NODE_SOLVE:
+		case MP_NODE_INTEGRATE:
+		case MP_NODE_SUM:
+			for(size_t j = 0; j < rows; ++j)
+			{
+				r_lo[j] = -INFINITY;
+				r_hi[j] = INFINITY;
+			}
+			break;
+		}
+	}
+}
+
+void mp_program_eval_interval(
+	const mp_program* prog,
+	const mp_interval* vars,
+	mp_interval* out
+)
+{
+	// Split the variable ranges into single row columns
+	double* vals = malloc(sizeof(double) * 2 * (prog->var_len + prog->out_len + 1));
+	const double** cols = malloc(sizeof(double*) * 2 * (prog->var_len + 1));
+	double** outs = malloc(sizeof(double*) * 2 * (prog->out_len + 1));
+	for(size_t i = 0; i < prog->var_len; ++i)
+	{
+		vals[i * 2] = vars[i].lo;
+		vals[i * 2 + 1] = vars[i].hi;
+		cols[i] = &vals[i * 2];
+		cols[prog->var_len + i] = &vals[i * 2 + 1];
+	}
+
+	// Output columns come after the variables
+	double* out_vals = vals + prog->var_len * 2;
+	for(size_t i = 0; i < prog->out_len; ++i)
+	{
+		outs[i] = &out_vals[i * 2];
+		outs[prog->out_len + i] = &out_vals[i * 2 + 1];
+	}
+
+	mp_program_eval_interval_batch(
+		prog,
+		cols,
+		cols + prog->var_len,
+		1,
+		outs,
+		outs + prog->out_len
+	);
+
+	// Join the output columns back into intervals
+	for(size_t i = 0; i < prog->out_len; ++i)
+	{
+		out[i].lo = out_vals[i * 2];
+		out[i].hi = out_vals[i * 2 + 1];
+	}
+
+	free(vals);
+	free(cols);
+	free(outs);
+}
+
+void mp_program_eval_interval_batch(
+	const mp_program* prog,
+	const double* const* vars_lo,
+	const double* const* vars_hi,
+	size_t rows,
+	double* const* out_lo,
+	double* const* out_hi
+)
+{
+	// Register files and block variable columns
+	double* regs_lo = malloc(sizeof(double) * MP_PROGRAM_BLOCK * (prog->len + 1));
+	double* regs_hi = malloc(sizeof(double) * MP_PROGRAM_BLOCK * (prog->len + 1));
+	const double** cols = malloc(sizeof(double*) * 2 * (prog->var_len + 1));
+
+	// Loop over every block of rows
+	for(size_t row = 0; row < rows; row += MP_PROGRAM_BLOCK)
+	{
+		const size_t block = rows - row < MP_PROGRAM_BLOCK ? rows - row : MP_PROGRAM_BLOCK;
+
+		// Offset variable columns to the current block
+		for(size_t i = 0; i < prog->var_len; ++i)
+		{
+			cols[i] = vars_lo[i] + row;
+			cols[prog->var_len + i] = vars_hi[i] + row;
+		}
+
+		mp_program_eval_interval_block(
+			prog,
+			cols,
+			cols + prog->var_len,
+			block,
+			regs_lo,
+			regs_hi
+		);
+
+		// Copy the outputs out of the register files
+		for(size_t i = 0; i < prog->out_len; ++i)
+		{
+			const size_t reg = prog->outputs[i] * MP_PROGRAM_BLOCK;
+			memcpy(out_lo[i] + row, regs_lo + reg, sizeof(double) * block);
+			memcpy(out_hi[i] + row, regs_hi + reg, sizeof(double) * block);
+		}
+	}
+
+	free(regs_lo);
+	free(regs_hi);
+	free(cols);
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef MP_INTERVAL_H
+#define MP_INTERVAL_H
+
+/**
+ * Interval evaluation of compiled programs. Every variable is bound to
+ * a range [lo, hi] and every operation rounds its result outward, so the
+ * resulting range is guaranteed to contain every possible value of the
+ * expression over the input ranges.
+ */
+
+/** Includes. */
+#include "stddef.h"
+#include "program.h"
+
+// Interval data type
+typedef struct
+{
+	/** Lower bound. */
+	double lo;
+
+	/** Upper bound. */
+	double hi;
+
+} mp_interval;
+
+/**
+ * Widen an interval outward by at least one unit in the last place on each side.
+ * @param Interval.
+ * @return Widened interval.
+ * @note Used to cover the rounding error of an operation rounded to nearest.
+ */
+extern mp_interval mp_interval_widen(mp_interval x);
+
+/**
+ * Evaluate every output of a program over a single set of variable ranges.
+ * @param Program.
+ * @param Variable ranges, indexed by slot.
+ * @param Array to write the output ranges to, indexed by output.
+ */
+extern void mp_program_eval_interval(
+	const mp_program* prog,
+	const mp_interval* vars,
+	mp_interval* out
+);
+
+/**
+ * Evaluate every output of a program over many sets of variable ranges.
+ * @param Program.
+ * @param Variable lower bound columns, indexed by slot.
+ * @param Variable upper bound columns, indexed by slot.
+ * @param Number of rows.
+ * @param Output lower bound columns, indexed by output.
+ * @param Output upper bound columns, indexed by output.
+ */
+extern void mp_program_eval_interval_batch(
+	const mp_program* prog,
+	const double* const* vars_lo,
+	const double* const* vars_hi,
+	size_t rows,
+	double* const* out_lo,
+	double* const* out_hi
+);
+#endif
\ No newline at end of file
@@ -4,12 +4,13 @@
 #include "stdio.h"
 #include "string.h"
 #include "parser.h"
+#include "symbols.h"
 
 // Structure returned from mp_read_name
 typedef struct
 {
-	/** String containing a variable name. (Allocated with malloc, must be freed) */
-	char* str;
+	/** Symbol id of the variable name. */
+	size_t sym;
 	
 	/** Number of characters read while reading the variable name. */
 	size_t delta;
@@ -19,141 +20,84 @@ typedef struct
 // Structure returned from mp_read_real
 typedef struct
 {
-	/** String containing a real number. (Allocated with malloc, must be freed.) */
-	char* str;
+	/** Value of the real number. */
+	double val;
 	
 	/** Number of characters read while reading the number. */
 	size_t delta;
 	
 } mp_read_real_data;
 
+/** Set on threads whose lexer errors aren't printed. */
+static _Thread_local char mp_lexer_quiet = 0;
+
+/** Set on threads which lex names into scratch symbols. */
+static _Thread_local char mp_lexer_scratch = 0;
+
+/** Length of the buffer numbers are parsed from without allocating. */
+#define MP_REAL_BUFFER_SIZE 64
+
 /**
  * Function used by mp_lex_string to extract a real number from the input string.
  * @param Input string.
- * @return See mp_read_real_data.
+ * @return See mp_read_real_data. (delta is 0 if there is no number)
  */
 static mp_read_real_data mp_read_real(const char* str)
 {
-	// String length
-	const size_t len = strlen(str);
-	
-	// List of numbers
-	const char nums[] = "0123456789";
-	
-	// Loop over the string
-	size_t num_len;
-	for(num_len = 0; num_len < len; ++num_len)
-	{
-		// If the character isn't a number or a 
-		// decimal point, we've reached the end
-		// of the number.
-		
-		if(str[num_len] == '.') continue;
-		
-		char found_num = 0;
-		for(size_t i = 0; i < 10; ++i)
-			if(str[num_len] == nums[i])
-			{
-				found_num = 1;
-				break;
-			}
-		if(found_num == 1) continue;
-			
-		// Otherwise, we've reached the end of the number
-		break;
-	}
+	// Loop over the string until a character which isn't
+	// a number or a decimal point (Including the terminator)
+	size_t num_len = 0;
+	while((str[num_len] >= '0' && str[num_len] <= '9') || str[num_len] == '.')
+		++num_len;
 	
 	// Return value data
 	mp_read_real_data data;
+	data.val = 0.0;
+	data.delta = num_len;
 	
 	// If the number of characters read is 0, we
 	// didn't read a number
-	if(num_len == 0)
-	{
-		data.str = NULL;
-		data.delta = 0;
-	}
-	else
-	{
-		// Create a buffer big enough for the number
-		data.str = malloc(num_len + 1);
-		
-		// Update delta
-		data.delta = num_len;
-		
-		// Copy data into the buffer
-		memcpy(data.str, str, num_len);
-		
-		// Add null terminator
-		data.str[num_len] = '\0';	
-	}
+	if(num_len == 0) return data;
+	
+	// Copy the number into a null terminated buffer
+	char small[MP_REAL_BUFFER_SIZE];
+	char* buf = num_len < MP_REAL_BUFFER_SIZE ? small : malloc(num_len + 1);
+	memcpy(buf, str, num_len);
+	buf[num_len] = '\0';
 	
+	sscanf(buf, "%lf", &data.val);
+	
+	if(buf != small) free(buf);
 	return data;
 }
 
 /**
  * Function used by mp_lex_string to extract a variable name from the input string.
  * @param Input string.
- * @return See mp_read_name_data.
+ * @return See mp_read_name_data. (delta is 0 if there is no name)
  */
 static mp_read_name_data mp_read_name(const char* str)
 {
-	// Get the input string length
-	const size_t len = strlen(str);
-	
-	// List of supported characters
-	const char legal_chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
-	
-	// Loop over the string
-	size_t name_len;
-	for(name_len = 0; name_len < len; ++name_len)
-	{
-		// If the character isn't a letter or an 
-		// underscore, we've reached the end
-		// of the variable name.
-		
-		char found_lc = 0;
-		for(size_t i = 0; i < 53; ++i)
-			if(str[name_len] == legal_chars[i])
-			{
-				found_lc = 1;
-				break;
-			}
-		if(found_lc == 1) continue;
-			
-		// Otherwise, we've reached the end of the variable name
-		break;
-	}
+	// Loop over the string until a character which isn't
+	// a letter or an underscore (Including the terminator)
+	size_t name_len = 0;
+	while(
+		(str[name_len] >= 'a' && str[name_len] <= 'z') ||
+		(str[name_len] >= 'A' && str[name_len] <= 'Z') ||
+		str[name_len] == '_'
+	)
+		++name_len;
 	
 	// Return value data
 	mp_read_name_data data;
-	
-	// If the number of characters read is 0, we
-	// didn't read a varianle name
-	if(name_len == 0)
-	{
-		data.str = NULL;
-		data.delta = 0;
-	}
-	else
-	{
-		// Create a buffer big enough for the variable name
-		data.str = malloc(name_len + 1);
-		
-		// Update delta
-		data.delta = name_len;
-		
-		// Copy data into the buffer
-		memcpy(data.str, str, name_len);
-		
-		// Add null terminator
-		data.str[name_len] = '\0';	
-	}
+	data.delta = name_len;
+	data.sym = name_len == 0 ? MP_SYMBOL_ERR :
+		mp_lexer_scratch ? mp_scratch_symbol(str, name_len) : mp_intern_len(str, name_len);
 	
 	return data;
 }
 
-void mp_lex_string(const char* str)
+char mp_lex_string(const char* str)
 {
 	// String length
 	const size_t len = strlen(str);
@@ -167,6 +111,9 @@ void mp_lex_string(const char* str)
 	// Flag stating the next subtraction token is actually a negation token
 	char sub_is_neg = 1;
 	
+	// Number of parenthesis left open
+	size_t depth = 0;
+	
 	// Loop over the string
 	for(size_t i = 0; i < len; ++i)
 	{
@@ -175,6 +122,7 @@ void mp_lex_string(const char* str)
 		
 		// Token to add
 		token t;
+		t.argc = 0;
 		
 		// Ignore whitespace
 		if(c == ' ') continue;
@@ -183,7 +131,7 @@ void mp_lex_string(const char* str)
 		else if(c == '+')
 		{
 			t.id = MP_TOKEN_ADD;
-			t.str = NULL;
+			t.index = 0;
 			
 			sub_is_neg = 1;
 		}
@@ -192,7 +140,7 @@ void mp_lex_string(const char* str)
 		else if(c == '-')
 		{
 			t.id = sub_is_neg == 1 ? MP_TOKEN_NEG : MP_TOKEN_SUB;
-			t.str = NULL;
+			t.index = 0;
 			
 			sub_is_neg = 1;
 		}
@@ -201,7 +149,7 @@ void mp_lex_string(const char* str)
 		else if(c == '*')
 		{
 			t.id = MP_TOKEN_MUL;
-			t.str = NULL;
+			t.index = 0;
 			
 			sub_is_neg = 1;
 		}
@@ -210,7 +158,7 @@ void mp_lex_string(const char* str)
 		else if(c == '/')
 		{
 			t.id = MP_TOKEN_DIV;
-			t.str = NULL;
+			t.index = 0;
 			
 			sub_is_neg = 1;
 		}
@@ -219,7 +167,7 @@ void mp_lex_string(const char* str)
 		else if(c == '^')
 		{
 			t.id = MP_TOKEN_EXP;
-			t.str = NULL;
+			t.index = 0;
 			
 			sub_is_neg = 1;
 		}
@@ -228,7 +176,8 @@ void mp_lex_string(const char* str)
 		else if(c == '(')
 		{
 			t.id = MP_TOKEN_LPN;
-			t.str = NULL;
+			t.index = 0;
+			++depth;
 			
 			sub_is_neg = 1;
 		}
@@ -236,36 +185,155 @@ void mp_lex_string(const char* str)
 		// Right paren
 		else if(c == ')')
 		{
+			// The parser can't close a parenthesis which was never opened
+			if(depth == 0)
+			{
+				if(!mp_lexer_quiet) printf("Unmatched parenthesis!\n");
+				mp_flush_parser_tokens();
+				return 0;
+			}
+			
 			t.id = MP_TOKEN_RPN;
-			t.str = NULL;
+			t.index = 0;
+			--depth;
+			
+			sub_is_neg = 0;
+		}
+		
+		// Left bracket
+		else if(c == '[')
+		{
+			t.id = MP_TOKEN_LBK;
+			t.index = 0;
+			
+			sub_is_neg = 1;
+		}
+		
+		// Right bracket
+		else if(c == ']')
+		{
+			t.id = MP_TOKEN_RBK;
+			t.index = 0;
 			
 			sub_is_neg = 0;
 		}
 		
+		// Equality comparison
+		else if(c == '=' && str[i + 1] == '=')
+		{
+			t.id = MP_TOKEN_EQ;
+			t.index = 0;
+			++i;
+			
+			sub_is_neg = 1;
+		}
+		
 		// Equal sign
 		else if(c == '=')
 		{
 			t.id = MP_TOKEN_EQL;
-			t.str = NULL;
+			t.index = 0;
 			
-			sub_is_neg = 0;
+			sub_is_neg = 1;
+		}
+		
+		// Inequality comparison
+		else if(c == '!' && str[i + 1] == '=')
+		{
+			t.id = MP_TOKEN_NE;
+			t.index = 0;
+			++i;
+			
+			sub_is_neg = 1;
+		}
+		
+		// Less than (or equal) comparison
+		else if(c == '<')
+		{
+			t.id = str[i + 1] == '=' ? MP_TOKEN_LE : MP_TOKEN_LT;
+			t.index = 0;
+			if(t.id == MP_TOKEN_LE) ++i;
+			
+			sub_is_neg = 1;
+		}
+		
+		// Greater than (or equal) comparison
+		else if(c == '>')
+		{
+			t.id = str[i + 1] == '=' ? MP_TOKEN_GE : MP_TOKEN_GT;
+			t.index = 0;
+			if(t.id == MP_TOKEN_GE) ++i;
+			
+			sub_is_neg = 1;
+		}
+		
+		// Logical and
+		else if(c == '&' && str[i + 1] == '&')
+		{
+			t.id = MP_TOKEN_AND;
+			t.index = 0;
+			++i;
+			
+			sub_is_neg = 1;
 		}
 		
-		// Variable name token
-		else if((name_dat = mp_read_name(str + i)).str != NULL)
+		// Logical or
+		else if(c == '|' && str[i + 1] == '|')
+		{
+			t.id = MP_TOKEN_OR;
+			t.index = 0;
+			++i;
+			
+			sub_is_neg = 1;
+		}
+		
+		// Ternary condition
+		else if(c == '?')
+		{
+			t.id = MP_TOKEN_QST;
+			t.index = 0;
+			
+			sub_is_neg = 1;
+		}
+		
+		// Ternary alternative
+		else if(c == ':')
+		{
+			t.id = MP_TOKEN_COL;
+			t.index = 0;
+			
+			sub_is_neg = 1;
+		}
+		
+		// Function argument separator
+		else if(c == ',')
+		{
+			t.id = MP_TOKEN_COM;
+			t.index = 0;
+			
+			sub_is_neg = 1;
+		}
+		
+		// Variable or function name token
+		else if((name_dat = mp_read_name(str + i)).sym != MP_SYMBOL_ERR)
 		{
 			t.id = MP_TOKEN_VAR;
-			t.str = name_dat.str;
+			t.index = (uint32_t)name_dat.sym;
 			i += name_dat.delta - 1;
 			
+			// A name followed by a left paren is a function call
+			size_t j = i + 1;
+			while(str[j] == ' ') ++j;
+			if(str[j] == '(') t.id = MP_TOKEN_FUN;
+			
 			sub_is_neg = 0;
 		}
 		
 		// Real number token
-		else if((real_num = mp_read_real(str + i)).str != NULL)
+		else if((real_num = mp_read_real(str + i)).delta != 0)
 		{
 			t.id = MP_TOKEN_NUM;
-			t.str = real_num.str;
+			t.index = (uint32_t)mp_add_literal_to_parser(real_num.val);
 			i += real_num.delta - 1;
 			
 			sub_is_neg = 0;
@@ -274,12 +342,24 @@ void mp_lex_string(const char* str)
 		// Unkown token
 		else 
 		{
-			printf("Unexpected token!\n");
+			if(!mp_lexer_quiet) printf("Unexpected token!\n");
 			mp_flush_parser_tokens();
-			return;
+			return 0;
 		}
 		
 		// Add the token
 		mp_add_token_to_parser(t);
 	}
+	
+	return 1;
+}
+
+void mp_set_lexer_quiet(char quiet)
+{
+	mp_lexer_quiet = quiet;
+}
+
+void mp_set_lexer_scratch(char scratch)
+{
+	mp_lexer_scratch = scratch;
 }
\ No newline at end of file
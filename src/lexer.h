@@ -6,20 +6,28 @@
  * pumps those tokens into the parser.
  */
  
-// Token datatype
+/** Includes. */
+#include "stdint.h"
+
+// Token datatype (8 bytes)
 typedef struct
 {
 	// Token ID
-	int id;
+	uint8_t id;
+	
+	// Number of arguments (Function tokens only)
+	uint8_t argc;
 	
-	// Token string
-	char* str;
+	// Symbol id of variable and function names (See symbols.h),
+	// or index of numbers in the parser's literal pool
+	uint32_t index;
 	
 } token;
 
-// Token types
-#define MP_TOKEN_ERR -1
+// Largest number of arguments a function token can count
+#define MP_TOKEN_MAX_ARGC UINT8_MAX
 
+// Token types
 #define MP_TOKEN_NUM 0
 #define MP_TOKEN_VAR 1
 #define MP_TOKEN_ADD 2
@@ -34,20 +42,57 @@ typedef struct
 
 #define MP_TOKEN_EQL 10
 
+#define MP_TOKEN_LT 11
+#define MP_TOKEN_LE 12
+#define MP_TOKEN_GT 13
+#define MP_TOKEN_GE 14
+#define MP_TOKEN_EQ 15
+#define MP_TOKEN_NE 16
+#define MP_TOKEN_AND 17
+#define MP_TOKEN_OR 18
+#define MP_TOKEN_QST 19
+#define MP_TOKEN_COL 20
+
+#define MP_TOKEN_FUN 21
+#define MP_TOKEN_COM 22
+
+#define MP_TOKEN_LBK 23
+#define MP_TOKEN_RBK 24
+
+// Number of token types
+#define MP_TOKEN_COUNT 25
+
 // Token associativity types
 #define MP_LEFT_ASSOC 0
 #define MP_RIGHT_ASSOC 1
 
 // Token precedence
-extern int mp_token_precedence[8];
+extern int mp_token_precedence[MP_TOKEN_COUNT];
 
 // Token associativity
-extern char mp_token_assoc[8];
+extern char mp_token_assoc[MP_TOKEN_COUNT];
 
 /**
  * Function which reads a string, turns it into tokens,
  * and pumps those tokens into the parser.
  * @param String.
+ * @return 1 if the string was lexed successfully, 0 otherwise.
+ */
+extern char mp_lex_string(const char* str);
+
+/**
+ * Silence or restore the lexer's error messages on the calling thread.
+ * Threads answering other clients (See server.h) report errors to the
+ * client instead of the console.
+ * @param 1 to silence error messages, 0 to print them. (The default)
+ */
+extern void mp_set_lexer_quiet(char quiet);
+
+/**
+ * Lex names which were never interned into scratch symbols of the calling
+ * thread instead of interning them. (See mp_scratch_symbol) Used for
+ * untrusted input, so clients can't fill the symbol table.
+ * @param 1 to use scratch symbols, 0 to intern names. (The default)
  */
-extern void mp_lex_string(const char* str);
+extern void mp_set_lexer_scratch(char scratch);
 #endif
\ No newline at end of file
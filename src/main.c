@@ -4,10 +4,150 @@
 #include "user_input.h"
 #include "lexer.h"
 #include "parser.h"
+#include "bench.h"
+#include "server.h"
+#include "csv.h"
+#include "check.h"
+#include "numeric.h"
+
+/**
+ * Check every line of a file without evaluating anything. Prints one line per
+ * expression: "<line>\tok\t<assigned variable>\t<variables read>" if it is valid,
+ * or "<line>\terror\t<column>\t<code>\t<message>" otherwise. (Columns count from 1)
+ * @param File path, or NULL for the standard input.
+ * @return Process exit code. (1 if any expression is invalid)
+ */
+static int mp_check_lines(const char* path)
+{
+	FILE* file = path != NULL ? fopen(path, "rb") : stdin;
+	if(file == NULL)
+	{
+		fprintf(stderr, "Unable to load file!\n");
+		return 1;
+	}
+	
+	// Read everything
+	char* src = NULL;
+	size_t len = 0;
+	size_t allocated = 0;
+	size_t read;
+	do
+	{
+		if(len == allocated)
+		{
+			allocated = allocated == 0 ? 1 << 16 : allocated * 2;
+			src = realloc(src, allocated);
+		}
+		read = fread(src + len, 1, allocated - len, file);
+		len += read;
+	} while(read != 0);
+	if(file != stdin) fclose(file);
+	
+	mp_checker* checker = mp_checker_create();
+	mp_check_result res;
+	size_t lines = 0;
+	size_t invalid = 0;
+	
+	for(size_t begin = 0; begin < len;)
+	{
+		// Find the end of the line
+		const char* nl = memchr(src + begin, '\n', len - begin);
+		const size_t end = nl != NULL ? (size_t)(nl - src) : len;
+		size_t line_len = end - begin;
+		if(line_len != 0 && src[begin + line_len - 1] == '\r') --line_len;
+		
+		const char* line = src + begin;
+		++lines;
+		
+		if(mp_check(checker, line, line_len, &res))
+		{
+			printf("%zu\tok\t%.*s\t", lines, (int)res.target.len, line + res.target.begin);
+			for(size_t i = 0; i < res.var_len; ++i)
+				printf(i == 0 ? "%.*s" : " %.*s", (int)res.vars[i].len, line + res.vars[i].begin);
+			printf("\n");
+		}
+		else
+		{
+			printf("%zu\terror\t%zu\t%d\t%s\n", lines, res.pos + 1, res.code, mp_check_message(res.code));
+			++invalid;
+		}
+		
+		begin = end + 1;
+	}
+	
+	fprintf(stderr, "%zu of %zu expressions are invalid\n", invalid, lines);
+	
+	mp_checker_destroy(checker);
+	free(src);
+	return invalid != 0;
+}
 
 // Entry point
 int main(int argc, char* argv[])
 {
+	// Run benchmarks if asked to
+	if(argc >= 2 && strcmp(argv[1], "--bench") == 0)
+		return mp_run_benchmarks(argc >= 3 ? argv[2] : NULL);
+	
+	// Run the evaluation server if asked to
+	if(argc >= 2 && strcmp(argv[1], "--serve") == 0)
+	{
+		mp_init_parser();
+		const int res = mp_serve(argc >= 3 ? argv[2] : NULL, 0);
+		mp_flush_variables();
+		mp_free_parser_tokens();
+		return res;
+	}
+	
+	// Check expressions without evaluating them if asked to (--check [path])
+	if(argc >= 2 && strcmp(argv[1], "--check") == 0)
+		return mp_check_lines(argc >= 3 && strcmp(argv[2], "-") != 0 ? argv[2] : NULL);
+	
+	// Evaluate a CSV file if asked to
+	// (--csv <path> --expr <script> [--out <path>] [--threads <n>] [--aot] [--max-evals <n>] [--tolerance <t>])
+	if(argc >= 2 && strcmp(argv[1], "--csv") == 0)
+	{
+		const char* in_path = NULL;
+		const char* expr = NULL;
+		const char* out_path = NULL;
+		size_t threads = 0;
+		char aot = 0;
+		mp_numeric_limits limits = mp_numeric_default_limits();
+		for(int i = 1; i < argc; i += 2)
+		{
+			// Flags without a value
+			if(strcmp(argv[i], "--aot") == 0)
+			{
+				aot = 1;
+				--i;
+				continue;
+			}
+			if(i + 1 == argc) break;
+			
+			if(strcmp(argv[i], "--csv") == 0) in_path = argv[i + 1];
+			else if(strcmp(argv[i], "--expr") == 0) expr = argv[i + 1];
+			else if(strcmp(argv[i], "--out") == 0) out_path = argv[i + 1];
+			else if(strcmp(argv[i], "--threads") == 0) threads = (size_t)strtoul(argv[i + 1], NULL, 10);
+			else if(strcmp(argv[i], "--max-evals") == 0) limits.max_evaluations = (size_t)strtoull(argv[i + 1], NULL, 10);
+			else if(strcmp(argv[i], "--tolerance") == 0) limits.tolerance = strtod(argv[i + 1], NULL);
+		}
+		if(in_path == NULL || expr == NULL)
+		{
+			fprintf(
+				stderr,
+				"Usage: mp --csv <path> --expr <script> [--out <path>] [--threads <n>] [--aot] "
+				"[--max-evals <n>] [--tolerance <t>]\n"
+			);
+			return 1;
+		}
+		
+		mp_numeric_set_limits(limits);
+		mp_init_parser();
+		const char ok = mp_csv_run(in_path, expr, out_path, threads, aot, NULL);
+		mp_free_parser_tokens();
+		return ok ? 0 : 1;
+	}
+	
 	// Welcome message
 	printf("Welcome to the math parser!\n");
 	printf("Say \"exit\" to quit the program\n");
@@ -15,6 +155,10 @@ int main(int argc, char* argv[])
 	// Initialize the parser
 	mp_init_parser();
 	
+	// Checks input before the parser sees it
+	mp_checker* checker = mp_checker_create();
+	mp_check_result check;
+	
 	while(1)
 	{
 		// Write cursor
@@ -26,16 +170,75 @@ int main(int argc, char* argv[])
 		// Determine if we want to quit
 		if(strcmp(str, "exit") == 0) break;
 		
+		// Load an array variable from a file (load <name> <path>)
+		if(strncmp(str, "load ", 5) == 0)
+		{
+			char* name = malloc(strlen(str) + 1);
+			char* path = malloc(strlen(str) + 1);
+			if(sscanf(str + 5, "%s %s", name, path) != 2 || !mp_load_variable(name, path))
+				printf("Unable to load file!\n");
+			
+			free(name);
+			free(path);
+			free(str);
+			continue;
+		}
+		
+		// Show or set the limits of numeric builtins (limits [<max evaluations> <tolerance>])
+		if(strcmp(str, "limits") == 0 || strncmp(str, "limits ", 7) == 0)
+		{
+			mp_numeric_limits limits = mp_numeric_get_limits();
+			if(str[6] != '\0' && sscanf(str + 7, "%zu %lf", &limits.max_evaluations, &limits.tolerance) != 2)
+				printf("Usage: limits <max evaluations> <tolerance>\n");
+			else
+			{
+				mp_numeric_set_limits(limits);
+				printf("max evaluations %zu, tolerance %g\n", limits.max_evaluations, limits.tolerance);
+			}
+			
+			free(str);
+			continue;
+		}
+		
+		// Run a script file (run <path>)
+		if(strncmp(str, "run ", 4) == 0)
+		{
+			if(!mp_parse_script_file(str + 4))
+				printf("Unable to load file!\n");
+			
+			free(str);
+			continue;
+		}
+		
+		// Several statements on one line are run as a script
+		if(strchr(str, ';') != NULL)
+		{
+			mp_parse_script(str);
+			free(str);
+			continue;
+		}
+		
+		// Point out malformed input instead of evaluating it
+		if(!mp_check(checker, str, strlen(str), &check))
+		{
+			printf("%*s^\n", (int)check.pos + 2, "");
+			printf("%s!\n", mp_check_message(check.code));
+			free(str);
+			continue;
+		}
+		
 		// Lex the input
-		mp_lex_string(str);
+		const char lexed = mp_lex_string(str);
 		
 		// Free the user's string
 		free(str);
 		
 		// Parse everything
-		mp_parse_all();
+		if(lexed) mp_parse_all();
 	}
 	
+	mp_checker_destroy(checker);
+	
 	// Flush tokens and variables
 	mp_flush_parser_tokens();
 	mp_flush_variables();
@@ -0,0 +1,245 @@
+/** Includes. */
+#include "string.h"
+#include "stdlib.h"
+#include "stdatomic.h"
+#include "math.h"
+#include "symbols.h"
+#include "math_funcs.h"
+
+// Not every C library defines pi
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static double mp_func_if(const double* args) { return args[0] != 0.0 ? args[1] : args[2]; }
+static double mp_func_sqrt(const double* args) { return sqrt(args[0]); }
+static double mp_func_exp(const double* args) { return exp(args[0]); }
+static double mp_func_log(const double* args) { return log(args[0]); }
+static double mp_func_sin(const double* args) { return sin(args[0]); }
+static double mp_func_cos(const double* args) { return cos(args[0]); }
+static double mp_func_tan(const double* args) { return tan(args[0]); }
+static double mp_func_abs(const double* args) { return fabs(args[0]); }
+static double mp_func_floor(const double* args) { return floor(args[0]); }
+static double mp_func_ceil(const double* args) { return ceil(args[0]); }
+static double mp_func_min(const double* args) { return fmin(args[0], args[1]); }
+static double mp_func_max(const double* args) { return fmax(args[0], args[1]); }
+
+// Single precision versions, so single precision kernels don't round trip through double
+static float mp_ffunc_if(const float* args) { return args[0] != 0.0f ? args[1] : args[2]; }
+static float mp_ffunc_sqrt(const float* args) { return sqrtf(args[0]); }
+static float mp_ffunc_exp(const float* args) { return expf(args[0]); }
+static float mp_ffunc_log(const float* args) { return logf(args[0]); }
+static float mp_ffunc_sin(const float* args) { return sinf(args[0]); }
+static float mp_ffunc_cos(const float* args) { return cosf(args[0]); }
+static float mp_ffunc_tan(const float* args) { return tanf(args[0]); }
+static float mp_ffunc_abs(const float* args) { return fabsf(args[0]); }
+static float mp_ffunc_floor(const float* args) { return floorf(args[0]); }
+static float mp_ffunc_ceil(const float* args) { return ceilf(args[0]); }
+static float mp_ffunc_min(const float* args) { return fminf(args[0], args[1]); }
+static float mp_ffunc_max(const float* args) { return fmaxf(args[0], args[1]); }
+
+// Reductions of a single value are the value itself
+static double mp_func_identity(const double* args) { return args[0]; }
+static float mp_ffunc_identity(const float* args) { return args[0]; }
+static mp_interval mp_ifunc_identity(const mp_interval* args) { return args[0]; }
+
+static double mp_rfunc_sum(const double* vals, size_t len)
+{
+	// Independent partial sums let the loop vectorize
+	double sums[4] = { 0.0, 0.0, 0.0, 0.0 };
+	size_t i = 0;
+	for(; i + 4 <= len; i += 4)
+		for(size_t j = 0; j < 4; ++j)
+			sums[j] += vals[i + j];
+	for(; i < len; ++i) sums[0] += vals[i];
+	
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+static double mp_rfunc_mean(const double* vals, size_t len)
+{
+	return len == 0 ? NAN : mp_rfunc_sum(vals, len) / (double)len;
+}
+
+static double mp_rfunc_min(const double* vals, size_t len)
+{
+	double r = len == 0 ? NAN : vals[0];
+	for(size_t i = 1; i < len; ++i) r = vals[i] < r ? vals[i] : r;
+	return r;
+}
+
+static double mp_rfunc_max(const double* vals, size_t len)
+{
+	double r = len == 0 ? NAN : vals[0];
+	for(size_t i = 1; i < len; ++i) r = vals[i] > r ? vals[i] : r;
+	return r;
+}
+
+/**
+ * Create an interval.
+ * @param Lower bound.
+ * @param Upper bound.
+ * @return Interval.
+ */
+static mp_interval mp_make_interval(double lo, double hi)
+{
+	mp_interval r;
+	r.lo = lo;
+	r.hi = hi;
+	return r;
+}
+
+/**
+ * Apply a monotonically increasing function to an interval.
+ * @param Interval.
+ * @param Function.
+ * @return Widened range of the function over the interval.
+ */
+static mp_interval mp_interval_increasing(mp_interval x, double (*f)(double))
+{
+	// Library functions are accurate to within an ulp, so widen twice
+	return mp_interval_widen(mp_interval_widen(mp_make_interval(f(x.lo), f(x.hi))));
+}
+
+/**
+ * Range of a sine shaped function over an interval.
+ * @param Interval.
+ * @param Function.
+ * @param Location of a maximum of the function.
+ * @return Range of the function over the interval.
+ */
+static mp_interval mp_interval_wave(mp_interval x, double (*f)(double), double peak)
+{
+	const double period = 2.0 * M_PI;
+	
+	// Intervals covering a whole period hit every value
+	if(!(x.hi - x.lo < period)) return mp_make_interval(-1.0, 1.0);
+	
+	// Start with the range between the end points
+	const double f_lo = f(x.lo);
+	const double f_hi = f(x.hi);
+	mp_interval r = mp_interval_widen(mp_interval_widen(
+		mp_make_interval(fmin(f_lo, f_hi), fmax(f_lo, f_hi))
+	));
+	
+	// Extend to any maximum or minimum inside the interval, with slack for the rounding of pi
+	const double slack = 1e-9 * (1.0 + fabs(x.lo) + fabs(x.hi));
+	const double max_at = peak + period * ceil((x.lo - slack - peak) / period);
+	const double min_at = peak + M_PI + period * ceil((x.lo - slack - peak - M_PI) / period);
+	if(max_at <= x.hi + slack) r.hi = 1.0;
+	if(min_at <= x.hi + slack) r.lo = -1.0;
+	
+	return mp_make_interval(fmax(r.lo, -1.0), fmin(r.hi, 1.0));
+}
+
+static mp_interval mp_ifunc_if(const mp_interval* args)
+{
+	// Select a branch when the condition is certain, otherwise cover both
+	if(args[0].lo > 0.0 || args[0].hi < 0.0) return args[1];
+	if(args[0].lo == 0.0 && args[0].hi == 0.0) return args[2];
+	return mp_make_interval(fmin(args[1].lo, args[2].lo), fmax(args[1].hi, args[2].hi));
+}
+
+static mp_interval mp_ifunc_sqrt(const mp_interval* args)
+{
+	if(args[0].hi < 0.0) return mp_make_interval(NAN, NAN);
+	mp_interval r = mp_interval_increasing(mp_make_interval(fmax(args[0].lo, 0.0), args[0].hi), sqrt);
+	return mp_make_interval(fmax(r.lo, 0.0), r.hi);
+}
+
+static mp_interval mp_ifunc_exp(const mp_interval* args)
+{
+	mp_interval r = mp_interval_increasing(args[0], exp);
+	return mp_make_interval(fmax(r.lo, 0.0), r.hi);
+}
+
+static mp_interval mp_ifunc_log(const mp_interval* args)
+{
+	if(args[0].hi < 0.0) return mp_make_interval(NAN, NAN);
+	return mp_interval_increasing(mp_make_interval(fmax(args[0].lo, 0.0), args[0].hi), log);
+}
+
+static mp_interval mp_ifunc_sin(const mp_interval* args) { return mp_interval_wave(args[0], sin, M_PI / 2.0); }
+static mp_interval mp_ifunc_cos(const mp_interval* args) { return mp_interval_wave(args[0], cos, 0.0); }
+
+static mp_interval mp_ifunc_tan(const mp_interval* args)
+{
+	// Unbounded when the interval might contain an asymptote
+	const double slack = 1e-9 * (1.0 + fabs(args[0].lo) + fabs(args[0].hi));
+	const double pole = M_PI / 2.0 + M_PI * ceil((args[0].lo - slack - M_PI / 2.0) / M_PI);
+	if(!(args[0].hi - args[0].lo < M_PI) || pole <= args[0].hi + slack)
+		return mp_make_interval(-INFINITY, INFINITY);
+	
+	return mp_interval_increasing(args[0], tan);
+}
+
+static mp_interval mp_ifunc_abs(const mp_interval* args)
+{
+	if(args[0].lo >= 0.0) return args[0];
+	if(args[0].hi <= 0.0) return mp_make_interval(-args[0].hi, -args[0].lo);
+	return mp_make_interval(0.0, fmax(-args[0].lo, args[0].hi));
+}
+
+static mp_interval mp_ifunc_floor(const mp_interval* args) { return mp_make_interval(floor(args[0].lo), floor(args[0].hi)); }
+static mp_interval mp_ifunc_ceil(const mp_interval* args) { return mp_make_interval(ceil(args[0].lo), ceil(args[0].hi)); }
+static mp_interval mp_ifunc_min(const mp_interval* args) { return mp_make_interval(fmin(args[0].lo, args[1].lo), fmin(args[0].hi, args[1].hi)); }
+static mp_interval mp_ifunc_max(const mp_interval* args) { return mp_make_interval(fmax(args[0].lo, args[1].lo), fmax(args[0].hi, args[1].hi)); }
+
+const mp_func mp_funcs[] =
+{
+	{ "if", 3, mp_func_if, mp_ffunc_if, mp_ifunc_if, NULL },	// Must stay at MP_FUNC_IF
+	{ "sqrt", 1, mp_func_sqrt, mp_ffunc_sqrt, mp_ifunc_sqrt, NULL },
+	{ "exp", 1, mp_func_exp, mp_ffunc_exp, mp_ifunc_exp, NULL },
+	{ "log", 1, mp_func_log, mp_ffunc_log, mp_ifunc_log, NULL },
+	{ "sin", 1, mp_func_sin, mp_ffunc_sin, mp_ifunc_sin, NULL },
+	{ "cos", 1, mp_func_cos, mp_ffunc_cos, mp_ifunc_cos, NULL },
+	{ "tan", 1, mp_func_tan, mp_ffunc_tan, mp_ifunc_tan, NULL },
+	{ "abs", 1, mp_func_abs, mp_ffunc_abs, mp_ifunc_abs, NULL },
+	{ "floor", 1, mp_func_floor, mp_ffunc_floor, mp_ifunc_floor, NULL },
+	{ "ceil", 1, mp_func_ceil, mp_ffunc_ceil, mp_ifunc_ceil, NULL },
+	{ "min", 2, mp_func_min, mp_ffunc_min, mp_ifunc_min, NULL },
+	{ "max", 2, mp_func_max, mp_ffunc_max, mp_ifunc_max, NULL },
+	{ "sum", 1, mp_func_identity, mp_ffunc_identity, mp_ifunc_identity, mp_rfunc_sum },
+	{ "mean", 1, mp_func_identity, mp_ffunc_identity, mp_ifunc_identity, mp_rfunc_mean },
+	{ "min", 1, mp_func_identity, mp_ffunc_identity, mp_ifunc_identity, mp_rfunc_min },
+	{ "max", 1, mp_func_identity, mp_ffunc_identity, mp_ifunc_identity, mp_rfunc_max },
+};
+
+const size_t mp_func_count = sizeof(mp_funcs) / sizeof(mp_func);
+
+/** Symbol id of every function name, created on first use. */
+static _Atomic(size_t*) mp_func_syms = NULL;
+
+size_t mp_find_func_symbol(size_t sym, size_t argc)
+{
+	// Scratch symbols (See mp_scratch_symbol) can name functions which weren't interned yet
+	if(sym >= MP_SYMBOL_MAX && sym != MP_SYMBOL_ERR) return mp_find_func(mp_symbol_name(sym), argc);
+
+	size_t* syms = atomic_load(&mp_func_syms);
+	if(syms == NULL)
+	{
+		// Interning gives every thread the same ids, so only one table is kept
+		size_t* fresh = malloc(sizeof(size_t) * mp_func_count);
+		for(size_t i = 0; i < mp_func_count; ++i)
+			fresh[i] = mp_intern(mp_funcs[i].name);
+
+		syms = NULL;
+		if(atomic_compare_exchange_strong(&mp_func_syms, &syms, fresh)) syms = fresh;
+		else free(fresh);
+	}
+
+	for(size_t i = 0; i < mp_func_count; ++i)
+		if(syms[i] == sym && mp_funcs[i].argc == argc)
+			return i;
+
+	return MP_FUNC_ERR;
+}
+
+size_t mp_find_func(const char* name, size_t argc)
+{
+	for(size_t i = 0; i < mp_func_count; ++i)
+		if(mp_funcs[i].argc == argc && strcmp(mp_funcs[i].name, name) == 0)
+			return i;
+	
+	return MP_FUNC_ERR;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef MP_MATH_FUNCS_H
+#define MP_MATH_FUNCS_H
+
+/**
+ * Built-in functions which can be called from expressions.
+ */
+
+/** Includes. */
+#include "stddef.h"
+#include "interval.h"
+
+/** Value returned when a function can't be found. */
+#define MP_FUNC_ERR ((size_t)-1)
+
+/** Index of the conditional function if(c, a, b). */
+#define MP_FUNC_IF 0
+
+// Built-in function data type
+typedef struct
+{
+	/** Function name. */
+	const char* name;
+	
+	/** Number of arguments. */
+	size_t argc;
+	
+	/** Function pointer. Takes an array of argc arguments. */
+	double (*func)(const double* args);
+	
+	/** Single precision version of the function. */
+	float (*ffunc)(const float* args);
+	
+	/** Interval version of the function. Returns a range containing every possible result. */
+	mp_interval (*ifunc)(const mp_interval* args);
+	
+	/** Reduction over an array argument, or NULL if the function is element-wise. */
+	double (*rfunc)(const double* vals, size_t len);
+	
+} mp_func;
+
+// Built-in function table
+extern const mp_func mp_funcs[];
+
+// Number of built-in functions
+extern const size_t mp_func_count;
+
+/**
+ * Find a built-in function.
+ * @param Function name.
+ * @param Number of arguments.
+ * @return Index of the function in mp_funcs, or MP_FUNC_ERR if there is no match.
+ */
+extern size_t mp_find_func(const char* name, size_t argc);
+
+/**
+ * Find a function by the symbol id of its name. (See symbols.h)
+ * @param Symbol id of the function name.
+ * @param Number of arguments.
+ * @return Index of the function in mp_funcs, or MP_FUNC_ERR if there is no match.
+ */
+extern size_t mp_find_func_symbol(size_t sym, size_t argc);
+#endif
\ No newline at end of file
@@ -0,0 +1,576 @@
+/** Includes. */
+#include "string.h"
+#include "stdlib.h"
+#include "float.h"
+#include "math.h"
+#include "symbols.h"
+#include "program.h"
+#include "numeric.h"
+
+/** Number of rows evaluated per batch. */
+#define MP_NUMERIC_BATCH (MP_PROGRAM_BLOCK * 8)
+
+/** Number of evenly spaced points solve samples to bracket a root. */
+#define MP_NUMERIC_SCAN_POINTS 33
+
+/** Number of nodes of the Gauss-Kronrod rule used by integrate. */
+#define MP_NUMERIC_QUAD_NODES 15
+
+/** Largest magnitude of a bound of sum. (Every integer below it is exact) */
+#define MP_NUMERIC_MAX_INTEGER 9007199254740992.0
+
+/**
+ * Largest ratio of the terms of an infinite sum to the last difference
+ * between its partial sums. (Alternating series have terms a few times larger)
+ */
+#define MP_NUMERIC_SUM_TERM_RATIO 8.0
+
+/** Name of every numeric builtin, indexed by node operation - MP_NODE_SOLVE. */
+static const char* mp_numeric_names[] = { "solve", "integrate", "sum" };
+
+/** Limits used by every call. */
+static mp_numeric_limits mp_limits = { MP_NUMERIC_MAX_EVALUATIONS, MP_NUMERIC_TOLERANCE };
+
+/** Abscissae of the 15 point Kronrod rule, outermost first. (The 7 point Gauss rule uses the odd ones) */
+static const double mp_kronrod_nodes[8] =
+{
+	0.991455371120812639206854697526329,
+	0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926,
+	0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013,
+	0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245,
+	0.000000000000000000000000000000000
+};
+
+/** Weights of the 15 point Kronrod rule, matching mp_kronrod_nodes. */
+static const double mp_kronrod_weights[8] =
+{
+	0.022935322010529224963732008058970,
+	0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518,
+	0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550,
+	0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649,
+	0.209482141084727828012999174891714
+};
+
+/** Weights of the 7 point Gauss rule, for mp_kronrod_nodes 1, 3, 5 and 7. */
+static const double mp_gauss_weights[4] =
+{
+	0.129484966168869693270611432679082,
+	0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975,
+	0.417959183673469387755102040816327
+};
+
+// State of a call
+typedef struct
+{
+	/** Body, with the bound variable in slot 0. */
+	const mp_program* body;
+
+	/** Variable values for single evaluations, indexed by slot. */
+	double* vars;
+
+	/** Registers for single evaluations, or NULL until the first one. */
+	double* regs;
+
+	/** Variable columns for batches, or NULL until the first batch. */
+	const double** cols;
+
+	/** Copies of the free variables the columns point into. (MP_NUMERIC_BATCH values per slot) */
+	double* fill;
+
+	/** Number of evaluations so far. */
+	size_t evaluations;
+
+	/** Limits of the call. */
+	mp_numeric_limits limits;
+
+} mp_numeric_call;
+
+// Quadrature interval
+typedef struct
+{
+	/** Lower bound. */
+	double a;
+
+	/** Upper bound. */
+	double b;
+
+	/** Kronrod estimate of the integral. */
+	double est;
+
+	/** Estimated error. (Difference between the Kronrod and Gauss estimates) */
+	double err;
+
+} mp_quad_interval;
+
+mp_numeric_limits mp_numeric_default_limits()
+{
+	mp_numeric_limits limits;
+	limits.max_evaluations = MP_NUMERIC_MAX_EVALUATIONS;
+	limits.tolerance = MP_NUMERIC_TOLERANCE;
+	return limits;
+}
+
+mp_numeric_limits mp_numeric_get_limits()
+{
+	return mp_limits;
+}
+
+void mp_numeric_set_limits(mp_numeric_limits limits)
+{
+	mp_limits = limits;
+}
+
+int mp_find_numeric(const char* name, size_t len)
+{
+	for(size_t i = 0; i < sizeof(mp_numeric_names) / sizeof(const char*); ++i)
+		if(strncmp(mp_numeric_names[i], name, len) == 0 && mp_numeric_names[i][len] == '\0')
+			return MP_NODE_SOLVE + (int)i;
+
+	return MP_NUMERIC_ERR;
+}
+
+int mp_find_numeric_symbol(size_t sym)
+{
+	const char* name = mp_symbol_name(sym);
+	return mp_find_numeric(name, strlen(name));
+}
+
+/**
+ * Evaluate the body at a single point.
+ * @param Call.
+ * @param Value of the bound variable.
+ * @param Pointer to write the value to.
+ * @return 1 if the body was evaluated, 0 if the evaluation budget ran out.
+ */
+static char mp_numeric_point(mp_numeric_call* call, double x, double* y)
+{
+	if(call->evaluations == call->limits.max_evaluations) return 0;
+	++call->evaluations;
+
+	const mp_program* body = call->body;
+	if(call->regs == NULL) call->regs = malloc(sizeof(double) * (body->len + 1));
+
+	call->vars[0] = x;
+	mp_program_eval_regs(body, call->vars, call->regs);
+	*y = call->regs[body->outputs[0]];
+	return 1;
+}
+
+/**
+ * Evaluate the body at many points.
+ * @param Call.
+ * @param Values of the bound variable.
+ * @param Array to write the values to.
+ * @param Number of points.
+ * @return 1 if the body was evaluated, 0 if the evaluation budget ran out.
+ */
+static char mp_numeric_batch(mp_numeric_call* call, const double* xs, double* ys, size_t rows)
+{
+	if(rows > call->limits.max_evaluations - call->evaluations) return 0;
+	call->evaluations += rows;
+
+	// Free variables are broadcast from columns of copies, made on the first batch
+	const mp_program* body = call->body;
+	if(call->cols == NULL)
+	{
+		call->fill = malloc(sizeof(double) * MP_NUMERIC_BATCH * (body->var_len + 1));
+		call->cols = malloc(sizeof(double*) * (body->var_len + 1));
+		for(size_t k = 1; k < body->var_len; ++k)
+		{
+			double* col = &call->fill[k * MP_NUMERIC_BATCH];
+			for(size_t j = 0; j < MP_NUMERIC_BATCH; ++j) col[j] = call->vars[k];
+			call->cols[k] = col;
+		}
+	}
+
+	for(size_t row = 0; row < rows; row += MP_NUMERIC_BATCH)
+	{
+		const size_t block = rows - row < MP_NUMERIC_BATCH ? rows - row : MP_NUMERIC_BATCH;
+		double* out = ys + row;
+		call->cols[0] = xs + row;
+		mp_program_eval_batch(body, call->cols, block, &out);
+	}
+	return 1;
+}
+
+/**
+ * Find a root with Brent's method, after bracketing the leftmost sign
+ * change among evenly spaced points.
+ * @param Call.
+ * @param Lower bound.
+ * @param Upper bound.
+ * @return Root, or NaN.
+ */
+static double mp_numeric_solve(mp_numeric_call* call, double lo, double hi)
+{
+	if(!isfinite(lo) || !isfinite(hi)) return NAN;
+	if(lo > hi)
+	{
+		const double tmp = lo;
+		lo = hi;
+		hi = tmp;
+	}
+
+	// Sample the range in one batch
+	double xs[MP_NUMERIC_SCAN_POINTS];
+	double ys[MP_NUMERIC_SCAN_POINTS];
+	for(size_t k = 0; k < MP_NUMERIC_SCAN_POINTS; ++k)
+		xs[k] = lo + (hi - lo) * ((double)k / (MP_NUMERIC_SCAN_POINTS - 1));
+	xs[MP_NUMERIC_SCAN_POINTS - 1] = hi;
+	if(!mp_numeric_batch(call, xs, ys, MP_NUMERIC_SCAN_POINTS)) return NAN;
+
+	// Find the leftmost root or sign change
+	size_t k = 0;
+	for(; k < MP_NUMERIC_SCAN_POINTS; ++k)
+	{
+		if(ys[k] == 0.0) return xs[k];
+		if(
+			k + 1 < MP_NUMERIC_SCAN_POINTS && !isnan(ys[k]) && !isnan(ys[k + 1]) &&
+			(ys[k] < 0.0) != (ys[k + 1] < 0.0)
+		)
+			break;
+	}
+	if(k == MP_NUMERIC_SCAN_POINTS) return NAN;
+
+	// Brent's method. b is the best estimate, c the other end of the bracket and a the previous b.
+	double a = xs[k];
+	double b = xs[k + 1];
+	double fa = ys[k];
+	double fb = ys[k + 1];
+	double c = b;
+	double fc = fb;
+	double d = b - a;
+	double e = d;
+	for(;;)
+	{
+		// Keep the root between b and c
+		if((fb < 0.0) == (fc < 0.0))
+		{
+			c = a;
+			fc = fa;
+			d = e = b - a;
+		}
+		if(fabs(fc) < fabs(fb))
+		{
+			a = b;
+			b = c;
+			c = a;
+			fa = fb;
+			fb = fc;
+			fc = fa;
+		}
+
+		const double tol = 2.0 * DBL_EPSILON * fabs(b) + 0.5 * call->limits.tolerance * fmax(1.0, fabs(b));
+		const double mid = 0.5 * (c - b);
+		if(fabs(mid) <= tol || fb == 0.0) return b;
+
+		// Interpolate if the last steps were converging, bisect otherwise
+		if(fabs(e) >= tol && fabs(fa) > fabs(fb))
+		{
+			const double s = fb / fa;
+			double p;
+			double q;
+			if(a == c)
+			{
+				// Secant
+				p = 2.0 * mid * s;
+				q = 1.0 - s;
+			}
+			else
+			{
+				// Inverse quadratic interpolation
+				const double r = fb / fc;
+				q = fa / fc;
+				p = s * (2.0 * mid * q * (q - r) - (b - a) * (r - 1.0));
+				q = (q - 1.0) * (r - 1.0) * (s - 1.0);
+			}
+			if(p > 0.0) q = -q;
+			p = fabs(p);
+
+			if(2.0 * p < fmin(3.0 * mid * q - fabs(tol * q), fabs(e * q)))
+			{
+				e = d;
+				d = p / q;
+			}
+			else d = e = mid;
+		}
+		else d = e = mid;
+
+		a = b;
+		fa = fb;
+		b += fabs(d) > tol ? d : copysign(tol, mid);
+		if(!mp_numeric_point(call, b, &fb) || isnan(fb)) return NAN;
+	}
+}
+
+/**
+ * Order quadrature intervals by decreasing error.
+ * @param First interval.
+ * @param Second interval.
+ * @return Comparison result.
+ */
+static int mp_quad_compare(const void* a, const void* b)
+{
+	const double x = ((const mp_quad_interval*)a)->err;
+	const double y = ((const mp_quad_interval*)b)->err;
+	return (x < y) - (x > y);
+}
+
+/**
+ * Integrate with globally adaptive Gauss-Kronrod quadrature. Every round
+ * evaluates the nodes of all new intervals in one batch, then splits the
+ * intervals with the largest errors until the rest fit in half the tolerance.
+ * Infinite bounds are mapped to a finite range by a change of variable.
+ * @param Call.
+ * @param Lower bound.
+ * @param Upper bound.
+ * @return Integral, or NaN.
+ */
+static double mp_numeric_integrate(mp_numeric_call* call, double lo, double hi)
+{
+	if(isnan(lo) || isnan(hi)) return NAN;
+	if(lo == hi) return 0.0;
+	if(lo > hi) return -mp_numeric_integrate(call, hi, lo);
+
+	// Range of the integration variable t, x = lo + t / (1 - t), hi - (1 - t) / t or t / (1 - t^2)
+	const char lo_inf = lo == -INFINITY;
+	const char hi_inf = hi == INFINITY;
+	mp_quad_interval* leaves = malloc(sizeof(mp_quad_interval));
+	leaves[0].a = lo_inf ? (hi_inf ? -1.0 : 0.0) : (hi_inf ? 0.0 : lo);
+	leaves[0].b = hi_inf || lo_inf ? 1.0 : hi;
+	size_t len = 1;
+	size_t fresh = 0;
+
+	mp_quad_interval* next = NULL;
+	double* ts = NULL;
+	double* xs = NULL;
+	double* ys = NULL;
+	size_t allocated = 0;
+	double result = NAN;
+
+	for(;;)
+	{
+		// Nodes of every new interval: -x0, +x0, -x1, +x1, ... and the center
+		const size_t rows = (len - fresh) * MP_NUMERIC_QUAD_NODES;
+		if(rows > allocated)
+		{
+			allocated = rows * 2;
+			ts = realloc(ts, sizeof(double) * allocated);
+			xs = realloc(xs, sizeof(double) * allocated);
+			ys = realloc(ys, sizeof(double) * allocated);
+		}
+		for(size_t i = fresh; i < len; ++i)
+		{
+			const double c = 0.5 * (leaves[i].a + leaves[i].b);
+			const double h = 0.5 * (leaves[i].b - leaves[i].a);
+			double* t = &ts[(i - fresh) * MP_NUMERIC_QUAD_NODES];
+			for(size_t j = 0; j < 7; ++j)
+			{
+				t[2 * j] = c - h * mp_kronrod_nodes[j];
+				t[2 * j + 1] = c + h * mp_kronrod_nodes[j];
+			}
+			t[14] = c;
+		}
+		for(size_t j = 0; j < rows; ++j)
+		{
+			const double t = ts[j];
+			if(lo_inf && hi_inf) xs[j] = t / (1.0 - t * t);
+			else if(hi_inf) xs[j] = lo + t / (1.0 - t);
+			else if(lo_inf) xs[j] = hi - (1.0 - t) / t;
+			else xs[j] = t;
+		}
+		if(!mp_numeric_batch(call, xs, ys, rows)) goto integrate_end;
+
+		// Estimate the new intervals, scaling by the derivative of the change of variable
+		for(size_t j = 0; j < rows && (lo_inf || hi_inf); ++j)
+		{
+			const double t = ts[j];
+			if(lo_inf && hi_inf) ys[j] *= (1.0 + t * t) / ((1.0 - t * t) * (1.0 - t * t));
+			else if(hi_inf) ys[j] /= (1.0 - t) * (1.0 - t);
+			else ys[j] /= t * t;
+		}
+		for(size_t i = fresh; i < len; ++i)
+		{
+			const double* y = &ys[(i - fresh) * MP_NUMERIC_QUAD_NODES];
+			double kronrod = mp_kronrod_weights[7] * y[14];
+			double gauss = mp_gauss_weights[3] * y[14];
+			for(size_t j = 0; j < 7; ++j)
+			{
+				kronrod += mp_kronrod_weights[j] * (y[2 * j] + y[2 * j + 1]);
+				if(j % 2 == 1) gauss += mp_gauss_weights[j / 2] * (y[2 * j] + y[2 * j + 1]);
+			}
+			const double h = 0.5 * (leaves[i].b - leaves[i].a);
+			leaves[i].est = kronrod * h;
+			leaves[i].err = fabs((kronrod - gauss) * h);
+		}
+
+		// Done once the total error is within the tolerance
+		double total = 0.0;
+		double err = 0.0;
+		for(size_t i = 0; i < len; ++i)
+		{
+			total += leaves[i].est;
+			err += leaves[i].err;
+		}
+		if(isnan(total) || isnan(err)) goto integrate_end;
+		const double target = call->limits.tolerance * fmax(1.0, fabs(total));
+		if(err <= target)
+		{
+			result = total;
+			goto integrate_end;
+		}
+
+		// Split the intervals with the largest errors
+		qsort(leaves, len, sizeof(mp_quad_interval), mp_quad_compare);
+		size_t split = 0;
+		while(split < len && err > 0.5 * target) err -= leaves[split++].err;
+
+		// Kept intervals come first, then the halves of the split ones
+		next = realloc(next, sizeof(mp_quad_interval) * (len + split));
+		memcpy(next, leaves + split, sizeof(mp_quad_interval) * (len - split));
+		for(size_t i = 0; i < split; ++i)
+		{
+			const double mid = 0.5 * (leaves[i].a + leaves[i].b);
+			if(!(mid > leaves[i].a && mid < leaves[i].b)) goto integrate_end;
+
+			mp_quad_interval* half = &next[len - split + 2 * i];
+			half[0].a = leaves[i].a;
+			half[0].b = mid;
+			half[1].a = mid;
+			half[1].b = leaves[i].b;
+		}
+
+		mp_quad_interval* tmp = leaves;
+		leaves = next;
+		next = tmp;
+		fresh = len - split;
+		len += split;
+	}
+
+	// Exit point
+	integrate_end:
+
+	free(leaves);
+	free(next);
+	free(ts);
+	free(xs);
+	free(ys);
+	return result;
+}
+
+/**
+ * Sum the body over every integer from first to last, in batches, with
+ * compensated summation. An infinite sum takes partial sums after 2^k
+ * batches; once the differences between them shrink geometrically, the
+ * rest of the geometric series estimates the tail. The sum stops when two
+ * successive estimates agree within the tolerance and the terms are no
+ * larger than that difference suggests, and is NaN if the budget runs out
+ * first. (So divergent series are NaN)
+ * @param Call.
+ * @param First integer. (Rounded up)
+ * @param Last integer. (Rounded down, may be infinite)
+ * @return Sum, or NaN.
+ */
+static double mp_numeric_sum(mp_numeric_call* call, double first, double last)
+{
+	first = ceil(first);
+	last = floor(last);
+	if(isnan(first) || isnan(last) || fabs(first) > MP_NUMERIC_MAX_INTEGER) return NAN;
+	if(first > last) return 0.0;
+
+	// Finite sums must fit in the budget
+	const char infinite = last == INFINITY;
+	if(!infinite && (last > MP_NUMERIC_MAX_INTEGER || last - first >= (double)call->limits.max_evaluations))
+		return NAN;
+	const size_t count = infinite ? 0 : (size_t)(last - first) + 1;
+
+	double xs[MP_NUMERIC_BATCH];
+	double ys[MP_NUMERIC_BATCH];
+	double sum = 0.0;
+	double comp = 0.0;
+
+	// Tail estimation of infinite sums
+	size_t checkpoint = MP_NUMERIC_BATCH;
+	double prev_sum = NAN;
+	double prev_diff = NAN;
+	double prev_estimate = NAN;
+	double max_term = 0.0;
+
+	for(size_t done = 0; infinite || done < count;)
+	{
+		const size_t rows = infinite || count - done > MP_NUMERIC_BATCH ? MP_NUMERIC_BATCH : count - done;
+		for(size_t j = 0; j < rows; ++j)
+			xs[j] = first + (double)(done + j);
+		if(!mp_numeric_batch(call, xs, ys, rows)) return NAN;
+		done += rows;
+
+		// Neumaier summation
+		for(size_t j = 0; j < rows; ++j)
+		{
+			const double t = sum + ys[j];
+			comp += fabs(sum) >= fabs(ys[j]) ? (sum - t) + ys[j] : (ys[j] - t) + sum;
+			sum = t;
+			max_term = fmax(max_term, fabs(ys[j]));
+		}
+
+		if(isnan(sum)) return NAN;
+		if(!infinite || done != checkpoint) continue;
+
+		// Extrapolate the differences between partial sums as a geometric series
+		const double partial = sum + comp;
+		const double diff = partial - prev_sum;
+		const double ratio = diff / prev_diff;
+		double estimate = NAN;
+		if(diff == 0.0) estimate = partial;
+		else if(fabs(ratio) < 1.0) estimate = partial + diff * ratio / (1.0 - ratio);
+
+		// Terms of a convergent series shrink along with the differences
+		const double scale = call->limits.tolerance * fmax(1.0, fabs(estimate));
+		if(
+			fabs(estimate - prev_estimate) <= scale &&
+			max_term <= MP_NUMERIC_SUM_TERM_RATIO * fabs(diff) + scale
+		)
+			return estimate;
+
+		prev_sum = partial;
+		prev_diff = diff;
+		prev_estimate = estimate;
+		max_term = 0.0;
+		checkpoint *= 2;
+	}
+
+	return sum + comp;
+}
+
+double mp_numeric_eval(int op, const mp_program* body, double lo, double hi, double* vars)
+{
+	mp_numeric_call call;
+	call.body = body;
+	call.vars = vars;
+	call.regs = NULL;
+	call.cols = NULL;
+	call.fill = NULL;
+	call.evaluations = 0;
+	call.limits = mp_limits;
+
+	double result;
+	switch(op)
+	{
+	case MP_NODE_SOLVE: result = mp_numeric_solve(&call, lo, hi); break;
+	case MP_NODE_INTEGRATE: result = mp_numeric_integrate(&call, lo, hi); break;
+	case MP_NODE_SUM: result = mp_numeric_sum(&call, lo, hi); break;
+	default: result = NAN; break;
+	}
+
+	free(call.regs);
+	free(call.cols);
+	free(call.fill);
+	return result;
+}
@@ -0,0 +1,96 @@
+#ifndef MP_NUMERIC_H
+#define MP_NUMERIC_H
+
+/**
+ * Numeric builtins over a bound variable:
+ *
+ * solve(expr, x, lo, hi) - A root of expr in x between lo and hi.
+ * integrate(expr, x, a, b) - The integral of expr in x from a to b.
+ * sum(expr, i, first, last) - The sum of expr for every integer i from first to last.
+ *
+ * The expression is compiled once, into a program of its own (Its body,
+ * with the bound variable in slot 0), when the call is compiled. Calls
+ * then drive the body through the program evaluators: solve brackets its
+ * root with one batch over evenly spaced points and refines it one point
+ * at a time, integrate evaluates every pending quadrature node of a
+ * refinement round in one batch, and sum evaluates its terms in batches.
+ * How hard a call tries is set by mp_numeric_limits.
+ */
+
+/** Includes. */
+#include "stddef.h"
+#include "program.h"
+
+/** Value returned when a name isn't a numeric builtin. */
+#define MP_NUMERIC_ERR -1
+
+/** Number of arguments of every numeric builtin. (Expression, variable and two bounds) */
+#define MP_NUMERIC_ARGC 4
+
+/** Default maximum number of evaluations of the expression per call. */
+#define MP_NUMERIC_MAX_EVALUATIONS (1 << 20)
+
+/** Default tolerance. */
+#define MP_NUMERIC_TOLERANCE 1e-10
+
+// Limits of numeric builtin calls
+typedef struct
+{
+	/** Maximum number of evaluations of the expression per call. Calls needing more return NaN. */
+	size_t max_evaluations;
+
+	/**
+	 * Tolerance, relative to the magnitude of the result (Absolute below 1).
+	 * Bounds the width of the bracket around a root, the estimated error of
+	 * an integral and the estimated tail of an infinite sum.
+	 */
+	double tolerance;
+
+} mp_numeric_limits;
+
+/**
+ * Get the default limits.
+ * @return Limits.
+ */
+extern mp_numeric_limits mp_numeric_default_limits();
+
+/**
+ * Get the limits used by every call.
+ * @return Limits.
+ */
+extern mp_numeric_limits mp_numeric_get_limits();
+
+/**
+ * Set the limits used by every call.
+ * @param Limits.
+ * @note Not synchronized with evaluations running on other threads.
+ */
+extern void mp_numeric_set_limits(mp_numeric_limits limits);
+
+/**
+ * Find a numeric builtin by a name which isn't null terminated.
+ * @param Name.
+ * @param Length of the name.
+ * @return Node operation (MP_NODE_SOLVE, MP_NODE_INTEGRATE or MP_NODE_SUM), or MP_NUMERIC_ERR.
+ */
+extern int mp_find_numeric(const char* name, size_t len);
+
+/**
+ * Find a numeric builtin by the symbol id of its name. (See symbols.h)
+ * @param Symbol id of the name.
+ * @return Node operation (MP_NODE_SOLVE, MP_NODE_INTEGRATE or MP_NODE_SUM), or MP_NUMERIC_ERR.
+ */
+extern int mp_find_numeric_symbol(size_t sym);
+
+/**
+ * Run a numeric builtin.
+ * @param Node operation. (MP_NODE_SOLVE, MP_NODE_INTEGRATE or MP_NODE_SUM)
+ * @param Body, with the bound variable in slot 0.
+ * @param Lower bound.
+ * @param Upper bound.
+ * @param Values of the variables of the body, indexed by slot. Slot 0 is overwritten.
+ * @return Result, or NaN if there is no root in the range or the tolerance
+ * can't be met within the evaluation budget.
+ */
+extern double mp_numeric_eval(int op, const mp_program* body, double lo, double hi, double* vars);
+#endif
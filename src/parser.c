@@ -4,6 +4,13 @@
 #include "stdlib.h"
 #include "math.h"
 #include "lexer.h"
+#include "math_funcs.h"
+#include "symbols.h"
+#include "program.h"
+#include "numeric.h"
+#include "script.h"
+#include "store.h"
+#include "parser.h"
 
 /** Number of tokens to allocate at a time. */
 #define MP_TOKEN_CHUNK_SIZE 8
@@ -11,12 +18,18 @@
 // Variable data type
 typedef struct
 {
-	/** String containing variable name. */
-	char* str;
+	/** Symbol id of the variable name. */
+	size_t sym;
 	
 	/** Variable value. */
 	double val;
 	
+	/** Array of values, or NULL if the variable is a scalar. */
+	double* arr;
+	
+	/** Number of values in the array. */
+	size_t len;
+	
 } mp_var;
 
 /**
@@ -32,19 +45,36 @@ typedef struct
 	
 } pn_token;
 
-int mp_token_precedence[8] =
+int mp_token_precedence[MP_TOKEN_COUNT] =
 {
 	1,	// Number
 	1,	// Variable
-	2,	// Add
-	2,	// Subtract
-	3,	// Multiply
-	3,	// Divide
-	4,	// Negation
-	4,	// Exponentiation
+	7,	// Add
+	7,	// Subtract
+	8,	// Multiply
+	8,	// Divide
+	9,	// Negation
+	9,	// Exponentiation
+	0,	// Left paren
+	0,	// Right paren
+	0,	// Equal sign
+	6,	// Less than
+	6,	// Less than or equal
+	6,	// Greater than
+	6,	// Greater than or equal
+	5,	// Equal
+	5,	// Not equal
+	4,	// Logical and
+	3,	// Logical or
+	2,	// Ternary condition
+	1,	// Ternary alternative
+	0,	// Function
+	0,	// Comma
+	0,	// Left bracket
+	0,	// Right bracket
 };
 
-char mp_token_assoc[8] =
+char mp_token_assoc[MP_TOKEN_COUNT] =
 {
 	MP_LEFT_ASSOC,	// Number
 	MP_LEFT_ASSOC, 	// Variable
@@ -54,10 +84,27 @@ char mp_token_assoc[8] =
 	MP_LEFT_ASSOC,  // Divide
 	MP_RIGHT_ASSOC, // Negation
 	MP_RIGHT_ASSOC,	// Exponentiation
+	MP_LEFT_ASSOC,	// Left paren
+	MP_LEFT_ASSOC,	// Right paren
+	MP_RIGHT_ASSOC,	// Equal sign
+	MP_LEFT_ASSOC,	// Less than
+	MP_LEFT_ASSOC,	// Less than or equal
+	MP_LEFT_ASSOC,	// Greater than
+	MP_LEFT_ASSOC,	// Greater than or equal
+	MP_LEFT_ASSOC,	// Equal
+	MP_LEFT_ASSOC,	// Not equal
+	MP_LEFT_ASSOC,	// Logical and
+	MP_LEFT_ASSOC,	// Logical or
+	MP_RIGHT_ASSOC,	// Ternary condition
+	MP_RIGHT_ASSOC,	// Ternary alternative
+	MP_LEFT_ASSOC,	// Function
+	MP_LEFT_ASSOC,	// Comma
+	MP_LEFT_ASSOC,	// Left bracket
+	MP_LEFT_ASSOC,	// Right bracket
 };
 
-/** Token queue. */
-static struct
+/** Token queue. (One per thread, so threads can lex and compile independently) */
+static _Thread_local struct
 {
 	/** Pointer to array of token objects. */
 	token* tokens;
@@ -68,6 +115,15 @@ static struct
 	/** Number of tokens allocated. */
 	size_t allocated;
 	
+	/** Literal pool number tokens refer to. */
+	double* literals;
+	
+	/** Number of literals. */
+	size_t literal_len;
+	
+	/** Number of literals allocated. */
+	size_t literal_allocated;
+	
 } mp_token_queue;
 
 /** Variable list */
@@ -81,18 +137,61 @@ static struct
 	
 } mp_vars;
 
+/** Scalar variables, shared with other threads. */
+static mp_store* mp_var_store = NULL;
+
 
 
+static mp_var* mp_find_variable(size_t sym);
+
 void mp_init_parser()
 {
 	// Init token queue
-	mp_token_queue.tokens = malloc(sizeof(token) * MP_TOKEN_CHUNK_SIZE);
-	mp_token_queue.len = 0;
-	mp_token_queue.allocated = MP_TOKEN_CHUNK_SIZE;
+	mp_init_parser_tokens();
 	
 	// Init variable list
 	mp_vars.vars = malloc(sizeof(mp_var));
 	mp_vars.len = 0;
+	
+	// Init variable store
+	if(mp_var_store == NULL) mp_var_store = mp_store_create();
+}
+
+void mp_init_parser_tokens()
+{
+	mp_token_queue.tokens = malloc(sizeof(token) * MP_TOKEN_CHUNK_SIZE);
+	mp_token_queue.len = 0;
+	mp_token_queue.allocated = MP_TOKEN_CHUNK_SIZE;
+	
+	mp_token_queue.literals = malloc(sizeof(double) * MP_TOKEN_CHUNK_SIZE);
+	mp_token_queue.literal_len = 0;
+	mp_token_queue.literal_allocated = MP_TOKEN_CHUNK_SIZE;
+}
+
+void mp_free_parser_tokens()
+{
+	mp_flush_parser_tokens();
+	free(mp_token_queue.tokens);
+	free(mp_token_queue.literals);
+	mp_token_queue.tokens = NULL;
+	mp_token_queue.literals = NULL;
+}
+
+mp_store* mp_get_variable_store()
+{
+	return mp_var_store;
+}
+
+char mp_get_variable(const char* name, double* val)
+{
+	const size_t sym = mp_find_symbol(name);
+	if(sym == MP_SYMBOL_ERR) return 0;
+	
+	const mp_var* var = mp_find_variable(sym);
+	if(var == NULL || var->arr != NULL) return 0;
+	
+	*val = var->val;
+	return 1;
 }
 
 void mp_add_token_to_parser(token t)
@@ -103,8 +202,8 @@ void mp_add_token_to_parser(token t)
 	// Resize token queue if needed
 	if(mp_token_queue.len == mp_token_queue.allocated)
 	{
-		// Update token allocation counter
-		mp_token_queue.allocated += MP_TOKEN_CHUNK_SIZE;
+		// Double the allocation, so long programs aren't copied once per chunk
+		mp_token_queue.allocated *= 2;
 		
 		mp_token_queue.tokens = realloc(
 			mp_token_queue.tokens, 
@@ -113,15 +212,36 @@ void mp_add_token_to_parser(token t)
 	}
 }
 
+size_t mp_add_literal_to_parser(double val)
+{
+	// Resize literal pool if needed
+	if(mp_token_queue.literal_len == mp_token_queue.literal_allocated)
+	{
+		mp_token_queue.literal_allocated *= 2;
+		mp_token_queue.literals = realloc(
+			mp_token_queue.literals,
+			sizeof(double) * mp_token_queue.literal_allocated
+		);
+	}
+	
+	mp_token_queue.literals[mp_token_queue.literal_len] = val;
+	return mp_token_queue.literal_len++;
+}
+
+const double* mp_get_parser_literals()
+{
+	return mp_token_queue.literals;
+}
+
 void mp_flush_parser_tokens()
 {
-	// Loop over every token
-	for(size_t i = 0; i < mp_token_queue.len; ++i)
-		// If the token is a number or variable name...
-		if(	mp_token_queue.tokens[i].id == MP_TOKEN_NUM ||
-			mp_token_queue.tokens[i].id == MP_TOKEN_VAR)
-			// Free the string
-			free(mp_token_queue.tokens[i].str);
+	// Names are interned and numbers live in the literal pool, so tokens own nothing
+	mp_token_queue.literals = realloc(
+		mp_token_queue.literals,
+		sizeof(double) * MP_TOKEN_CHUNK_SIZE
+	);
+	mp_token_queue.literal_len = 0;
+	mp_token_queue.literal_allocated = MP_TOKEN_CHUNK_SIZE;
 
 	// Resize token queue
 	mp_token_queue.tokens = realloc(
@@ -136,12 +256,116 @@ void mp_flush_variables()
 {
 	// Loop over every variable
 	for(size_t i = 0; i < mp_vars.len; ++i)
-		// Free the variable name
-		free(mp_vars.vars[i].str);
+	{
+		// Free the variable values
+		free(mp_vars.vars[i].arr);
+	}
 	
 	// Resize the variable list
 	mp_vars.vars = realloc(mp_vars.vars, sizeof(mp_var));
 	mp_vars.len = 0;
+	
+	mp_store_clear(mp_var_store);
+}
+
+/**
+ * Find a variable by name.
+ * @param Symbol id of the variable name.
+ * @return Pointer to the variable, or NULL if there is no such variable.
+ */
+static mp_var* mp_find_variable(size_t sym)
+{
+	for(size_t i = 0; i < mp_vars.len; ++i)
+		if(mp_vars.vars[i].sym == sym)
+			return &mp_vars.vars[i];
+	
+	return NULL;
+}
+
+/**
+ * Set the value of a variable without publishing it, adding it to the list if needed.
+ * @param Symbol id of the variable name.
+ * @param Scalar value.
+ * @param Array of values (Allocated with malloc, ownership is taken), or NULL for a scalar.
+ * @param Number of values in the array.
+ */
+static void mp_store_variable(size_t sym, double val, double* arr, size_t len)
+{
+	mp_var* var = mp_find_variable(sym);
+	
+	// If we found the variable, replace its value
+	if(var != NULL)
+		free(var->arr);
+	// Otherwise add it to the list
+	else
+	{
+		var = &mp_vars.vars[mp_vars.len++];
+		var->sym = sym;
+		mp_vars.vars = realloc(mp_vars.vars, sizeof(mp_var) * (mp_vars.len + 1));
+		var = &mp_vars.vars[mp_vars.len - 1];
+	}
+	
+	var->val = val;
+	var->arr = arr;
+	var->len = len;
+}
+
+/**
+ * Assign a value to a variable, adding it to the list if needed.
+ * @param Symbol id of the variable name.
+ * @param Scalar value.
+ * @param Array of values (Allocated with malloc, ownership is taken), or NULL for a scalar.
+ * @param Number of values in the array.
+ */
+static void mp_assign_variable(size_t sym, double val, double* arr, size_t len)
+{
+	mp_store_variable(sym, val, arr, len);
+	
+	// Publish scalars to other threads, arrays aren't shared
+	mp_store_update update;
+	update.name = mp_symbol_name(sym);
+	update.val = val;
+	update.remove = arr != NULL;
+	mp_store_publish(mp_var_store, &update, 1);
+}
+
+void mp_set_array_variable(const char* name, const double* vals, size_t len)
+{
+	const size_t sym = mp_intern(name);
+	if(sym == MP_SYMBOL_ERR) return;
+	
+	// Copy the values
+	double* arr = malloc(sizeof(double) * (len + 1));
+	memcpy(arr, vals, sizeof(double) * len);
+	
+	mp_assign_variable(sym, len != 0 ? vals[0] : 0.0, arr, len);
+}
+
+char mp_load_variable(const char* name, const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if(file == NULL) return 0;
+	
+	// Get the number of values in the file
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if(size < 0)
+	{
+		fclose(file);
+		return 0;
+	}
+	
+	// Read the values
+	const size_t len = (size_t)size / sizeof(double);
+	double* vals = malloc(sizeof(double) * (len + 1));
+	const size_t read = fread(vals, sizeof(double), len, file);
+	fclose(file);
+	
+	if(read == len) mp_set_array_variable(name, vals, len);
+	
+	free(vals);
+	return read == len;
 }
 
 /**
@@ -170,25 +394,12 @@ static void mp_to_polish_notation()
 		if(tok == MP_TOKEN_NUM)
 		{
 			// Make the value negative if needed
-			char* str = mp_token_queue.tokens[i].str;
-			if(next_is_neg)
-			{
-				// Get string length
-				size_t len = strlen(str);
-				
-				// Resize string to fit negative sign
-				str = realloc(str, len + 2);
-				
-				// Shift data in string over by 1 byte
-				memmove(str + 1, str, len + 1);
-				
-				// Add negative sign
-				str[0] = '-';
-			}
+			const size_t lit = mp_token_queue.tokens[i].index;
+			if(next_is_neg) mp_token_queue.literals[lit] = -mp_token_queue.literals[lit];
 		
 			// Add token to queue
-			pn_tokens[pn_len].t.id = MP_TOKEN_NUM;
-			pn_tokens[pn_len++].t.str = str;			
+			pn_tokens[pn_len].t = mp_token_queue.tokens[i];
+			pn_tokens[pn_len++].flag = 0;
 			pn_tokens = realloc(pn_tokens, sizeof(pn_token) * (pn_len + 1));
 			
 			// Reset flag
@@ -203,6 +414,15 @@ static void mp_to_polish_notation()
 			pn_tokens[pn_len++].flag = next_is_neg;
 			pn_tokens = realloc(pn_tokens, sizeof(pn_token) * (pn_len + 1));
 			
+			// Negate the variable's value if needed
+			if(next_is_neg)
+			{
+				pn_tokens[pn_len].t.id = MP_TOKEN_NEG;
+				pn_tokens[pn_len].t.index = 0;
+				pn_tokens[pn_len++].flag = 0;
+				pn_tokens = realloc(pn_tokens, sizeof(pn_token) * (pn_len + 1));
+			}
+			
 			// Reset flag
 			next_is_neg = 0;
 		}
@@ -215,9 +435,8 @@ static void mp_to_polish_notation()
 			{
 				pn_tokens[pn_len].flag = 0;
 				pn_tokens[pn_len].t.id = MP_TOKEN_NUM;
-				pn_tokens[pn_len].t.str = malloc(2);
-				pn_tokens[pn_len].t.str[0] = '0';
-				pn_tokens[pn_len++].t.str[1] = '\0';
+				pn_tokens[pn_len].t.argc = 0;
+				pn_tokens[pn_len++].t.index = (uint32_t)mp_add_literal_to_parser(0.0);
 				pn_tokens = realloc(pn_tokens, sizeof(pn_token) * (pn_len + 1));
 			}
 	
@@ -241,18 +460,72 @@ static void mp_to_polish_notation()
 				op_tokens = realloc(op_tokens, sizeof(pn_token) * (op_len + 1));
 			}
 						
+			// Nothing to close (Only possible if the tokens didn't come from the lexer)
+			if(op_len == 0) continue;
+			
 			// Make negative if needed
 			if(op_tokens[op_len - 1].flag == 1)
 			{
 				// Add a subtraction token to the end
 				pn_tokens[pn_len].t.id = MP_TOKEN_SUB;
-				pn_tokens[pn_len].t.str = NULL;
+				pn_tokens[pn_len].t.index = 0;
 				pn_tokens[pn_len++].flag = 0;
 				pn_tokens = realloc(pn_tokens, sizeof(pn_token) * (pn_len + 1));
 			}
 			
 			// Pop left bracket
 			op_tokens = realloc(op_tokens, sizeof(pn_token) * (op_len--));
+			
+			// Pop the function the parens belonged to
+			if(op_len != 0 && op_tokens[op_len - 1].t.id == MP_TOKEN_FUN)
+			{
+				pn_tokens[pn_len++] = op_tokens[--op_len];
+				pn_tokens = realloc(pn_tokens, sizeof(pn_token) * (pn_len + 1));
+				
+				// Negate the result if needed
+				if(op_tokens[op_len].flag == 1)
+				{
+					pn_tokens[pn_len].t.id = MP_TOKEN_NEG;
+					pn_tokens[pn_len].t.index = 0;
+					pn_tokens[pn_len++].flag = 0;
+					pn_tokens = realloc(pn_tokens, sizeof(pn_token) * (pn_len + 1));
+				}
+			}
+		}
+		
+		// Function name
+		else if(tok == MP_TOKEN_FUN)
+		{
+			// Add to operator stack with a single argument so far
+			op_tokens[op_len].flag = next_is_neg;
+			op_tokens[op_len].t = mp_token_queue.tokens[i];
+			op_tokens[op_len++].t.argc = 1;
+			op_tokens = realloc(op_tokens, sizeof(pn_token) * (op_len + 1));
+			
+			// Reset flag
+			next_is_neg = 0;
+		}
+		
+		// Argument separator
+		else if(tok == MP_TOKEN_COM)
+		{
+			// Pop operators off the stack that aren't left parenthesis
+			while(op_len != 0 && op_tokens[op_len - 1].t.id != MP_TOKEN_LPN)
+			{
+				pn_tokens[pn_len++] = op_tokens[--op_len];
+				pn_tokens = realloc(pn_tokens, sizeof(pn_token) * (pn_len + 1));
+			}
+			
+			// Count another argument for the function
+			if(
+				op_len >= 2 && 
+				op_tokens[op_len - 2].t.id == MP_TOKEN_FUN &&
+				op_tokens[op_len - 2].t.argc != MP_TOKEN_MAX_ARGC
+			)
+				++op_tokens[op_len - 2].t.argc;
+			
+			// Reset flag
+			next_is_neg = 0;
 		}
 		
 		// Negation operator
@@ -275,6 +548,8 @@ static void mp_to_polish_notation()
 				while(
 					// Stack must not be empty
 					op_len != 0 &&
+					// Not a left bracket
+					op_tok != MP_TOKEN_LPN &&
 					(
 						// Precedence is greater
 						mp_token_precedence[op_tok] > mp_token_precedence[tok]  ||
@@ -282,9 +557,7 @@ static void mp_to_polish_notation()
 						(
 							mp_token_precedence[op_tok] == mp_token_precedence[tok] && 
 							mp_token_assoc[op_tok] == MP_LEFT_ASSOC
-						) &&
-						// Not a left bracket
-						op_tok != MP_TOKEN_LPN
+						)
 					)
 				)
 				{	
@@ -334,6 +607,15 @@ static void mp_to_polish_notation()
 	// 	printf("%d ", mp_token_queue.tokens[i].id);
 }
 
+const token* mp_get_polish_tokens(size_t* len)
+{
+	// Convert token queue into polish notation
+	mp_to_polish_notation();
+	
+	*len = mp_token_queue.len;
+	return mp_token_queue.tokens;
+}
+
 /**
  * Evaluate the token queue.
  * @return Result of the evaluation.
@@ -356,12 +638,8 @@ static double mp_evaluate_tokens()
 		// If token is a number...
 		case MP_TOKEN_NUM:
 			{
-				// Convert token to a double
-				double operand;
-				sscanf(mp_token_queue.tokens[i].str, "%lf", &operand);
-			
-				// Push it onto the operand stack
-				opnd_stack[opnd_len++] = operand;
+				// Push the literal onto the operand stack
+				opnd_stack[opnd_len++] = mp_token_queue.literals[mp_token_queue.tokens[i].index];
 				opnd_stack = realloc(opnd_stack, sizeof(double) * (opnd_len + 1));
 			}
 			break;
@@ -369,36 +647,22 @@ static double mp_evaluate_tokens()
 		// If the token is a variable
 		case MP_TOKEN_VAR:
 			{
-				// Loop for the variable in the list
-				char found = 0;
-				for(size_t j = 0; j < mp_vars.len; ++j)
-				{
-					if(strcmp(
-						mp_vars.vars[j].str, 
-						mp_token_queue.tokens[i].str
-						) == 0
-					)
-					{
-						// Push it onto the operand stack
-						opnd_stack[opnd_len++] = mp_vars.vars[j].val;
-						opnd_stack = realloc(
-							opnd_stack, 
-							sizeof(double) * (opnd_len + 1)
-						);
-						found = 1;
-						break;
-					}
-				}				
+				// Look for the variable in the list
+				const mp_var* var = mp_find_variable(mp_token_queue.tokens[i].index);
 				
 				// If we didn't find it, throw an error
-				if(found == 0) 
+				if(var == NULL) 
 				{
 					printf(
 						"Unable to locate variable \"%s\"\n", 
-						mp_token_queue.tokens[i].str
+						mp_symbol_name(mp_token_queue.tokens[i].index)
 					);
 					goto parse_failure;
 				}
+				
+				// Push it onto the operand stack
+				opnd_stack[opnd_len++] = var->val;
+				opnd_stack = realloc(opnd_stack, sizeof(double) * (opnd_len + 1));
 			}
 			break;
 		
@@ -410,6 +674,50 @@ static double mp_evaluate_tokens()
 			}
 			break;
 		
+		// Ternary conditions are resolved by the alternative
+		case MP_TOKEN_QST:
+			break;
+		
+		// If token is a ternary alternative...
+		case MP_TOKEN_COL:
+			{
+				// Pop condition and both values from the stack
+				const double operand_3 = opnd_stack[--opnd_len];
+				const double operand_2 = opnd_stack[--opnd_len];
+				const double cond = opnd_stack[--opnd_len];
+				
+				// Push the selected value onto the stack
+				opnd_stack[opnd_len++] = cond != 0.0 ? operand_2 : operand_3;
+				opnd_stack = realloc(opnd_stack, sizeof(double) * (opnd_len + 1));
+			}
+			break;
+		
+		// If token is a function call...
+		case MP_TOKEN_FUN:
+			{
+				const size_t argc = (size_t)mp_token_queue.tokens[i].argc;
+				
+				// Look for the function
+				const size_t func = mp_find_func_symbol(mp_token_queue.tokens[i].index, argc);
+				
+				// If we didn't find it, throw an error
+				if(func == MP_FUNC_ERR || opnd_len < argc)
+				{
+					printf(
+						"Unable to locate function \"%s\" taking %zu arguments\n", 
+						mp_symbol_name(mp_token_queue.tokens[i].index),
+						argc
+					);
+					goto parse_failure;
+				}
+				
+				// Arguments are the top argc operands, in order
+				opnd_len -= argc;
+				opnd_stack[opnd_len] = mp_funcs[func].func(&opnd_stack[opnd_len]);
+				opnd_stack = realloc(opnd_stack, sizeof(double) * (++opnd_len + 1));
+			}
+			break;
+		
 		// Otherwise it is an operator...
 		default:
 			{
@@ -440,6 +748,38 @@ static double mp_evaluate_tokens()
 				case MP_TOKEN_EXP:
 					operand_2 = pow(operand_2, operand_1);
 					break;
+					
+				case MP_TOKEN_LT:
+					operand_2 = operand_2 < operand_1;
+					break;
+					
+				case MP_TOKEN_LE:
+					operand_2 = operand_2 <= operand_1;
+					break;
+					
+				case MP_TOKEN_GT:
+					operand_2 = operand_2 > operand_1;
+					break;
+					
+				case MP_TOKEN_GE:
+					operand_2 = operand_2 >= operand_1;
+					break;
+					
+				case MP_TOKEN_EQ:
+					operand_2 = operand_2 == operand_1;
+					break;
+					
+				case MP_TOKEN_NE:
+					operand_2 = operand_2 != operand_1;
+					break;
+					
+				case MP_TOKEN_AND:
+					operand_2 = operand_2 != 0.0 && operand_1 != 0.0;
+					break;
+					
+				case MP_TOKEN_OR:
+					operand_2 = operand_2 != 0.0 || operand_1 != 0.0;
+					break;
 				}
 				
 				// Push result onto the stack
@@ -466,6 +806,186 @@ static double mp_evaluate_tokens()
 	return 0.0;
 }
 
+/**
+ * Determine if the token queue references an array variable.
+ * @return 1 if an array variable is referenced, 0 otherwise.
+ */
+static char mp_uses_array_variable()
+{
+	for(size_t i = 0; i < mp_token_queue.len; ++i)
+		if(mp_token_queue.tokens[i].id == MP_TOKEN_VAR)
+		{
+			const mp_var* var = mp_find_variable(mp_token_queue.tokens[i].index);
+			if(var != NULL && var->arr != NULL) return 1;
+		}
+	
+	return 0;
+}
+
+/**
+ * Determine if the token queue calls a numeric builtin. (See numeric.h)
+ * @return 1 if a numeric builtin is called, 0 otherwise.
+ */
+static char mp_uses_numeric_builtin()
+{
+	for(size_t i = 0; i < mp_token_queue.len; ++i)
+		if(
+			mp_token_queue.tokens[i].id == MP_TOKEN_FUN &&
+			mp_find_numeric_symbol(mp_token_queue.tokens[i].index) != MP_NUMERIC_ERR
+		)
+			return 1;
+	
+	return 0;
+}
+
+/**
+ * Read an array literal, like [1, -2, 3.5], from the token queue.
+ * @param Pointer to write the array to. (Allocated with malloc, must be freed)
+ * @param Pointer to write the number of values to.
+ * @return 1 if the array was read, 0 otherwise.
+ */
+static char mp_read_array(double** arr, size_t* len)
+{
+	*arr = malloc(sizeof(double) * (mp_token_queue.len + 1));
+	*len = 0;
+	
+	// Loop over the tokens between the brackets
+	size_t i = 1;
+	while(i < mp_token_queue.len && mp_token_queue.tokens[i].id != MP_TOKEN_RBK)
+	{
+		// Separate values with commas
+		if(*len != 0)
+		{
+			if(mp_token_queue.tokens[i].id != MP_TOKEN_COM) break;
+			++i;
+		}
+		
+		// Optional negation
+		char neg = 0;
+		if(i < mp_token_queue.len && mp_token_queue.tokens[i].id == MP_TOKEN_NEG)
+		{
+			neg = 1;
+			++i;
+		}
+		
+		// Value
+		if(i >= mp_token_queue.len || mp_token_queue.tokens[i].id != MP_TOKEN_NUM) break;
+		(*arr)[*len] = mp_token_queue.literals[mp_token_queue.tokens[i].index];
+		if(neg) (*arr)[*len] = -(*arr)[*len];
+		++*len;
+		++i;
+	}
+	
+	// Must end with the right bracket
+	if(i + 1 != mp_token_queue.len || mp_token_queue.tokens[i].id != MP_TOKEN_RBK)
+	{
+		free(*arr);
+		return 0;
+	}
+	
+	return 1;
+}
+
+/**
+ * Evaluate the token queue element-wise over array variables.
+ * @param Pointer to write the resulting array to, or NULL if the result is a scalar.
+ * (Allocated with malloc, must be freed)
+ * @param Pointer to write the number of values to.
+ * @param Pointer to write the scalar result (or first value) to.
+ * @return 1 if the expression was evaluated, 0 otherwise.
+ */
+static char mp_evaluate_array(double** arr, size_t* len, double* val)
+{
+	// Compile the expression
+	mp_to_polish_notation();
+	mp_program* prog = mp_program_create();
+	prog->reductions = 1;
+	if(mp_program_add_tokens(prog, mp_token_queue.tokens, mp_token_queue.len, mp_token_queue.literals) == MP_PROGRAM_ERR)
+	{
+		printf("Invalid expression!\n");
+		mp_program_destroy(prog);
+		return 0;
+	}
+	
+	// Bind the variables
+	const double** vals = malloc(sizeof(double*) * (prog->var_len + 1));
+	size_t* lens = malloc(sizeof(size_t) * (prog->var_len + 1));
+	size_t rows = MP_PROGRAM_ERR;
+	for(size_t i = 0; i < prog->var_len; ++i)
+	{
+		mp_var* var = mp_find_variable(prog->syms[i]);
+		if(var == NULL)
+		{
+			printf("Unable to locate variable \"%s\"\n", prog->vars[i]);
+			goto eval_failure;
+		}
+		
+		// Scalars are broadcast
+		if(var->arr == NULL)
+		{
+			vals[i] = &var->val;
+			lens[i] = 1;
+			continue;
+		}
+		
+		// Every array must have the same length
+		if(rows != MP_PROGRAM_ERR && rows != var->len)
+		{
+			printf("Array lengths don't match!\n");
+			goto eval_failure;
+		}
+		
+		vals[i] = var->arr;
+		lens[i] = rows = var->len;
+	}
+	const char scalar = rows == MP_PROGRAM_ERR;
+	if(scalar) rows = 1;
+	
+	// Evaluate
+	double* out = malloc(sizeof(double) * (rows + 1));
+	mp_program_eval_broadcast(prog, vals, lens, rows, &out, len);
+	*val = *len != 0 ? out[0] : 0.0;
+	
+	// Scalar results don't need the array
+	if(*len == 1 && (rows != 1 || scalar))
+	{
+		free(out);
+		*arr = NULL;
+	}
+	else *arr = out;
+	
+	free(vals);
+	free(lens);
+	mp_program_destroy(prog);
+	return 1;
+	
+	// Failure jump point
+	eval_failure:
+	
+	free(vals);
+	free(lens);
+	mp_program_destroy(prog);
+	return 0;
+}
+
+/**
+ * Print an array of values.
+ * @param Array.
+ * @param Number of values.
+ */
+static void mp_print_array(const double* arr, size_t len)
+{
+	// Long arrays are cut short
+	const size_t shown = len < 16 ? len : 16;
+	
+	printf("[");
+	for(size_t i = 0; i < shown; ++i)
+		printf(i == 0 ? "%lf" : ", %lf", arr[i]);
+	if(shown != len)
+		printf(", ... (%zu values)", len);
+	printf("]\n");
+}
+
 void mp_parse_all()
 {
 	// Detect if we are assigning a variable a value
@@ -489,29 +1009,50 @@ void mp_parse_all()
 			sizeof(token) * (mp_token_queue.len -= 2)
 		);
 		
-		// Convert token queue into polish notation
-		mp_to_polish_notation();
-		
-		// Evaluate tokens
-		const double eval = mp_evaluate_tokens();
-		
-		// Look for the token
-		char found = 0;
-		for(size_t i = 0; i < mp_vars.len; ++i)
-			if(strcmp(mp_vars.vars[i].str, var.str) == 0)
-			{
-				// Update token value
-				mp_vars.vars[i].val = eval;
-				found = 1;
-				break;
-			}
+		// Assigning an array literal
+		if(mp_token_queue.len != 0 && mp_token_queue.tokens[0].id == MP_TOKEN_LBK)
+		{
+			double* arr;
+			size_t len;
+			if(mp_read_array(&arr, &len))
+				mp_assign_variable(var.index, len != 0 ? arr[0] : 0.0, arr, len);
+			else
+				printf("Invalid array!\n");
+		}
+		// Assigning an expression over arrays, or one only compiled programs can run
+		else if(mp_uses_array_variable() || mp_uses_numeric_builtin())
+		{
+			double* arr;
+			size_t len;
+			double val;
+			if(mp_evaluate_array(&arr, &len, &val))
+				mp_assign_variable(var.index, val, arr, len);
+		}
+		// Assigning a scalar expression
+		else
+		{
+			// Convert token queue into polish notation
+			mp_to_polish_notation();
+			
+			// Evaluate tokens
+			const double eval = mp_evaluate_tokens();
 			
-		// If we didn't find the variable, add it to the list
-		if(found == 0)
+			// Update the variable
+			mp_assign_variable(var.index, eval, NULL, 0);
+		}
+	}
+	// Must be evaluating an expression over arrays, or one only compiled programs can run...
+	else if(mp_uses_array_variable() || mp_uses_numeric_builtin())
+	{
+		double* arr;
+		size_t len;
+		double val;
+		if(mp_evaluate_array(&arr, &len, &val))
 		{
-			mp_vars.vars[mp_vars.len].str = var.str;
-			mp_vars.vars[mp_vars.len++].val = eval;
-			mp_vars.vars = realloc(mp_vars.vars, sizeof(mp_var) * (mp_vars.len + 1));
+			// Print result
+			if(arr != NULL) mp_print_array(arr, len);
+			else printf("%lf\n", val);
+			free(arr);
 		}
 	}
 	// Must be evaluating an expression...
@@ -529,4 +1070,91 @@ void mp_parse_all()
 	
 	// Flush the token queue
 	mp_flush_parser_tokens();
-}
\ No newline at end of file
+}
+
+void mp_parse_script(const char* src)
+{
+	// Compile every statement
+	size_t line;
+	mp_script* script = mp_script_create(src, &line);
+	if(script == NULL)
+	{
+		printf("Invalid statement on line %zu!\n", line);
+		return;
+	}
+	
+	// Bind the variables the script reads
+	const mp_program* prog = script->prog;
+	double* vars = calloc(prog->var_len + 1, sizeof(double));
+	double* out = malloc(sizeof(double) * (prog->out_len + 1));
+	for(size_t i = 0; i < prog->var_len; ++i)
+	{
+		if(!script->used[i]) continue;
+		
+		const mp_var* var = mp_find_variable(prog->syms[i]);
+		if(var == NULL || var->arr != NULL)
+		{
+			printf(
+				var == NULL ? "Unable to locate variable \"%s\"\n" : "Array variable \"%s\" can't be used in a script\n", 
+				prog->vars[i]
+			);
+			goto script_failure;
+		}
+		vars[i] = var->val;
+	}
+	
+	// Run the whole script at once
+	mp_program_eval(prog, vars, out);
+	
+	// Print the expression statements
+	for(size_t i = 0; i < script->result_len; ++i)
+		printf("%lf\n", out[i]);
+	
+	// Store the assigned variables and publish them together
+	mp_store_update* updates = malloc(sizeof(mp_store_update) * (script->assign_len + 1));
+	for(size_t i = 0; i < script->assign_len; ++i)
+	{
+		const double val = out[script->result_len + i];
+		mp_store_variable(script->assigns[i], val, NULL, 0);
+		updates[i].name = mp_symbol_name(script->assigns[i]);
+		updates[i].val = val;
+		updates[i].remove = 0;
+	}
+	if(script->assign_len != 0) mp_store_publish(mp_var_store, updates, script->assign_len);
+	free(updates);
+	
+	// Failure jump point
+	script_failure:
+	
+	free(vars);
+	free(out);
+	mp_script_destroy(script);
+}
+
+char mp_parse_script_file(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if(file == NULL) return 0;
+	
+	// Read the whole file
+	char* src = NULL;
+	size_t len = 0;
+	size_t allocated = 0;
+	size_t read;
+	do
+	{
+		if(len == allocated)
+		{
+			allocated = allocated == 0 ? 4096 : allocated * 2;
+			src = realloc(src, allocated + 1);
+		}
+		read = fread(src + len, 1, allocated - len, file);
+		len += read;
+	} while(read != 0);
+	fclose(file);
+	
+	src[len] = '\0';
+	mp_parse_script(src);
+	free(src);
+	return 1;
+}
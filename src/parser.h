@@ -6,19 +6,64 @@
  */
  
 /** Includes. */
+#include "stddef.h"
 #include "lexer.h"
+#include "store.h"
 
 /**
  * Initialize the parser.
  */
 extern void mp_init_parser();
 
+/**
+ * Initialize the calling thread's token queue.
+ * @note mp_init_parser does this for the thread that calls it.
+ * Other threads which lex or compile must call this first.
+ */
+extern void mp_init_parser_tokens();
+
+/**
+ * Free the calling thread's token queue.
+ */
+extern void mp_free_parser_tokens();
+
+/**
+ * Get the store scalar variables are published to whenever they are assigned.
+ * @return Variable store. Other threads read variables through snapshots of it.
+ */
+extern mp_store* mp_get_variable_store();
+
+/**
+ * Get the value of a scalar variable.
+ * @param Variable name.
+ * @param Pointer to write the value to.
+ * @return 1 if the variable exists and is a scalar, 0 otherwise.
+ * @note Only safe to call from the thread assigning variables. Use mp_get_variable_store elsewhere.
+ */
+extern char mp_get_variable(const char* name, double* val);
+
 /**
  * Add a token to the parser token queue.
  * @param Token to add.
  */
 extern void mp_add_token_to_parser(token t);
 
+/**
+ * Add a number to the parser literal pool. Number tokens refer to
+ * literals by their index in the pool.
+ * @param Value.
+ * @return Index of the literal.
+ * @note The pool is flushed along with the token queue.
+ */
+extern size_t mp_add_literal_to_parser(double val);
+
+/**
+ * Get the parser literal pool of the calling thread.
+ * @return Pointer to the literals, indexed by number tokens.
+ * @note The pointer is invalidated when literals are added.
+ */
+extern const double* mp_get_parser_literals();
+
 /**
  * Flush the parsers token queue.
  */
@@ -29,8 +74,48 @@ extern void mp_flush_parser_tokens();
  */
 extern void mp_flush_variables();
 
+/**
+ * Bind a variable to an array of values.
+ * @param Variable name.
+ * @param Values to copy into the variable.
+ * @param Number of values.
+ */
+extern void mp_set_array_variable(const char* name, const double* vals, size_t len);
+
+/**
+ * Bind a variable to an array of values read from a binary file of native doubles.
+ * @param Variable name.
+ * @param File path.
+ * @return 1 if the file was loaded, 0 otherwise.
+ */
+extern char mp_load_variable(const char* name, const char* path);
+
+/**
+ * Convert the token queue into polish notation without evaluating it.
+ * @param Pointer to write the number of tokens to.
+ * @return Pointer to the converted tokens.
+ * @note The tokens remain owned by the parser until the queue is flushed.
+ */
+extern const token* mp_get_polish_tokens(size_t* len);
+
 /**
  * Parse and execute the expressions described in the token queue.
  */
 extern void mp_parse_all();
+
+/**
+ * Compile and run a script of statements separated by semicolons or newlines.
+ * Every statement is compiled into one program, which is evaluated once.
+ * Expression statements are printed and assigned variables are stored.
+ * @param Script source. (See script.h)
+ * @note Nothing is assigned if a statement is invalid or reads an unknown variable.
+ */
+extern void mp_parse_script(const char* src);
+
+/**
+ * Compile and run a script read from a file.
+ * @param File path.
+ * @return 1 if the file was read, 0 otherwise.
+ */
+extern char mp_parse_script_file(const char* path);
 #endif
\ No newline at end of file
@@ -0,0 +1,1572 @@
+/** Includes. */
+#include "string.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "stdint.h"
+#include "math.h"
+#include "lexer.h"
+#include "parser.h"
+#include "math_funcs.h"
+#include "symbols.h"
+#include "numeric.h"
+#include "program.h"
+
+/** Number of nodes to allocate at a time. */
+#define MP_NODE_CHUNK_SIZE 32
+
+/** Initial size of the node hash table. */
+#define MP_TABLE_INIT_SIZE 64
+
+/** Number of rows evaluated at a time when broadcasting scalars. */
+#define MP_BROADCAST_CHUNK (MP_PROGRAM_BLOCK * 32)
+
+/**
+ * Hash the contents of a node.
+ * @param Node.
+ * @return Hash value.
+ */
+static size_t mp_hash_node(const mp_node* n)
+{
+	// Value bits of number nodes
+	uint64_t bits;
+	memcpy(&bits, &n->val, sizeof(bits));
+
+	// Mix every field into the hash
+	uint64_t h = 14695981039346656037ULL;
+	h = (h ^ (uint64_t)n->op) * 1099511628211ULL;
+	for(size_t i = 0; i < MP_NODE_MAX_ARGS; ++i)
+		h = (h ^ (uint64_t)n->args[i]) * 1099511628211ULL;
+	h = (h ^ bits) * 1099511628211ULL;
+	h = (h ^ (uint64_t)n->slot) * 1099511628211ULL;
+
+	return (size_t)(h ^ (h >> 29));
+}
+
+/**
+ * Determine if two nodes have the same contents.
+ * @param First node.
+ * @param Second node.
+ * @return 1 if the nodes are equal, 0 otherwise.
+ */
+static char mp_nodes_equal(const mp_node* a, const mp_node* b)
+{
+	if(a->op != b->op || a->slot != b->slot) return 0;
+
+	for(size_t i = 0; i < MP_NODE_MAX_ARGS; ++i)
+		if(a->args[i] != b->args[i]) return 0;
+
+	// Compare number values bitwise so -0.0 and NaN payloads stay distinct
+	return memcmp(&a->val, &b->val, sizeof(double)) == 0;
+}
+
+/**
+ * Insert a node index into the hash table.
+ * @param Program.
+ * @param Node index.
+ */
+static void mp_table_insert(mp_program* prog, size_t index)
+{
+	size_t mask = prog->table_len - 1;
+	size_t h = mp_hash_node(&prog->nodes[index]) & mask;
+
+	// Linear probe for an empty bucket
+	while(prog->table[h] != 0) h = (h + 1) & mask;
+	prog->table[h] = index + 1;
+}
+
+/**
+ * Add a node to a program, reusing an identical node if one already exists.
+ * @param Program.
+ * @param Node to add.
+ * @return Index of the node.
+ */
+static size_t mp_program_intern(mp_program* prog, mp_node n)
+{
+	// Put the operands of commutative operators in a canonical order
+	const char commutative =
+		n.op == MP_TOKEN_ADD || n.op == MP_TOKEN_MUL ||
+		n.op == MP_TOKEN_EQ || n.op == MP_TOKEN_NE ||
+		n.op == MP_TOKEN_AND || n.op == MP_TOKEN_OR;
+	if(commutative && n.args[0] > n.args[1])
+	{
+		size_t tmp = n.args[0];
+		n.args[0] = n.args[1];
+		n.args[1] = tmp;
+	}
+
+	// Look for an identical node
+	size_t mask = prog->table_len - 1;
+	size_t h = mp_hash_node(&n) & mask;
+	while(prog->table[h] != 0)
+	{
+		if(mp_nodes_equal(&prog->nodes[prog->table[h] - 1], &n))
+			return prog->table[h] - 1;
+		h = (h + 1) & mask;
+	}
+
+	// Resize the node list if needed
+	if(prog->len == prog->allocated)
+	{
+		prog->allocated *= 2;
+		prog->nodes = realloc(prog->nodes, sizeof(mp_node) * prog->allocated);
+	}
+
+	// Add the node
+	const size_t index = prog->len++;
+	prog->nodes[index] = n;
+
+	// Grow the hash table once it is half full
+	if(prog->len * 2 > prog->table_len)
+	{
+		free(prog->table);
+		prog->table_len *= 2;
+		prog->table = calloc(prog->table_len, sizeof(size_t));
+		for(size_t i = 0; i < prog->len; ++i)
+			mp_table_insert(prog, i);
+	}
+	else prog->table[h] = index + 1;
+
+	return index;
+}
+
+/**
+ * Get the slot of a variable, adding it to the program if needed.
+ * @param Program.
+ * @param Symbol id of the variable name.
+ * @return Variable slot.
+ */
+static size_t mp_program_var_slot(mp_program* prog, size_t sym)
+{
+	// Look for an existing slot
+	for(size_t i = 0; i < prog->var_len; ++i)
+		if(prog->syms[i] == sym)
+			return i;
+
+	// Add a new slot
+	prog->vars = realloc(prog->vars, sizeof(const char*) * (prog->var_len + 1));
+	prog->syms = realloc(prog->syms, sizeof(size_t) * (prog->var_len + 1));
+	prog->vars[prog->var_len] = mp_symbol_name(sym);
+	prog->syms[prog->var_len] = sym;
+
+	return prog->var_len++;
+}
+
+size_t mp_node_argc(const mp_node* n)
+{
+	switch(n->op)
+	{
+	case MP_TOKEN_NUM:
+	case MP_TOKEN_VAR:
+		return 0;
+
+	case MP_TOKEN_NEG:
+		return 1;
+
+	case MP_TOKEN_COL:
+	case MP_NODE_FMA:
+	case MP_NODE_SOLVE:
+	case MP_NODE_INTEGRATE:
+	case MP_NODE_SUM:
+		return 3;
+
+	case MP_TOKEN_FUN:
+		return mp_funcs[n->slot].argc;
+
+	default:
+		return 2;
+	}
+}
+
+double mp_node_apply(const mp_node* n, const double* args)
+{
+	switch(n->op)
+	{
+	case MP_TOKEN_NUM: return n->val;
+	case MP_TOKEN_NEG: return -args[0];
+	case MP_TOKEN_ADD: return args[0] + args[1];
+	case MP_TOKEN_SUB: return args[0] - args[1];
+	case MP_TOKEN_MUL: return args[0] * args[1];
+	case MP_TOKEN_DIV: return args[0] / args[1];
+	case MP_TOKEN_EXP: return pow(args[0], args[1]);
+	case MP_TOKEN_LT: return args[0] < args[1];
+	case MP_TOKEN_LE: return args[0] <= args[1];
+	case MP_TOKEN_GT: return args[0] > args[1];
+	case MP_TOKEN_GE: return args[0] >= args[1];
+	case MP_TOKEN_EQ: return args[0] == args[1];
+	case MP_TOKEN_NE: return args[0] != args[1];
+	case MP_TOKEN_AND: return args[0] != 0.0 && args[1] != 0.0;
+	case MP_TOKEN_OR: return args[0] != 0.0 || args[1] != 0.0;
+	case MP_TOKEN_COL: return args[0] != 0.0 ? args[1] : args[2];
+	case MP_TOKEN_FUN: return mp_funcs[n->slot].func(args);
+	case MP_NODE_FMA: return MP_FMA(args[0], args[1], args[2]);
+	default: return 0.0;
+	}
+}
+
+mp_program* mp_program_create()
+{
+	mp_program* prog = malloc(sizeof(mp_program));
+
+	// Init node list
+	prog->nodes = malloc(sizeof(mp_node) * MP_NODE_CHUNK_SIZE);
+	prog->len = 0;
+	prog->allocated = MP_NODE_CHUNK_SIZE;
+
+	// Init variable and output lists
+	prog->vars = NULL;
+	prog->syms = NULL;
+	prog->var_len = 0;
+	prog->outputs = NULL;
+	prog->out_len = 0;
+
+	// Init hash table
+	prog->table = calloc(MP_TABLE_INIT_SIZE, sizeof(size_t));
+	prog->table_len = MP_TABLE_INIT_SIZE;
+	prog->dedup_count = 0;
+
+	// Init bind table
+	prog->binds = NULL;
+	prog->bind_len = 0;
+
+	// Init body list
+	prog->bodies = NULL;
+	prog->body_len = 0;
+	prog->reductions = 0;
+
+	return prog;
+}
+
+void mp_program_destroy(mp_program* prog)
+{
+	for(size_t i = 0; i < prog->body_len; ++i)
+		mp_program_destroy(prog->bodies[i]);
+	free(prog->bodies);
+	free(prog->vars);
+	free(prog->syms);
+	free(prog->outputs);
+	free(prog->nodes);
+	free(prog->table);
+	free(prog->binds);
+	free(prog);
+}
+
+/**
+ * Add the body of a numeric builtin to a program.
+ * @param Program.
+ * @param Body. (Owned by the program from now on)
+ * @return Body index.
+ */
+static size_t mp_program_add_body(mp_program* prog, mp_program* body)
+{
+	prog->bodies = realloc(prog->bodies, sizeof(mp_program*) * (prog->body_len + 1));
+	prog->bodies[prog->body_len] = body;
+	return prog->body_len++;
+}
+
+/**
+ * Find the nodes holding the values of the free variables of a numeric builtin's body.
+ * @param Program.
+ * @param Numeric builtin node.
+ * @param Array to write the node of every free variable to, indexed by body slot. (Slot 0 is skipped)
+ */
+static void mp_program_env_nodes(const mp_program* prog, const mp_node* n, size_t* nodes)
+{
+	const size_t var_len = prog->bodies[n->slot]->var_len;
+	size_t env = n->args[2];
+	for(size_t k = 1; k < var_len; ++k)
+	{
+		nodes[k] = k + 1 < var_len ? prog->nodes[env].args[0] : env;
+		env = prog->nodes[env].args[1];
+	}
+}
+
+/**
+ * Run a numeric builtin node on values in registers.
+ * @param Program.
+ * @param Numeric builtin node.
+ * @param Registers, one per node.
+ * @return Result.
+ */
+static double mp_program_apply_numeric(const mp_program* prog, const mp_node* n, const double* regs)
+{
+	const mp_program* body = prog->bodies[n->slot];
+	size_t* nodes = malloc(sizeof(size_t) * (body->var_len + 1));
+	double* vars = malloc(sizeof(double) * (body->var_len + 1));
+	mp_program_env_nodes(prog, n, nodes);
+	for(size_t k = 1; k < body->var_len; ++k)
+		vars[k] = regs[nodes[k]];
+
+	const double val = mp_numeric_eval(n->op, body, regs[n->args[0]], regs[n->args[1]], vars);
+	free(nodes);
+	free(vars);
+	return val;
+}
+
+/**
+ * Determine if a node of a program is a number with a given value.
+ * @param Program.
+ * @param Node index.
+ * @param Value. (0.0 and -0.0 are different values)
+ * @return 1 if the node is the number, 0 otherwise.
+ */
+static char mp_program_is_num(const mp_program* prog, size_t index, double val)
+{
+	const mp_node* n = &prog->nodes[index];
+	return n->op == MP_TOKEN_NUM && n->val == val && !signbit(n->val) == !signbit(val);
+}
+
+/**
+ * Simplify a node whose operands have already been simplified.
+ * @param Program the operands belong to.
+ * @param Node.
+ * @return Index of an existing node the node simplifies to, or MP_PROGRAM_ERR.
+ * The node itself may be rewritten in place.
+ */
+static size_t mp_program_simplify(mp_program* prog, mp_node* n)
+{
+	const size_t argc = mp_node_argc(n);
+	if(n->op == MP_TOKEN_VAR || n->op == MP_NODE_ENV || argc == 0) return MP_PROGRAM_ERR;
+
+	// Numeric builtins fold once their bounds and the values of their free variables are constant
+	if(MP_NODE_IS_NUMERIC(n->op))
+	{
+		const mp_program* body = prog->bodies[n->slot];
+		size_t* nodes = malloc(sizeof(size_t) * (body->var_len + 1));
+		double* vars = malloc(sizeof(double) * (body->var_len + 1));
+		mp_program_env_nodes(prog, n, nodes);
+
+		char constant = prog->nodes[n->args[0]].op == MP_TOKEN_NUM && prog->nodes[n->args[1]].op == MP_TOKEN_NUM;
+		for(size_t k = 1; k < body->var_len; ++k)
+		{
+			constant &= prog->nodes[nodes[k]].op == MP_TOKEN_NUM;
+			vars[k] = prog->nodes[nodes[k]].val;
+		}
+		if(constant)
+		{
+			const double val = mp_numeric_eval(n->op, body, prog->nodes[n->args[0]].val, prog->nodes[n->args[1]].val, vars);
+			memset(n, 0, sizeof(mp_node));
+			n->op = MP_TOKEN_NUM;
+			n->val = val;
+		}
+
+		free(nodes);
+		free(vars);
+		return MP_PROGRAM_ERR;
+	}
+
+	// Fold operations on constants
+	char constant = 1;
+	double args[MP_NODE_MAX_ARGS];
+	for(size_t i = 0; i < argc; ++i)
+	{
+		constant &= prog->nodes[n->args[i]].op == MP_TOKEN_NUM;
+		args[i] = prog->nodes[n->args[i]].val;
+	}
+	if(constant)
+	{
+		const double val = mp_node_apply(n, args);
+		memset(n, 0, sizeof(mp_node));
+		n->op = MP_TOKEN_NUM;
+		n->val = val;
+		return MP_PROGRAM_ERR;
+	}
+
+	const size_t a = n->args[0];
+	const size_t b = n->args[1];
+	switch(n->op)
+	{
+	// x + -0, -0 + x (Not x + 0, which turns -0 into 0)
+	case MP_TOKEN_ADD:
+		if(mp_program_is_num(prog, b, -0.0)) return a;
+		if(mp_program_is_num(prog, a, -0.0)) return b;
+		break;
+
+	// x - 0
+	case MP_TOKEN_SUB:
+		if(mp_program_is_num(prog, b, 0.0)) return a;
+		break;
+
+	// x * 1, 1 * x
+	case MP_TOKEN_MUL:
+		if(mp_program_is_num(prog, b, 1.0)) return a;
+		if(mp_program_is_num(prog, a, 1.0)) return b;
+		break;
+
+	// x / 1
+	case MP_TOKEN_DIV:
+		if(mp_program_is_num(prog, b, 1.0)) return a;
+		break;
+
+	// x ^ 1
+	case MP_TOKEN_EXP:
+		if(mp_program_is_num(prog, b, 1.0)) return a;
+		break;
+
+	// --x
+	case MP_TOKEN_NEG:
+		if(prog->nodes[a].op == MP_TOKEN_NEG) return prog->nodes[a].args[0];
+		break;
+
+	// a * b + -0, 1 * b + c, a * 1 + c
+	case MP_NODE_FMA:
+		if(mp_program_is_num(prog, n->args[2], -0.0))
+			n->op = MP_TOKEN_MUL;
+		else if(mp_program_is_num(prog, a, 1.0) || mp_program_is_num(prog, b, 1.0))
+		{
+			n->op = MP_TOKEN_ADD;
+			n->args[0] = mp_program_is_num(prog, a, 1.0) ? b : a;
+			n->args[1] = n->args[2];
+		}
+		else break;
+		n->args[2] = 0;
+		return mp_program_simplify(prog, n);
+
+	// Constant conditions
+	case MP_TOKEN_COL:
+		if(prog->nodes[a].op == MP_TOKEN_NUM)
+			return prog->nodes[a].val != 0.0 ? b : n->args[2];
+		break;
+	}
+
+	return MP_PROGRAM_ERR;
+}
+
+mp_program* mp_program_optimize(const mp_program* prog)
+{
+	mp_program* opt = mp_program_create();
+
+	// Keep the variable slots
+	for(size_t i = 0; i < prog->var_len; ++i)
+		mp_program_var_slot(opt, prog->syms[i]);
+
+	// Mark nodes reachable from an output
+	char* live = calloc(prog->len + 1, 1);
+	for(size_t i = 0; i < prog->out_len; ++i)
+		live[prog->outputs[i]] = 1;
+	for(size_t i = prog->len; i-- > 0;)
+		if(live[i])
+			for(size_t j = 0; j < mp_node_argc(&prog->nodes[i]); ++j)
+				live[prog->nodes[i].args[j]] = 1;
+
+	// Rebuild every live node in the optimized program
+	size_t* map = malloc(sizeof(size_t) * (prog->len + 1));
+	for(size_t i = 0; i < prog->len; ++i)
+	{
+		if(!live[i]) continue;
+
+		mp_node n = prog->nodes[i];
+		for(size_t j = 0; j < mp_node_argc(&n); ++j)
+			n.args[j] = map[n.args[j]];
+
+		// Bodies are optimized along with the program
+		if(MP_NODE_IS_NUMERIC(n.op))
+			n.slot = mp_program_add_body(opt, mp_program_optimize(prog->bodies[n.slot]));
+
+		const size_t same = mp_program_simplify(opt, &n);
+		map[i] = same != MP_PROGRAM_ERR ? same : mp_program_intern(opt, n);
+	}
+
+	// Map the outputs
+	opt->outputs = malloc(sizeof(size_t) * (prog->out_len + 1));
+	opt->out_len = prog->out_len;
+	for(size_t i = 0; i < prog->out_len; ++i)
+		opt->outputs[i] = map[prog->outputs[i]];
+
+	// Nodes shared while rebuilding aren't deduplicated formulas
+	opt->dedup_count = prog->dedup_count;
+
+	free(live);
+	free(map);
+
+	// Simplifying can leave operands which were live in the original program unused
+	size_t live_len = 0;
+	live = calloc(opt->len + 1, 1);
+	for(size_t i = 0; i < opt->out_len; ++i)
+		live[opt->outputs[i]] = 1;
+	for(size_t i = opt->len; i-- > 0;)
+		if(live[i])
+		{
+			++live_len;
+			for(size_t j = 0; j < mp_node_argc(&opt->nodes[i]); ++j)
+				live[opt->nodes[i].args[j]] = 1;
+		}
+	free(live);
+
+	if(live_len < opt->len)
+	{
+		mp_program* again = mp_program_optimize(opt);
+		mp_program_destroy(opt);
+		return again;
+	}
+	return opt;
+}
+
+// Polynomial in one variable, with coefficients which don't depend on it
+typedef struct
+{
+	/** Node of every coefficient, indexed by degree. (MP_PROGRAM_ERR is zero) */
+	size_t coefs[MP_POLY_MAX_DEGREE + 1];
+
+	/** Degree. */
+	size_t degree;
+
+} mp_poly;
+
+// State of a polynomial rewrite
+typedef struct
+{
+	/** Program being rewritten. */
+	const mp_program* src;
+
+	/** Rewritten program. */
+	mp_program* dst;
+
+	/** Rewritten node of every source node, or MP_PROGRAM_ERR if not rewritten yet. */
+	size_t* map;
+
+	/** Bitmap of the variables every source node depends on. (dep_words words per node) */
+	uint64_t* deps;
+
+	/** Number of bitmap words per node. */
+	size_t dep_words;
+
+	/** Slot of the variable being analyzed. */
+	size_t var;
+
+	/** MP_POLY_HORNER or MP_POLY_ESTRIN. */
+	int form;
+
+} mp_poly_rewrite;
+
+/**
+ * Add a node to the rewritten program.
+ * @param Rewrite state.
+ * @param Operation.
+ * @param First operand.
+ * @param Second operand.
+ * @param Third operand.
+ * @return Node index.
+ */
+static size_t mp_poly_node(mp_poly_rewrite* rw, int op, size_t a, size_t b, size_t c)
+{
+	mp_node n;
+	memset(&n, 0, sizeof(n));
+	n.op = op;
+	n.args[0] = a;
+	n.args[1] = b;
+	n.args[2] = c;
+	return mp_program_intern(rw->dst, n);
+}
+
+/**
+ * Add a number node to the rewritten program.
+ * @param Rewrite state.
+ * @param Value.
+ * @return Node index.
+ */
+static size_t mp_poly_num(mp_poly_rewrite* rw, double val)
+{
+	mp_node n;
+	memset(&n, 0, sizeof(n));
+	n.op = MP_TOKEN_NUM;
+	n.val = val;
+	return mp_program_intern(rw->dst, n);
+}
+
+/**
+ * Add two coefficients, either of which may be zero.
+ * @param Rewrite state.
+ * @param First coefficient.
+ * @param Second coefficient.
+ * @param MP_TOKEN_ADD or MP_TOKEN_SUB.
+ * @return Sum or difference.
+ */
+static size_t mp_poly_coef_add(mp_poly_rewrite* rw, size_t a, size_t b, int op)
+{
+	if(b == MP_PROGRAM_ERR) return a;
+	if(a == MP_PROGRAM_ERR) return op == MP_TOKEN_ADD ? b : mp_poly_node(rw, MP_TOKEN_NEG, b, 0, 0);
+	return mp_poly_node(rw, op, a, b, 0);
+}
+
+/**
+ * Multiply two coefficients, either of which may be zero.
+ * @param Rewrite state.
+ * @param First coefficient.
+ * @param Second coefficient.
+ * @return Product.
+ */
+static size_t mp_poly_coef_mul(mp_poly_rewrite* rw, size_t a, size_t b)
+{
+	if(a == MP_PROGRAM_ERR || b == MP_PROGRAM_ERR) return MP_PROGRAM_ERR;
+	return mp_poly_node(rw, MP_TOKEN_MUL, a, b, 0);
+}
+
+/**
+ * Count the terms of a polynomial.
+ * @param Polynomial.
+ * @return Number of non-zero coefficients.
+ */
+static size_t mp_poly_terms(const mp_poly* p)
+{
+	size_t terms = 0;
+	for(size_t i = 0; i <= p->degree; ++i)
+		terms += p->coefs[i] != MP_PROGRAM_ERR;
+	return terms;
+}
+
+static size_t mp_poly_rewrite_node(mp_poly_rewrite* rw, size_t index);
+
+/**
+ * Determine if a source node depends on a variable.
+ * @param Rewrite state.
+ * @param Source node index.
+ * @param Variable slot.
+ * @return 1 if it does, 0 otherwise.
+ */
+static char mp_poly_depends(const mp_poly_rewrite* rw, size_t index, size_t var)
+{
+	return (rw->deps[index * rw->dep_words + var / 64] >> (var % 64)) & 1;
+}
+
+/**
+ * Analyze a source node as a polynomial in the variable rw->var.
+ * Only powers of the bare variable are expanded, and only products where
+ * one side is a single term, so rewriting never multiplies sums out.
+ * @param Rewrite state.
+ * @param Source node index.
+ * @param Polynomial to write to.
+ * @return 1 if the node is a polynomial, 0 otherwise.
+ */
+static char mp_poly_analyze(mp_poly_rewrite* rw, size_t index, mp_poly* p)
+{
+	const mp_node* n = &rw->src->nodes[index];
+	for(size_t i = 0; i <= MP_POLY_MAX_DEGREE; ++i)
+		p->coefs[i] = MP_PROGRAM_ERR;
+	p->degree = 0;
+
+	// Anything not depending on the variable is a coefficient
+	if(!mp_poly_depends(rw, index, rw->var))
+	{
+		p->coefs[0] = mp_poly_rewrite_node(rw, index);
+		return 1;
+	}
+
+	mp_poly a;
+	mp_poly b;
+	switch(n->op)
+	{
+	case MP_TOKEN_VAR:
+		p->coefs[1] = mp_poly_num(rw, 1.0);
+		p->degree = 1;
+		return 1;
+
+	case MP_TOKEN_NEG:
+		if(!mp_poly_analyze(rw, n->args[0], &a)) return 0;
+		for(size_t i = 0; i <= a.degree; ++i)
+			p->coefs[i] = mp_poly_coef_add(rw, MP_PROGRAM_ERR, a.coefs[i], MP_TOKEN_SUB);
+		p->degree = a.degree;
+		return 1;
+
+	case MP_TOKEN_ADD:
+	case MP_TOKEN_SUB:
+		if(!mp_poly_analyze(rw, n->args[0], &a) || !mp_poly_analyze(rw, n->args[1], &b)) return 0;
+		p->degree = a.degree > b.degree ? a.degree : b.degree;
+		for(size_t i = 0; i <= p->degree; ++i)
+			p->coefs[i] = mp_poly_coef_add(
+				rw,
+				i <= a.degree ? a.coefs[i] : MP_PROGRAM_ERR,
+				i <= b.degree ? b.coefs[i] : MP_PROGRAM_ERR,
+				n->op
+			);
+		return 1;
+
+	case MP_TOKEN_MUL:
+		if(!mp_poly_analyze(rw, n->args[0], &a) || !mp_poly_analyze(rw, n->args[1], &b)) return 0;
+		if(a.degree + b.degree > MP_POLY_MAX_DEGREE) return 0;
+		if(mp_poly_terms(&a) > 1 && mp_poly_terms(&b) > 1) return 0;
+		p->degree = a.degree + b.degree;
+		for(size_t i = 0; i <= a.degree; ++i)
+			for(size_t j = 0; j <= b.degree; ++j)
+				p->coefs[i + j] = mp_poly_coef_add(
+					rw,
+					p->coefs[i + j],
+					mp_poly_coef_mul(rw, a.coefs[i], b.coefs[j]),
+					MP_TOKEN_ADD
+				);
+		return 1;
+
+	// Division by a coefficient divides every coefficient
+	case MP_TOKEN_DIV:
+		if(mp_poly_depends(rw, n->args[1], rw->var) || !mp_poly_analyze(rw, n->args[0], &a)) return 0;
+		{
+			const size_t d = mp_poly_rewrite_node(rw, n->args[1]);
+			for(size_t i = 0; i <= a.degree; ++i)
+				if(a.coefs[i] != MP_PROGRAM_ERR)
+					p->coefs[i] = mp_poly_node(rw, MP_TOKEN_DIV, a.coefs[i], d, 0);
+			p->degree = a.degree;
+		}
+		return 1;
+
+	// Small integer powers of the variable itself
+	case MP_TOKEN_EXP:
+		{
+			const mp_node* base = &rw->src->nodes[n->args[0]];
+			const mp_node* e = &rw->src->nodes[n->args[1]];
+			if(base->op != MP_TOKEN_VAR || e->op != MP_TOKEN_NUM) return 0;
+			if(e->val < 1.0 || e->val > MP_POLY_MAX_DEGREE || e->val != floor(e->val)) return 0;
+
+			p->degree = (size_t)e->val;
+			p->coefs[p->degree] = mp_poly_num(rw, 1.0);
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Emit a polynomial in Horner form.
+ * @param Rewrite state.
+ * @param Polynomial.
+ * @param Variable node.
+ * @return Node index of the result.
+ */
+static size_t mp_poly_emit_horner(mp_poly_rewrite* rw, const mp_poly* p, size_t x)
+{
+	size_t acc = p->coefs[p->degree];
+	for(size_t i = p->degree; i-- > 0;)
+	{
+		if(p->coefs[i] == MP_PROGRAM_ERR)
+			acc = mp_poly_node(rw, MP_TOKEN_MUL, acc, x, 0);
+		else
+			acc = mp_poly_node(rw, MP_NODE_FMA, acc, x, p->coefs[i]);
+	}
+	return acc;
+}
+
+/**
+ * Emit a polynomial in Estrin form. Pairs of terms are combined with x,
+ * pairs of pairs with x^2, and so on, so the longest chain of dependent
+ * operations grows with the logarithm of the degree.
+ * @param Rewrite state.
+ * @param Polynomial.
+ * @param Variable node.
+ * @return Node index of the result.
+ */
+static size_t mp_poly_emit_estrin(mp_poly_rewrite* rw, const mp_poly* p, size_t x)
+{
+	size_t terms[MP_POLY_MAX_DEGREE + 1];
+	size_t len = p->degree + 1;
+	for(size_t i = 0; i < len; ++i)
+		terms[i] = p->coefs[i];
+
+	size_t power = x;
+	while(len > 1)
+	{
+		// terms[i] = terms[2i] + terms[2i + 1] * power
+		for(size_t i = 0; i < len; i += 2)
+		{
+			const size_t lo = terms[i];
+			const size_t hi = i + 1 < len ? terms[i + 1] : MP_PROGRAM_ERR;
+			if(hi == MP_PROGRAM_ERR) terms[i / 2] = lo;
+			else if(lo == MP_PROGRAM_ERR) terms[i / 2] = mp_poly_node(rw, MP_TOKEN_MUL, hi, power, 0);
+			else terms[i / 2] = mp_poly_node(rw, MP_NODE_FMA, hi, power, lo);
+		}
+
+		len = (len + 1) / 2;
+		if(len > 1) power = mp_poly_node(rw, MP_TOKEN_MUL, power, power, 0);
+	}
+	return terms[0];
+}
+
+/**
+ * Rewrite a source node, rewriting the polynomials it contains.
+ * @param Rewrite state.
+ * @param Source node index.
+ * @return Index of the rewritten node.
+ */
+static size_t mp_poly_rewrite_node(mp_poly_rewrite* rw, size_t index)
+{
+	if(rw->map[index] != MP_PROGRAM_ERR) return rw->map[index];
+	const mp_program* src = rw->src;
+	const mp_node* n = &src->nodes[index];
+
+	// Only sums are worth rewriting, a polynomial is the largest sum containing it
+	if(n->op == MP_TOKEN_ADD || n->op == MP_TOKEN_SUB)
+	{
+		// Try every variable, keeping the one giving the highest degree
+		mp_poly best;
+		size_t best_slot = MP_PROGRAM_ERR;
+		best.degree = 0;
+
+		// Analyzing coefficients can rewrite nested sums, which analyze their own variables
+		const size_t outer = rw->var;
+		for(size_t v = 0; v < src->var_len; ++v)
+		{
+			if(!mp_poly_depends(rw, index, v)) continue;
+
+			mp_poly p;
+			rw->var = v;
+			if(mp_poly_analyze(rw, index, &p) && p.degree >= 2 && p.degree > best.degree)
+			{
+				best = p;
+				best_slot = v;
+			}
+		}
+		rw->var = outer;
+
+		if(best_slot != MP_PROGRAM_ERR && mp_poly_terms(&best) >= 2)
+		{
+			mp_node x;
+			memset(&x, 0, sizeof(x));
+			x.op = MP_TOKEN_VAR;
+			x.slot = best_slot;
+			const size_t x_index = mp_program_intern(rw->dst, x);
+
+			rw->map[index] = rw->form == MP_POLY_ESTRIN ?
+				mp_poly_emit_estrin(rw, &best, x_index) :
+				mp_poly_emit_horner(rw, &best, x_index);
+			return rw->map[index];
+		}
+	}
+
+	// Otherwise copy the node, rewriting its operands
+	mp_node copy = *n;
+	for(size_t j = 0; j < mp_node_argc(n); ++j)
+		copy.args[j] = mp_poly_rewrite_node(rw, n->args[j]);
+	if(MP_NODE_IS_NUMERIC(n->op))
+		copy.slot = mp_program_add_body(rw->dst, mp_program_rewrite_polynomials(src->bodies[n->slot], rw->form));
+
+	rw->map[index] = mp_program_intern(rw->dst, copy);
+	return rw->map[index];
+}
+
+mp_program* mp_program_rewrite_polynomials(const mp_program* prog, int form)
+{
+	mp_poly_rewrite rw;
+	rw.src = prog;
+	rw.dst = mp_program_create();
+	rw.map = malloc(sizeof(size_t) * (prog->len + 1));
+	rw.form = form;
+	rw.var = 0;
+	for(size_t i = 0; i < prog->len; ++i)
+		rw.map[i] = MP_PROGRAM_ERR;
+
+	// Find the variables every node depends on once, nodes come after their operands
+	rw.dep_words = (prog->var_len + 63) / 64;
+	rw.deps = calloc(prog->len * rw.dep_words + 1, sizeof(uint64_t));
+	for(size_t i = 0; i < prog->len; ++i)
+	{
+		const mp_node* n = &prog->nodes[i];
+		uint64_t* row = &rw.deps[i * rw.dep_words];
+		if(n->op == MP_TOKEN_VAR) row[n->slot / 64] |= (uint64_t)1 << (n->slot % 64);
+		for(size_t j = 0; j < mp_node_argc(n); ++j)
+			for(size_t w = 0; w < rw.dep_words; ++w)
+				row[w] |= rw.deps[n->args[j] * rw.dep_words + w];
+	}
+
+	// Keep the variable slots
+	for(size_t i = 0; i < prog->var_len; ++i)
+		mp_program_var_slot(rw.dst, prog->syms[i]);
+
+	rw.dst->outputs = malloc(sizeof(size_t) * (prog->out_len + 1));
+	rw.dst->out_len = prog->out_len;
+	for(size_t i = 0; i < prog->out_len; ++i)
+		rw.dst->outputs[i] = mp_poly_rewrite_node(&rw, prog->outputs[i]);
+
+	// Drop coefficients built while trying variables which weren't used,
+	// and clean up multiplications by one left in the coefficients
+	mp_program* result = mp_program_optimize(rw.dst);
+	result->dedup_count = prog->dedup_count;
+
+	mp_program_destroy(rw.dst);
+	free(rw.deps);
+	free(rw.map);
+	return result;
+}
+
+size_t mp_program_find_var(const mp_program* prog, const char* name)
+{
+	const size_t sym = mp_find_symbol(name);
+	for(size_t i = 0; i < prog->var_len && sym != MP_SYMBOL_ERR; ++i)
+		if(prog->syms[i] == sym)
+			return i;
+
+	return MP_PROGRAM_ERR;
+}
+
+size_t mp_program_add(mp_program* prog, const char* str)
+{
+	// Lex the expression into the parser
+	if(!mp_lex_string(str)) return MP_PROGRAM_ERR;
+
+	// Get the expression in polish notation
+	size_t len;
+	const token* tokens = mp_get_polish_tokens(&len);
+
+	// Compile the tokens
+	const size_t out = mp_program_add_tokens(prog, tokens, len, mp_get_parser_literals());
+
+	mp_flush_parser_tokens();
+	return out;
+}
+
+// Numeric builtin call found in tokens being compiled
+typedef struct
+{
+	/** Node operation. (MP_NODE_SOLVE, MP_NODE_INTEGRATE or MP_NODE_SUM) */
+	int op;
+
+	/** First token of the expression. */
+	size_t begin;
+
+	/** Token of the bound variable, just after the expression. */
+	size_t var;
+
+	/** Function token. */
+	size_t fun;
+
+	/** Body index, once the expression is compiled. */
+	size_t body;
+
+	/** First link of the values of the free variables (See MP_NODE_ENV), or MP_PROGRAM_ERR if there are none. */
+	size_t env;
+
+} mp_numeric_site;
+
+/**
+ * Find the first token of the operand ending just before a token.
+ * @param Tokens in polish notation.
+ * @param Index of the token after the operand.
+ * @return Index of the first token, or MP_PROGRAM_ERR if the tokens don't end with an operand.
+ */
+static size_t mp_operand_begin(const token* tokens, size_t end)
+{
+	// Every token pushes one value after popping its operands
+	size_t need = 1;
+	for(size_t i = end; i-- > 0;)
+	{
+		size_t pops;
+		switch(tokens[i].id)
+		{
+		case MP_TOKEN_NUM:
+		case MP_TOKEN_VAR:
+			pops = 0;
+			break;
+
+		case MP_TOKEN_NEG:
+			pops = 1;
+			break;
+
+		case MP_TOKEN_ADD:
+		case MP_TOKEN_SUB:
+		case MP_TOKEN_MUL:
+		case MP_TOKEN_DIV:
+		case MP_TOKEN_EXP:
+		case MP_TOKEN_LT:
+		case MP_TOKEN_LE:
+		case MP_TOKEN_GT:
+		case MP_TOKEN_GE:
+		case MP_TOKEN_EQ:
+		case MP_TOKEN_NE:
+		case MP_TOKEN_AND:
+		case MP_TOKEN_OR:
+			pops = 2;
+			break;
+
+		// Ternary conditions are resolved by the alternative
+		case MP_TOKEN_QST:
+			continue;
+
+		case MP_TOKEN_COL:
+			pops = 3;
+			break;
+
+		case MP_TOKEN_FUN:
+			pops = (size_t)tokens[i].argc;
+			break;
+
+		default:
+			return MP_PROGRAM_ERR;
+		}
+
+		need = need - 1 + pops;
+		if(need == 0) return i;
+	}
+
+	return MP_PROGRAM_ERR;
+}
+
+/**
+ * Find the numeric builtin calls of an expression, except those inside the
+ * expression of another call. (They are found when that body is compiled)
+ * @param Tokens in polish notation.
+ * @param Number of tokens.
+ * @param Pointer to write the calls to. (Allocated with malloc, must be freed)
+ * @param Pointer to write the call of the first, variable and function token
+ * of every call to. (MP_PROGRAM_ERR for other tokens, allocated with malloc, must be freed)
+ * @return Number of calls, or MP_PROGRAM_ERR if a call is malformed.
+ */
+static size_t mp_find_numeric_sites(const token* tokens, size_t len, mp_numeric_site** sites, size_t** at)
+{
+	*sites = NULL;
+	*at = NULL;
+	size_t count = 0;
+
+	// Outer calls end later, so they are found first
+	for(size_t i = len; i-- > 0;)
+	{
+		// Skip the expression of a call once its arguments have been searched
+		if(*at != NULL && (*at)[i] != MP_PROGRAM_ERR && (*sites)[(*at)[i]].var == i)
+		{
+			i = (*sites)[(*at)[i]].begin;
+			continue;
+		}
+
+		if(tokens[i].id != MP_TOKEN_FUN || tokens[i].argc != MP_NUMERIC_ARGC) continue;
+		const int op = mp_find_numeric_symbol(tokens[i].index);
+		if(op == MP_NUMERIC_ERR) continue;
+
+		// Arguments in reverse: upper bound, lower bound, variable and expression
+		const size_t hi = mp_operand_begin(tokens, i);
+		const size_t lo = hi != MP_PROGRAM_ERR ? mp_operand_begin(tokens, hi) : MP_PROGRAM_ERR;
+		if(lo == MP_PROGRAM_ERR || lo == 0 || tokens[lo - 1].id != MP_TOKEN_VAR) return MP_PROGRAM_ERR;
+		const size_t begin = mp_operand_begin(tokens, lo - 1);
+		if(begin == MP_PROGRAM_ERR) return MP_PROGRAM_ERR;
+
+		if(*at == NULL)
+		{
+			*at = malloc(sizeof(size_t) * (len + 1));
+			for(size_t j = 0; j < len; ++j) (*at)[j] = MP_PROGRAM_ERR;
+		}
+		*sites = realloc(*sites, sizeof(mp_numeric_site) * (count + 1));
+
+		mp_numeric_site* site = &(*sites)[count];
+		site->op = op;
+		site->begin = begin;
+		site->var = lo - 1;
+		site->fun = i;
+		site->body = MP_PROGRAM_ERR;
+		site->env = MP_PROGRAM_ERR;
+		(*at)[begin] = (*at)[lo - 1] = (*at)[i] = count++;
+	}
+
+	return count;
+}
+
+/**
+ * Get the node reading a variable.
+ * @param Program.
+ * @param Symbol id of the variable.
+ * @return The node an earlier assignment bound the variable to, or a variable node.
+ */
+static size_t mp_program_read_var(mp_program* prog, size_t sym)
+{
+	if(sym < prog->bind_len && prog->binds[sym] != 0) return prog->binds[sym] - 1;
+
+	mp_node n;
+	memset(&n, 0, sizeof(n));
+	n.op = MP_TOKEN_VAR;
+	n.slot = mp_program_var_slot(prog, sym);
+	return mp_program_intern(prog, n);
+}
+
+static size_t mp_program_compile(mp_program* prog, const token* tokens, size_t len, const double* literals);
+
+/**
+ * Drop everything added to a program since an earlier state, so a failed
+ * compile leaves no unreachable nodes behind for evaluation to run.
+ * @param Program.
+ * @param Number of nodes to keep.
+ * @param Number of variables to keep.
+ * @param Number of bodies to keep.
+ */
+static void mp_program_truncate(mp_program* prog, size_t len, size_t var_len, size_t body_len)
+{
+	for(size_t i = body_len; i < prog->body_len; ++i)
+		mp_program_destroy(prog->bodies[i]);
+	prog->body_len = body_len;
+	prog->var_len = var_len;
+	if(prog->len == len) return;
+
+	// Rebuild the hash table over the remaining nodes
+	prog->len = len;
+	memset(prog->table, 0, sizeof(size_t) * prog->table_len);
+	for(size_t i = 0; i < prog->len; ++i)
+		mp_table_insert(prog, i);
+}
+
+/**
+ * Compile the expression of a numeric builtin call into a body, and the
+ * values of the body's free variables into the program.
+ * @param Program.
+ * @param Tokens in polish notation.
+ * @param Literal pool the number tokens index.
+ * @param Call. (Its body and env are set)
+ * @return 1 on success, 0 if the expression is invalid.
+ */
+static char mp_program_compile_body(mp_program* prog, const token* tokens, const double* literals, mp_numeric_site* site)
+{
+	// The bound variable is slot 0 of the body
+	mp_program* body = mp_program_create();
+	mp_program_var_slot(body, tokens[site->var].index);
+	const size_t root = mp_program_compile(body, tokens + site->begin, site->var - site->begin, literals);
+	if(root == MP_PROGRAM_ERR)
+	{
+		mp_program_destroy(body);
+		return 0;
+	}
+	mp_program_add_node(body, root);
+
+	mp_program* opt = mp_program_optimize(body);
+	mp_program_destroy(body);
+
+	// Every other variable is read from the program, last one first
+	for(size_t k = opt->var_len; k-- > 1;)
+	{
+		const size_t val = mp_program_read_var(prog, opt->syms[k]);
+		if(site->env == MP_PROGRAM_ERR)
+		{
+			site->env = val;
+			continue;
+		}
+
+		mp_node n;
+		memset(&n, 0, sizeof(n));
+		n.op = MP_NODE_ENV;
+		n.args[0] = val;
+		n.args[1] = site->env;
+		site->env = mp_program_intern(prog, n);
+	}
+
+	site->body = mp_program_add_body(prog, opt);
+	return 1;
+}
+
+/**
+ * Compile an expression in polish notation into nodes of a program.
+ * @param Program.
+ * @param Tokens in polish notation.
+ * @param Number of tokens.
+ * @param Literal pool the number tokens index.
+ * @return Root node of the expression, or MP_PROGRAM_ERR on failure.
+ */
+static size_t mp_program_compile(mp_program* prog, const token* tokens, size_t len, const double* literals)
+{
+	// Stack of node indices
+	size_t* stack = malloc(sizeof(size_t) * (len + 1));
+	size_t stack_len = 0;
+
+	// State to roll back to on failure
+	const size_t begin = prog->len;
+	const size_t var_len = prog->var_len;
+	const size_t body_len = prog->body_len;
+	const size_t dedup_count = prog->dedup_count;
+
+	// Numeric builtin calls compile their expression into a body of its own
+	mp_numeric_site* sites;
+	size_t* site_at;
+	if(mp_find_numeric_sites(tokens, len, &sites, &site_at) == MP_PROGRAM_ERR) goto compile_failure;
+
+	// Loop over every token
+	for(size_t i = 0; i < len; ++i)
+	{
+		// Node to add
+		mp_node n;
+		memset(&n, 0, sizeof(n));
+		n.op = tokens[i].id;
+
+		// Skip from the expression of a numeric builtin call to its bounds
+		mp_numeric_site* site = site_at != NULL && site_at[i] != MP_PROGRAM_ERR ? &sites[site_at[i]] : NULL;
+		if(site != NULL && site->begin == i)
+		{
+			if(!mp_program_compile_body(prog, tokens, literals, site)) goto compile_failure;
+			i = site->var;
+			continue;
+		}
+
+		// The call itself takes the bounds
+		if(site != NULL && site->fun == i)
+		{
+			if(stack_len < 2) goto compile_failure;
+			n.op = site->op;
+			n.args[1] = stack[--stack_len];
+			n.args[0] = stack[--stack_len];
+			n.args[2] = site->env != MP_PROGRAM_ERR ? site->env : n.args[0];
+			n.slot = site->body;
+			stack[stack_len++] = mp_program_intern(prog, n);
+			continue;
+		}
+
+		switch(tokens[i].id)
+		{
+		// Numbers are stored as constants
+		case MP_TOKEN_NUM:
+			n.val = literals[tokens[i].index];
+			break;
+
+		// Variables are stored as slots, unless an earlier assignment bound them
+		case MP_TOKEN_VAR:
+			stack[stack_len++] = mp_program_read_var(prog, tokens[i].index);
+			continue;
+
+		// Negation takes one operand
+		case MP_TOKEN_NEG:
+			if(stack_len < 1) goto compile_failure;
+			n.args[0] = stack[--stack_len];
+			break;
+
+		// Binary operators take two operands
+		case MP_TOKEN_ADD:
+		case MP_TOKEN_SUB:
+		case MP_TOKEN_MUL:
+		case MP_TOKEN_DIV:
+		case MP_TOKEN_EXP:
+		case MP_TOKEN_LT:
+		case MP_TOKEN_LE:
+		case MP_TOKEN_GT:
+		case MP_TOKEN_GE:
+		case MP_TOKEN_EQ:
+		case MP_TOKEN_NE:
+		case MP_TOKEN_AND:
+		case MP_TOKEN_OR:
+			if(stack_len < 2) goto compile_failure;
+			n.args[1] = stack[--stack_len];
+			n.args[0] = stack[--stack_len];
+			break;
+
+		// Ternary conditions are resolved by the alternative
+		case MP_TOKEN_QST:
+			continue;
+
+		// Ternary alternatives select between two values
+		case MP_TOKEN_COL:
+			if(stack_len < 3) goto compile_failure;
+			n.args[2] = stack[--stack_len];
+			n.args[1] = stack[--stack_len];
+			n.args[0] = stack[--stack_len];
+			break;
+
+		// Function calls
+		case MP_TOKEN_FUN:
+			{
+				const size_t argc = (size_t)tokens[i].argc;
+				n.slot = mp_find_func_symbol(tokens[i].index, argc);
+				if(n.slot == MP_FUNC_ERR || argc > MP_NODE_MAX_ARGS || stack_len < argc)
+					goto compile_failure;
+
+				// Reductions would silently return every row's own value
+				if(mp_funcs[n.slot].rfunc != NULL && !prog->reductions) goto compile_failure;
+
+				// Pop the arguments in order
+				stack_len -= argc;
+				for(size_t j = 0; j < argc; ++j)
+					n.args[j] = stack[stack_len + j];
+
+				// if(c, a, b) is a select, just like the ternary operator
+				if(n.slot == MP_FUNC_IF)
+				{
+					n.op = MP_TOKEN_COL;
+					n.slot = 0;
+				}
+			}
+			break;
+
+		// Anything else can't appear in an expression
+		default:
+			goto compile_failure;
+		}
+
+		// Push the node, counting operations shared with earlier expressions
+		const size_t index = mp_program_intern(prog, n);
+		if(index < begin && n.op != MP_TOKEN_NUM) ++prog->dedup_count;
+		stack[stack_len++] = index;
+	}
+
+	// A well formed expression leaves exactly one value
+	if(stack_len != 1) goto compile_failure;
+
+	const size_t root = stack[0];
+	free(stack);
+	free(sites);
+	free(site_at);
+	return root;
+
+	// Failure jump point
+	compile_failure:
+
+	// Nodes already added would be unreachable from any output
+	mp_program_truncate(prog, begin, var_len, body_len);
+	prog->dedup_count = dedup_count;
+	free(stack);
+	free(sites);
+	free(site_at);
+	return MP_PROGRAM_ERR;
+}
+
+size_t mp_program_add_tokens(mp_program* prog, const token* tokens, size_t len, const double* literals)
+{
+	const size_t root = mp_program_compile(prog, tokens, len, literals);
+	if(root == MP_PROGRAM_ERR) return MP_PROGRAM_ERR;
+
+	return mp_program_add_node(prog, root);
+}
+
+size_t mp_program_assign_tokens(
+	mp_program* prog, 
+	size_t sym, 
+	const token* tokens, 
+	size_t len, 
+	const double* literals
+)
+{
+	// Scratch symbols (See mp_scratch_symbol) would make the bind table huge
+	if(sym >= MP_SYMBOL_MAX) return MP_PROGRAM_ERR;
+
+	const size_t root = mp_program_compile(prog, tokens, len, literals);
+	if(root == MP_PROGRAM_ERR) return MP_PROGRAM_ERR;
+
+	// Grow the bind table to cover the symbol
+	if(sym >= prog->bind_len)
+	{
+		size_t bind_len = prog->bind_len == 0 ? MP_NODE_CHUNK_SIZE : prog->bind_len;
+		while(bind_len <= sym) bind_len *= 2;
+
+		prog->binds = realloc(prog->binds, sizeof(size_t) * bind_len);
+		memset(prog->binds + prog->bind_len, 0, sizeof(size_t) * (bind_len - prog->bind_len));
+		prog->bind_len = bind_len;
+	}
+
+	prog->binds[sym] = root + 1;
+	return root;
+}
+
+size_t mp_program_bound_node(const mp_program* prog, size_t sym)
+{
+	if(sym >= prog->bind_len || prog->binds[sym] == 0) return MP_PROGRAM_ERR;
+	return prog->binds[sym] - 1;
+}
+
+size_t mp_program_add_node(mp_program* prog, size_t node)
+{
+	prog->outputs = realloc(prog->outputs, sizeof(size_t) * (prog->out_len + 1));
+	prog->outputs[prog->out_len] = node;
+	return prog->out_len++;
+}
+
+// Double precision kernel
+#define MP_KERNEL_BLOCK mp_program_eval_block_f64
+#define MP_KERNEL_BATCH mp_program_eval_batch_f64
+#define MP_KERNEL_STORAGE double
+#define MP_KERNEL_REAL double
+#define MP_KERNEL_POW pow
+#define MP_KERNEL_FMA MP_FMA
+#define MP_KERNEL_FUNC func
+#include "program_kernel.h"
+
+// Single precision kernel
+#define MP_KERNEL_BLOCK mp_program_eval_block_f32
+#define MP_KERNEL_BATCH mp_program_eval_batch_f32_single
+#define MP_KERNEL_STORAGE float
+#define MP_KERNEL_REAL float
+#define MP_KERNEL_POW powf
+#define MP_KERNEL_FMA MP_FMAF
+#define MP_KERNEL_FUNC ffunc
+#include "program_kernel.h"
+
+// Single precision storage, double precision accumulation kernel
+#define MP_KERNEL_BLOCK mp_program_eval_block_mixed
+#define MP_KERNEL_BATCH mp_program_eval_batch_f32_mixed
+#define MP_KERNEL_STORAGE float
+#define MP_KERNEL_REAL double
+#define MP_KERNEL_POW pow
+#define MP_KERNEL_FMA MP_FMA
+#define MP_KERNEL_FUNC func
+#include "program_kernel.h"
+
+void mp_program_eval_regs(const mp_program* prog, const double* vars, double* regs)
+{
+	double args[MP_NODE_MAX_ARGS];
+	for(size_t i = 0; i < prog->len; ++i)
+	{
+		const mp_node* n = &prog->nodes[i];
+		if(n->op == MP_TOKEN_NUM) regs[i] = n->val;
+		else if(n->op == MP_TOKEN_VAR) regs[i] = vars[n->slot];
+		else if(MP_NODE_IS_NUMERIC(n->op)) regs[i] = mp_program_apply_numeric(prog, n, regs);
+		else
+		{
+			for(size_t j = 0; j < mp_node_argc(n); ++j)
+				args[j] = regs[n->args[j]];
+			regs[i] = mp_node_apply(n, args);
+		}
+	}
+}
+
+void mp_program_eval(const mp_program* prog, const double* vars, double* out)
+{
+	// A single row only needs one register per node, not a block
+	double* regs = malloc(sizeof(double) * (prog->len + 1));
+	mp_program_eval_regs(prog, vars, regs);
+
+	for(size_t i = 0; i < prog->out_len; ++i)
+		out[i] = regs[prog->outputs[i]];
+
+	free(regs);
+}
+
+void mp_program_eval_batch(
+	const mp_program* prog,
+	const double* const* vars,
+	size_t rows,
+	double* const* out
+)
+{
+	mp_program_eval_batch_f64(prog, vars, rows, out);
+}
+
+void mp_program_eval_f32(
+	const mp_program* prog,
+	const float* vars,
+	float* out,
+	int precision
+)
+{
+	// Every variable is a column with a single row
+	const float** cols = malloc(sizeof(float*) * (prog->var_len + 1));
+	for(size_t i = 0; i < prog->var_len; ++i)
+		cols[i] = &vars[i];
+
+	// Every output is a column with a single row
+	float** outs = malloc(sizeof(float*) * (prog->out_len + 1));
+	for(size_t i = 0; i < prog->out_len; ++i)
+		outs[i] = &out[i];
+
+	mp_program_eval_batch_f32(prog, cols, 1, outs, precision);
+
+	free(cols);
+	free(outs);
+}
+
+void mp_program_eval_batch_f32(
+	const mp_program* prog,
+	const float* const* vars,
+	size_t rows,
+	float* const* out,
+	int precision
+)
+{
+	if(precision == MP_PRECISION_MIXED)
+		mp_program_eval_batch_f32_mixed(prog, vars, rows, out);
+	else
+		mp_program_eval_batch_f32_single(prog, vars, rows, out);
+}
+
+/**
+ * Evaluate a program over array and scalar variables, in chunks.
+ * @param Program.
+ * @param Variable arrays, indexed by slot.
+ * @param Variable array lengths, indexed by slot. (1 for scalars)
+ * @param Number of rows.
+ * @param Output columns, indexed by output.
+ */
+static void mp_program_eval_chunked(
+	const mp_program* prog,
+	const double* const* vars,
+	const size_t* lens,
+	size_t rows,
+	double* const* out
+)
+{
+	const size_t chunk = rows < MP_BROADCAST_CHUNK ? rows : MP_BROADCAST_CHUNK;
+
+	// Scalars are broadcast from a chunk sized column of copies
+	double* fill = malloc(sizeof(double) * chunk * (prog->var_len + 1));
+	const double** cols = malloc(sizeof(double*) * (prog->var_len + 1));
+	double** outs = malloc(sizeof(double*) * (prog->out_len + 1));
+	for(size_t i = 0; i < prog->var_len; ++i)
+		if(lens[i] == 1)
+			for(size_t j = 0; j < chunk; ++j)
+				fill[i * chunk + j] = vars[i][0];
+
+	// Loop over every chunk of rows
+	for(size_t row = 0; row < rows; row += chunk)
+	{
+		const size_t block = rows - row < chunk ? rows - row : chunk;
+
+		for(size_t i = 0; i < prog->var_len; ++i)
+			cols[i] = lens[i] == 1 ? &fill[i * chunk] : vars[i] + row;
+		for(size_t i = 0; i < prog->out_len; ++i)
+			outs[i] = out[i] + row;
+
+		mp_program_eval_batch_f64(prog, cols, block, outs);
+	}
+
+	free(fill);
+	free(cols);
+	free(outs);
+}
+
+void mp_program_eval_broadcast(
+	const mp_program* prog,
+	const double* const* vars,
+	const size_t* lens,
+	size_t rows,
+	double* const* out,
+	size_t* out_lens
+)
+{
+	// Copy the program so reductions can be replaced by their results
+	mp_program work = *prog;
+	work.nodes = malloc(sizeof(mp_node) * (prog->len + 1));
+	memcpy(work.nodes, prog->nodes, sizeof(mp_node) * prog->len);
+
+	// Flags marking nodes which depend on an array
+	char* is_array = malloc(prog->len + 1);
+
+	// Temporary column for reduction arguments
+	double* temp = NULL;
+
+	// Nodes are in evaluation order, so every operand is resolved before its users
+	for(size_t i = 0; i < work.len; ++i)
+	{
+		mp_node* n = &work.nodes[i];
+
+		// Propagate array flags from operands
+		is_array[i] = n->op == MP_TOKEN_VAR && lens[n->slot] != 1;
+		for(size_t j = 0; j < mp_node_argc(n); ++j)
+			is_array[i] |= is_array[n->args[j]];
+
+		// Only reductions over arrays need special treatment
+		if(n->op != MP_TOKEN_FUN || mp_funcs[n->slot].rfunc == NULL || !is_array[n->args[0]])
+			continue;
+
+		// Evaluate the argument over every row, using only the nodes before the reduction
+		mp_program prefix = work;
+		prefix.len = i;
+		prefix.outputs = &n->args[0];
+		prefix.out_len = 1;
+		if(temp == NULL) temp = malloc(sizeof(double) * rows);
+		mp_program_eval_chunked(&prefix, vars, lens, rows, &temp);
+
+		// Replace the reduction with its result
+		const double val = mp_funcs[n->slot].rfunc(temp, rows);
+		memset(n, 0, sizeof(mp_node));
+		n->op = MP_TOKEN_NUM;
+		n->val = val;
+		is_array[i] = 0;
+	}
+
+	// Only evaluate every row if an output depends on an array
+	size_t eval_rows = 1;
+	for(size_t i = 0; i < work.out_len; ++i)
+	{
+		out_lens[i] = is_array[work.outputs[i]] ? rows : 1;
+		if(out_lens[i] != 1) eval_rows = rows;
+	}
+
+	mp_program_eval_chunked(&work, vars, lens, eval_rows, out);
+
+	free(temp);
+	free(is_array);
+	free(work.nodes);
+}
\ No newline at end of file
@@ -0,0 +1,353 @@
+#ifndef MP_PROGRAM_H
+#define MP_PROGRAM_H
+
+/**
+ * Compiled programs. A program holds one or more expressions
+ * compiled into a single hash-consed expression graph, so that
+ * subexpressions shared between expressions are only stored
+ * (and evaluated) once.
+ */
+
+/** Includes. */
+#include "stddef.h"
+#include "math.h"
+#include "lexer.h"
+
+/** Value returned when compilation fails. */
+#define MP_PROGRAM_ERR ((size_t)-1)
+
+/** Maximum number of operands a node can have. */
+#define MP_NODE_MAX_ARGS 3
+
+/** Number of rows evaluated at a time in batch mode. */
+#define MP_PROGRAM_BLOCK 128
+
+/** Fused multiply-add node (args[0] * args[1] + args[2]). Only created by compile passes. */
+#define MP_NODE_FMA MP_TOKEN_COUNT
+
+/**
+ * Numeric builtin nodes (See numeric.h). args[0] and args[1] are the bounds,
+ * args[2] the values of the free variables of the body (See MP_NODE_ENV)
+ * and slot the index of the body in the program's bodies.
+ */
+#define MP_NODE_SOLVE (MP_TOKEN_COUNT + 1)
+#define MP_NODE_INTEGRATE (MP_TOKEN_COUNT + 2)
+#define MP_NODE_SUM (MP_TOKEN_COUNT + 3)
+
+/**
+ * Link of the list of values passed to a numeric builtin. args[0] is a value
+ * and args[1] the rest of the list, or the last value itself. The length of
+ * the list is the number of free variables of the body. (var_len - 1)
+ */
+#define MP_NODE_ENV (MP_TOKEN_COUNT + 4)
+
+/** Determine if an operation is a numeric builtin. */
+#define MP_NODE_IS_NUMERIC(op) ((op) >= MP_NODE_SOLVE && (op) <= MP_NODE_SUM)
+
+/** Fused multiply-add, if the target has one. (A multiply and an add otherwise) */
+#ifdef FP_FAST_FMA
+#define MP_FMA(a, b, c) fma(a, b, c)
+#else
+#define MP_FMA(a, b, c) ((a) * (b) + (c))
+#endif
+
+/** Single precision fused multiply-add, if the target has one. */
+#ifdef FP_FAST_FMAF
+#define MP_FMAF(a, b, c) fmaf(a, b, c)
+#else
+#define MP_FMAF(a, b, c) ((a) * (b) + (c))
+#endif
+
+/** Highest degree of a polynomial recognized by mp_program_rewrite_polynomials. */
+#define MP_POLY_MAX_DEGREE 16
+
+// Polynomial evaluation schemes
+#define MP_POLY_HORNER 0
+#define MP_POLY_ESTRIN 1
+
+// Single precision evaluation modes
+#define MP_PRECISION_SINGLE 0
+#define MP_PRECISION_MIXED 1
+
+// Expression graph node
+typedef struct
+{
+	/** Operation (One of the MP_TOKEN_* values). */
+	int op;
+
+	/** Indices of the operand nodes. */
+	size_t args[MP_NODE_MAX_ARGS];
+
+	/** Value of a number node. */
+	double val;
+
+	/** Variable slot of a variable node, function index of a function call or body index of a numeric builtin. */
+	size_t slot;
+
+} mp_node;
+
+// Compiled program
+typedef struct mp_program
+{
+	/** Nodes in evaluation order. (Operands always come before their users) */
+	mp_node* nodes;
+
+	/** Number of nodes. */
+	size_t len;
+
+	/** Number of nodes allocated. */
+	size_t allocated;
+
+	/** Names of the variables referenced by the program, indexed by slot. (Owned by the symbol table) */
+	const char** vars;
+
+	/** Symbol ids of the variables, indexed by slot. */
+	size_t* syms;
+
+	/** Number of variables. */
+	size_t var_len;
+
+	/** Root node of every compiled expression, indexed by output. */
+	size_t* outputs;
+
+	/** Number of outputs. */
+	size_t out_len;
+
+	/** Hash table mapping node contents to node indices. (Index + 1, 0 is empty) */
+	size_t* table;
+
+	/** Size of the hash table. (Always a power of two) */
+	size_t table_len;
+
+	/** Number of operations reused from earlier expressions while compiling. (Reuse within an expression isn't counted) */
+	size_t dedup_count;
+
+	/** Node assigned to every symbol (Node + 1, 0 is unbound), indexed by symbol id. (See mp_program_assign_tokens) */
+	size_t* binds;
+
+	/** Number of symbols the bind table covers. */
+	size_t bind_len;
+
+	/** Bodies of the numeric builtins, indexed by the slot of their nodes. (Owned by the program) */
+	struct mp_program** bodies;
+
+	/** Number of bodies. */
+	size_t body_len;
+
+	/**
+	 * Set to compile reductions (sum, mean, min and max of a single argument).
+	 * Only mp_program_eval_broadcast evaluates them, every other evaluator
+	 * works one row at a time, so compiling one fails unless this is set.
+	 */
+	char reductions;
+
+} mp_program;
+
+/**
+ * Get the number of operands of a node.
+ * @param Node.
+ * @return Number of operands.
+ */
+extern size_t mp_node_argc(const mp_node* n);
+
+/**
+ * Apply the operation of a node to operand values.
+ * @param Node.
+ * @param Operand values.
+ * @return Result.
+ */
+extern double mp_node_apply(const mp_node* n, const double* args);
+
+/**
+ * Create an empty program.
+ * @return New program.
+ * @note Must be destroyed with mp_program_destroy.
+ */
+extern mp_program* mp_program_create();
+
+/**
+ * Destroy a program.
+ * @param Program.
+ */
+extern void mp_program_destroy(mp_program* prog);
+
+/**
+ * Compile an expression and add it to a program.
+ * @param Program.
+ * @param Expression string.
+ * @return Output index of the expression, or MP_PROGRAM_ERR on failure.
+ * @note Uses the parser's token queue, so the parser must be initialized.
+ */
+extern size_t mp_program_add(mp_program* prog, const char* str);
+
+/**
+ * Compile an expression in polish notation and add it to a program.
+ * @param Program.
+ * @param Tokens in polish notation.
+ * @param Number of tokens.
+ * @param Literal pool the number tokens index. (See mp_get_parser_literals)
+ * @return Output index of the expression, or MP_PROGRAM_ERR on failure.
+ */
+extern size_t mp_program_add_tokens(mp_program* prog, const token* tokens, size_t len, const double* literals);
+
+/**
+ * Compile an assignment in polish notation (Without the variable and the
+ * equal sign) and bind the variable to its value. Expressions compiled
+ * into the program afterwards read the bound value directly instead of
+ * the variable's slot, so assignments cost nothing at evaluation time.
+ * Assigning a variable again replaces the binding.
+ * @param Program.
+ * @param Symbol id of the assigned variable. (Scratch symbols are rejected)
+ * @param Tokens of the value in polish notation.
+ * @param Number of tokens.
+ * @param Literal pool the number tokens index. (See mp_get_parser_literals)
+ * @return Node holding the value, or MP_PROGRAM_ERR on failure.
+ * @note The value isn't an output. Use mp_program_add_node to read it after evaluation.
+ */
+extern size_t mp_program_assign_tokens(
+	mp_program* prog, 
+	size_t sym, 
+	const token* tokens, 
+	size_t len, 
+	const double* literals
+);
+
+/**
+ * Get the node a variable is bound to.
+ * @param Program.
+ * @param Symbol id of the variable.
+ * @return Node index, or MP_PROGRAM_ERR if the variable isn't bound.
+ */
+extern size_t mp_program_bound_node(const mp_program* prog, size_t sym);
+
+/**
+ * Add an output reading an existing node.
+ * @param Program.
+ * @param Node index.
+ * @return Output index.
+ */
+extern size_t mp_program_add_node(mp_program* prog, size_t node);
+
+/**
+ * Create an optimized copy of a program. Constant subexpressions are
+ * folded, identities like x * 1 and x ^ 1 are removed and nodes which
+ * don't contribute to an output are dropped.
+ * @param Program.
+ * @return Optimized program, with the same variable slots and outputs.
+ * @note Variable bindings aren't copied.
+ * @note Must be destroyed with mp_program_destroy.
+ */
+extern mp_program* mp_program_optimize(const mp_program* prog);
+
+/**
+ * Create a copy of a program with polynomial subexpressions rewritten.
+ * Sums of terms like a * x^3 + b * x^2 + c * x + d, where the coefficients
+ * don't depend on x, are evaluated with fused multiply-adds instead of
+ * powers and separate multiplies.
+ * @param Program.
+ * @param MP_POLY_HORNER for the fewest operations, or MP_POLY_ESTRIN for
+ * shorter dependency chains (More instruction level parallelism in batch mode).
+ * @return Rewritten program, with the same variable slots and outputs.
+ * @note Results may differ from the original program by rounding.
+ * @note Must be destroyed with mp_program_destroy.
+ */
+extern mp_program* mp_program_rewrite_polynomials(const mp_program* prog, int form);
+
+/**
+ * Find the slot of a variable referenced by a program.
+ * @param Program.
+ * @param Variable name.
+ * @return Variable slot, or MP_PROGRAM_ERR if the program doesn't reference it.
+ */
+extern size_t mp_program_find_var(const mp_program* prog, const char* name);
+
+/**
+ * Evaluate every output of a program for a single set of variable values.
+ * @param Program.
+ * @param Variable values, indexed by slot.
+ * @param Array to write the outputs to, indexed by output.
+ */
+extern void mp_program_eval(const mp_program* prog, const double* vars, double* out);
+
+/**
+ * Evaluate every node of a program for a single set of variable values into
+ * caller provided registers, so evaluating a program many times in a row
+ * doesn't allocate. The outputs are the registers of the output nodes.
+ * @param Program.
+ * @param Variable values, indexed by slot.
+ * @param Registers, one per node.
+ */
+extern void mp_program_eval_regs(const mp_program* prog, const double* vars, double* regs);
+
+/**
+ * Evaluate every output of a program for many sets of variable values.
+ * @param Program.
+ * @param Variable columns, indexed by slot. Each column holds one value per row.
+ * @param Number of rows.
+ * @param Output columns, indexed by output. Each column receives one value per row.
+ */
+extern void mp_program_eval_batch(
+	const mp_program* prog,
+	const double* const* vars,
+	size_t rows,
+	double* const* out
+);
+
+/**
+ * Evaluate every output of a program over variables bound to arrays.
+ * Operations apply element-wise, scalar variables are broadcast over
+ * every row and reductions (sum, mean, min, max) collapse an array
+ * argument to a scalar.
+ * @param Program. (Compiled with reductions set to use them)
+ * @param Variable arrays, indexed by slot.
+ * @param Variable array lengths, indexed by slot. Either 1 (Scalar) or the number of rows.
+ * @param Number of rows.
+ * @param Output columns, indexed by output. Each column must fit the number of rows.
+ * @param Array to write the number of values of each output to. (1 or the number of rows)
+ */
+extern void mp_program_eval_broadcast(
+	const mp_program* prog,
+	const double* const* vars,
+	const size_t* lens,
+	size_t rows,
+	double* const* out,
+	size_t* out_lens
+);
+
+/**
+ * Evaluate every output of a program for a single set of single precision variable values.
+ * @param Program.
+ * @param Variable values, indexed by slot.
+ * @param Array to write the outputs to, indexed by output.
+ * @param MP_PRECISION_SINGLE to compute in single precision, or
+ * MP_PRECISION_MIXED to compute in double precision.
+ */
+extern void mp_program_eval_f32(
+	const mp_program* prog,
+	const float* vars,
+	float* out,
+	int precision
+);
+
+/**
+ * Evaluate every output of a program for many sets of single precision variable values.
+ * @param Program.
+ * @param Variable columns, indexed by slot. Each column holds one value per row.
+ * @param Number of rows.
+ * @param Output columns, indexed by output. Each column receives one value per row.
+ * @param MP_PRECISION_SINGLE to compute in single precision, or
+ * MP_PRECISION_MIXED to compute in double precision.
+ * @note Single precision computation doubles the number of SIMD lanes
+ * and halves memory traffic. Mixed precision only halves memory traffic.
+ * @note Function calls run the single precision versions of the built-ins
+ * (sqrtf, expf, ...) in single precision, but are still made one row at a
+ * time through the function table, so they don't vectorize.
+ */
+extern void mp_program_eval_batch_f32(
+	const mp_program* prog,
+	const float* const* vars,
+	size_t rows,
+	float* const* out,
+	int precision
+);
+#endif
\ No newline at end of file
@@ -0,0 +1,200 @@
+/**
+ * Evaluation kernel template for compiled programs. This file is included
+ * by program.c once per supported precision, with these macros defined:
+ *
+ * MP_KERNEL_BLOCK - Name of the generated block evaluation function.
+ * MP_KERNEL_BATCH - Name of the generated batch evaluation function.
+ * MP_KERNEL_STORAGE - Type of the variable and output columns.
+ * MP_KERNEL_REAL - Type of the registers every operation is computed in.
+ * MP_KERNEL_POW - Exponentiation function for MP_KERNEL_REAL.
+ * MP_KERNEL_FMA - Fused multiply-add for MP_KERNEL_REAL.
+ * MP_KERNEL_FUNC - Field of mp_func holding the MP_KERNEL_REAL version of a function.
+ *
+ * The macros are undefined again at the end of the file.
+ */
+
+/**
+ * Evaluate one block of rows. Every node is evaluated once per row,
+ * in node order, into its own register column. Comparisons, logic
+ * and selects are written without branches so the loops vectorize
+ * into compare and blend instructions.
+ * @param Program.
+ * @param Variable columns, offset to the first row of the block.
+ * @param Number of rows in the block.
+ * @param Register columns. (MP_PROGRAM_BLOCK values per node)
+ */
+static void MP_KERNEL_BLOCK(
+	const mp_program* prog,
+	const MP_KERNEL_STORAGE* const* vars,
+	size_t rows,
+	MP_KERNEL_REAL* regs
+)
+{
+	for(size_t i = 0; i < prog->len; ++i)
+	{
+		const mp_node* n = &prog->nodes[i];
+		const MP_KERNEL_STORAGE* v = n->op == MP_TOKEN_VAR ? vars[n->slot] : NULL;
+		MP_KERNEL_REAL* r = regs + i * MP_PROGRAM_BLOCK;
+		const MP_KERNEL_REAL* a = regs + n->args[0] * MP_PROGRAM_BLOCK;
+		const MP_KERNEL_REAL* b = regs + n->args[1] * MP_PROGRAM_BLOCK;
+		const MP_KERNEL_REAL* c = regs + n->args[2] * MP_PROGRAM_BLOCK;
+
+		switch(n->op)
+		{
+		case MP_TOKEN_NUM:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)n->val;
+			break;
+
+		case MP_TOKEN_VAR:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)v[j];
+			break;
+
+		case MP_TOKEN_NEG:
+			for(size_t j = 0; j < rows; ++j) r[j] = -a[j];
+			break;
+
+		case MP_TOKEN_ADD:
+			for(size_t j = 0; j < rows; ++j) r[j] = a[j] + b[j];
+			break;
+
+		case MP_TOKEN_SUB:
+			for(size_t j = 0; j < rows; ++j) r[j] = a[j] - b[j];
+			break;
+
+		case MP_TOKEN_MUL:
+			for(size_t j = 0; j < rows; ++j) r[j] = a[j] * b[j];
+			break;
+
+		case MP_TOKEN_DIV:
+			for(size_t j = 0; j < rows; ++j) r[j] = a[j] / b[j];
+			break;
+
+		case MP_TOKEN_EXP:
+			for(size_t j = 0; j < rows; ++j) r[j] = MP_KERNEL_POW(a[j], b[j]);
+			break;
+
+		case MP_TOKEN_LT:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)(a[j] < b[j]);
+			break;
+
+		case MP_TOKEN_LE:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)(a[j] <= b[j]);
+			break;
+
+		case MP_TOKEN_GT:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)(a[j] > b[j]);
+			break;
+
+		case MP_TOKEN_GE:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)(a[j] >= b[j]);
+			break;
+
+		case MP_TOKEN_EQ:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)(a[j] == b[j]);
+			break;
+
+		case MP_TOKEN_NE:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)(a[j] != b[j]);
+			break;
+
+		case MP_TOKEN_AND:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)((a[j] != 0) & (b[j] != 0));
+			break;
+
+		case MP_TOKEN_OR:
+			for(size_t j = 0; j < rows; ++j) r[j] = (MP_KERNEL_REAL)((a[j] != 0) | (b[j] != 0));
+			break;
+
+		case MP_TOKEN_COL:
+			for(size_t j = 0; j < rows; ++j) r[j] = a[j] != 0 ? b[j] : c[j];
+			break;
+
+		case MP_NODE_FMA:
+			for(size_t j = 0; j < rows; ++j) r[j] = MP_KERNEL_FMA(a[j], b[j], c[j]);
+			break;
+
+		case MP_TOKEN_FUN:
+			{
+				const mp_func* f = &mp_funcs[n->slot];
+				MP_KERNEL_REAL args[MP_NODE_MAX_ARGS];
+				for(size_t j = 0; j < rows; ++j)
+				{
+					for(size_t k = 0; k < f->argc; ++k)
+						args[k] = regs[n->args[k] * MP_PROGRAM_BLOCK + j];
+					r[j] = f->MP_KERNEL_FUNC(args);
+				}
+			}
+			break;
+
+		// Numeric builtins run their body once per row
+		case MP_NODE_SOLVE:
+		case MP_NODE_INTEGRATE:
+		case MP_NODE_SUM:
+			{
+				const mp_program* body = prog->bodies[n->slot];
+				size_t* nodes = malloc(sizeof(size_t) * (body->var_len + 1));
+				double* body_vars = malloc(sizeof(double) * (body->var_len + 1));
+				mp_program_env_nodes(prog, n, nodes);
+				for(size_t j = 0; j < rows; ++j)
+				{
+					for(size_t k = 1; k < body->var_len; ++k)
+						body_vars[k] = regs[nodes[k] * MP_PROGRAM_BLOCK + j];
+					r[j] = (MP_KERNEL_REAL)mp_numeric_eval(n->op, body, a[j], b[j], body_vars);
+				}
+				free(nodes);
+				free(body_vars);
+			}
+			break;
+		}
+	}
+}
+
+/**
+ * Evaluate every output of a program for many sets of variable values.
+ * @param Program.
+ * @param Variable columns, indexed by slot.
+ * @param Number of rows.
+ * @param Output columns, indexed by output.
+ */
+static void MP_KERNEL_BATCH(
+	const mp_program* prog,
+	const MP_KERNEL_STORAGE* const* vars,
+	size_t rows,
+	MP_KERNEL_STORAGE* const* out
+)
+{
+	// Register file and block variable columns
+	MP_KERNEL_REAL* regs = malloc(sizeof(MP_KERNEL_REAL) * MP_PROGRAM_BLOCK * (prog->len + 1));
+	const MP_KERNEL_STORAGE** cols = malloc(sizeof(MP_KERNEL_STORAGE*) * (prog->var_len + 1));
+
+	// Loop over every block of rows
+	for(size_t row = 0; row < rows; row += MP_PROGRAM_BLOCK)
+	{
+		const size_t block = rows - row < MP_PROGRAM_BLOCK ? rows - row : MP_PROGRAM_BLOCK;
+
+		// Offset variable columns to the current block
+		for(size_t i = 0; i < prog->var_len; ++i)
+			cols[i] = vars[i] + row;
+
+		MP_KERNEL_BLOCK(prog, cols, block, regs);
+
+		// Copy the outputs out of the register file
+		for(size_t i = 0; i < prog->out_len; ++i)
+		{
+			const MP_KERNEL_REAL* r = regs + prog->outputs[i] * MP_PROGRAM_BLOCK;
+			MP_KERNEL_STORAGE* o = out[i] + row;
+			for(size_t j = 0; j < block; ++j) o[j] = (MP_KERNEL_STORAGE)r[j];
+		}
+	}
+
+	free(regs);
+	free(cols);
+}
+
+#undef MP_KERNEL_BLOCK
+#undef MP_KERNEL_BATCH
+#undef MP_KERNEL_STORAGE
+#undef MP_KERNEL_REAL
+#undef MP_KERNEL_POW
+#undef MP_KERNEL_FMA
+#undef MP_KERNEL_FUNC
\ No newline at end of file
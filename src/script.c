@@ -0,0 +1,164 @@
+/** Includes. */
+#include "string.h"
+#include "stdlib.h"
+#include "lexer.h"
+#include "parser.h"
+#include "symbols.h"
+#include "program.h"
+#include "script.h"
+
+/**
+ * Compile one statement into a script.
+ * @param Script.
+ * @param Statement source.
+ * @param Raw program being built.
+ * @param Per symbol flags marking bindings nothing has read yet. (Grown as symbols are added)
+ * @param Number of symbols the flags cover.
+ * @return 1 if the statement was compiled, 0 otherwise.
+ */
+static char mp_script_add_statement(
+	mp_script* script, 
+	const char* str, 
+	mp_program* prog, 
+	char** unread_flags, 
+	size_t* unread_len
+)
+{
+	if(!mp_lex_string(str)) return 0;
+
+	// Lexing may have interned new names
+	const size_t symbols = mp_symbol_count();
+	if(*unread_len < symbols)
+	{
+		*unread_flags = realloc(*unread_flags, symbols * 2);
+		memset(*unread_flags + *unread_len, 0, symbols * 2 - *unread_len);
+		*unread_len = symbols * 2;
+	}
+	char* unread = *unread_flags;
+
+	size_t len;
+	const token* tokens = mp_get_polish_tokens(&len);
+	const double* literals = mp_get_parser_literals();
+
+	// Assignments look like "x <expression> =" in polish notation
+	size_t target = MP_SYMBOL_ERR;
+	if(len >= 3 && tokens[0].id == MP_TOKEN_VAR && tokens[len - 1].id == MP_TOKEN_EQL)
+	{
+		target = tokens[0].index;
+		++tokens;
+		len -= 2;
+	}
+
+	// Scratch symbols (See mp_scratch_symbol) are out of range of the unread flags
+	if(target != MP_SYMBOL_ERR && target >= MP_SYMBOL_MAX) return 0;
+
+	// Reading a variable consumes its binding
+	for(size_t i = 0; i < len; ++i)
+	{
+		if(tokens[i].id == MP_TOKEN_EQL) return 0;
+		if(tokens[i].id != MP_TOKEN_VAR) continue;
+		if(tokens[i].index >= MP_SYMBOL_MAX) return 0;
+		unread[tokens[i].index] = 0;
+	}
+
+	// Expression statements are outputs
+	if(target == MP_SYMBOL_ERR)
+	{
+		if(mp_program_add_tokens(prog, tokens, len, literals) == MP_PROGRAM_ERR) return 0;
+		++script->result_len;
+		return 1;
+	}
+
+	// Rebinding a variable nothing read drops the old value
+	const char bound = mp_program_bound_node(prog, target) != MP_PROGRAM_ERR;
+	if(mp_program_assign_tokens(prog, target, tokens, len, literals) == MP_PROGRAM_ERR) return 0;
+	if(bound && unread[target]) ++script->dead_len;
+	unread[target] = 1;
+
+	// Remember the variable to store it afterwards
+	if(!bound)
+	{
+		script->assigns = realloc(script->assigns, sizeof(size_t) * (script->assign_len + 1));
+		script->assigns[script->assign_len++] = target;
+	}
+
+	return 1;
+}
+
+mp_script* mp_script_create(const char* src, size_t* error_line)
+{
+	mp_script* script = calloc(1, sizeof(mp_script));
+	mp_program* prog = mp_program_create();
+
+	// Statement buffer and per symbol flags
+	const size_t src_len = strlen(src);
+	char* buf = malloc(src_len + 1);
+	size_t unread_len = 0;
+	char* unread = NULL;
+
+	size_t line = 1;
+	for(size_t i = 0; i <= src_len; ++i)
+	{
+		// Copy the statement, skipping comments and turning tabs into spaces
+		size_t len = 0;
+		char blank = 1;
+		for(; i < src_len && src[i] != ';' && src[i] != '\n'; ++i)
+		{
+			if(src[i] == '#')
+			{
+				while(i + 1 < src_len && src[i + 1] != '\n') ++i;
+				continue;
+			}
+
+			const char c = src[i] == '\t' || src[i] == '\r' ? ' ' : src[i];
+			blank &= c == ' ';
+			buf[len++] = c;
+		}
+		buf[len] = '\0';
+
+		if(!blank)
+		{
+			const char ok = mp_script_add_statement(script, buf, prog, &unread, &unread_len);
+			mp_flush_parser_tokens();
+			++script->statement_len;
+
+			if(!ok)
+			{
+				if(error_line != NULL) *error_line = line;
+				free(buf);
+				free(unread);
+				mp_program_destroy(prog);
+				mp_script_destroy(script);
+				return NULL;
+			}
+		}
+
+		if(i < src_len && src[i] == '\n') ++line;
+	}
+
+	// Final values of the assigned variables follow the results
+	for(size_t i = 0; i < script->assign_len; ++i)
+		mp_program_add_node(prog, mp_program_bound_node(prog, script->assigns[i]));
+
+	// Fold constants and drop the nodes of overwritten assignments
+	script->prog = mp_program_optimize(prog);
+	mp_program_destroy(prog);
+
+	// Find the variables the remaining nodes read
+	script->used = calloc(script->prog->var_len + 1, 1);
+	for(size_t i = 0; i < script->prog->len; ++i)
+		if(script->prog->nodes[i].op == MP_TOKEN_VAR)
+			script->used[script->prog->nodes[i].slot] = 1;
+
+	free(buf);
+	free(unread);
+	return script;
+}
+
+void mp_script_destroy(mp_script* script)
+{
+	if(script->prog != NULL) mp_program_destroy(script->prog);
+	free(script->assigns);
+	free(script->used);
+	free(script);
+}
@@ -0,0 +1,62 @@
+#ifndef MP_SCRIPT_H
+#define MP_SCRIPT_H
+
+/**
+ * Scripts. A script is a list of statements separated by semicolons or
+ * newlines, each an assignment or an expression, compiled into a single
+ * program. Assignments bind the variable to the assigned value, so later
+ * statements read it directly, and assignments nothing reads are dropped.
+ * The whole script then runs with one evaluation of the program.
+ * Text from # to the end of the line is a comment.
+ */
+
+/** Includes. */
+#include "stddef.h"
+#include "program.h"
+
+// Compiled script
+typedef struct
+{
+	/** Program holding every statement. */
+	mp_program* prog;
+
+	/** Number of expression statements. Their values are outputs 0 and up, in order. */
+	size_t result_len;
+
+	/**
+	 * Symbol ids of the assigned variables, in order of first assignment.
+	 * The final value of assigns[i] is output result_len + i.
+	 */
+	size_t* assigns;
+
+	/** Number of assigned variables. */
+	size_t assign_len;
+
+	/** Set for every variable slot the script reads. (Slots only read by dropped statements are clear) */
+	char* used;
+
+	/** Number of statements. */
+	size_t statement_len;
+
+	/** Number of assignments which were overwritten before anything read them. */
+	size_t dead_len;
+
+} mp_script;
+
+/**
+ * Compile a script.
+ * @param Script source.
+ * @param Pointer to write the line of the first invalid statement to (Counting from 1), or NULL.
+ * @return New script, or NULL if a statement is invalid.
+ * @note Uses the parser's token queue, so the parser must be initialized.
+ * Statements naming scratch symbols (See mp_set_lexer_scratch) are invalid.
+ * @note Must be destroyed with mp_script_destroy.
+ */
+extern mp_script* mp_script_create(const char* src, size_t* error_line);
+
+/**
+ * Destroy a script.
+ * @param Script.
+ */
+extern void mp_script_destroy(mp_script* script);
+#endif
@@ -0,0 +1,1195 @@
+/** Includes. */
+#include "string.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "parser.h"
+#include "program.h"
+#include "store.h"
+#include "symbols.h"
+#include "tiered.h"
+#include "server.h"
+
+#ifdef __linux__
+
+#include "errno.h"
+#include "signal.h"
+#include "stdint.h"
+#include "pthread.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/epoll.h"
+#include "sys/eventfd.h"
+#include "sys/socket.h"
+#include "sys/un.h"
+#include "netinet/in.h"
+#include "arpa/inet.h"
+
+/** Number of bytes to read from a connection at a time. */
+#define MP_SERVER_READ_SIZE 4096
+
+/** Length of request lines, in bytes, which are answered with an error instead of evaluated. */
+#define MP_SERVER_MAX_LINE 65536
+
+/** Number of requests of a connection being evaluated above which it stops being read. */
+#define MP_SERVER_MAX_INFLIGHT 4096
+
+/** Number of response bytes waiting to be written above which a connection stops being read. */
+#define MP_SERVER_MAX_PENDING_OUT (1 << 20)
+
+/** Maximum number of formulas a worker keeps tiered expressions for. */
+#define MP_SERVER_MAX_FORMULAS 4096
+
+/** Maximum number of events handled per event loop iteration. */
+#define MP_SERVER_MAX_EVENTS 64
+
+// Request, and later response, for a single line
+typedef struct mp_serve_item
+{
+	/** Connection file descriptor. */
+	int fd;
+
+	/** Connection generation, to detect responses for closed connections. */
+	unsigned gen;
+
+	/** Request expression. Replaced by the response once evaluated. */
+	char* line;
+
+	/** Set when the request line reached MP_SERVER_MAX_LINE. (line is empty) */
+	char too_long;
+
+	/** Next item in the queue. */
+	struct mp_serve_item* next;
+
+} mp_serve_item;
+
+// Item queue
+typedef struct
+{
+	/** First item. */
+	mp_serve_item* head;
+
+	/** Last item. */
+	mp_serve_item* tail;
+
+} mp_serve_queue;
+
+// Formula a worker has seen before
+typedef struct
+{
+	/** Request line, or NULL if the entry is empty. */
+	char* line;
+
+	/** Hash of the line. */
+	size_t hash;
+
+	/** Tiered expression of the value (See tiered.h), or NULL if the formula can't be tiered. */
+	mp_tiered* expr;
+
+	/** Symbol of the variable the formula assigns, or MP_SYMBOL_ERR. */
+	size_t target;
+
+	/** Set when the formula is sent again, cleared when the cache is pruned. */
+	char reused;
+
+} mp_serve_formula;
+
+// Formulas a worker has seen before, so formulas sent again and again are promoted through the tiers
+typedef struct
+{
+	/** Hash table of formulas, with room for twice MP_SERVER_MAX_FORMULAS. (NULL until first used) */
+	mp_serve_formula* table;
+
+	/** Number of formulas. */
+	size_t len;
+
+} mp_serve_cache;
+
+// Evaluation worker
+typedef struct
+{
+	/** Worker thread. */
+	pthread_t thread;
+
+	/** Lock protecting the queue. */
+	pthread_mutex_t lock;
+
+	/** Signaled when items are added to the queue. */
+	pthread_cond_t cond;
+
+	/** Items waiting to be evaluated. */
+	mp_serve_queue queue;
+
+	/** Items read this event loop iteration. (Event loop only) */
+	mp_serve_queue pending;
+
+	/** Formulas evaluated before. (Worker thread only) */
+	mp_serve_cache formulas;
+
+} mp_serve_worker;
+
+// Client connection
+typedef struct
+{
+	/** Set while the connection is open. */
+	char active;
+
+	/** Incremented every time the descriptor is closed. */
+	unsigned gen;
+
+	/** Bytes read but not yet split into lines. */
+	char* in;
+	size_t in_len;
+	size_t in_cap;
+
+	/** Bytes waiting to be written. */
+	char* out;
+	size_t out_len;
+	size_t out_off;
+	size_t out_cap;
+
+	/** Number of requests being evaluated. */
+	size_t inflight;
+
+	/** Set once the client has stopped sending. */
+	char eof;
+
+	/** Set while skipping the rest of a line which reached MP_SERVER_MAX_LINE. */
+	char discard;
+
+	/** Events registered with the event loop, 0 if the descriptor isn't registered. */
+	uint32_t events;
+
+	/** Set while waiting for the socket to become writable. */
+	char want_write;
+
+	/** Set while responses are waiting to be flushed. */
+	char dirty;
+
+} mp_serve_conn;
+
+/** Server state. */
+static struct
+{
+	/** Event loop descriptors. */
+	int epoll_fd;
+	int listen_fd;
+	int event_fd;
+
+	/** Set to stop the server. */
+	volatile sig_atomic_t stop;
+
+	/** Set while the server is running. */
+	volatile sig_atomic_t running;
+
+	/** Path of the Unix domain socket, or NULL when listening on TCP. */
+	const char* unix_path;
+
+	/** Evaluation workers. */
+	mp_serve_worker* workers;
+	size_t worker_len;
+
+	/** Connections, indexed by file descriptor. */
+	mp_serve_conn* conns;
+	size_t conn_cap;
+
+	/** Evaluated items waiting to be sent. */
+	pthread_mutex_t done_lock;
+	mp_serve_queue done;
+
+} mp_server;
+
+/**
+ * Append a list of items to a queue.
+ * @param Queue.
+ * @param First item of the list.
+ * @param Last item of the list.
+ */
+static void mp_serve_queue_append(mp_serve_queue* q, mp_serve_item* head, mp_serve_item* tail)
+{
+	if(head == NULL) return;
+
+	if(q->tail != NULL) q->tail->next = head;
+	else q->head = head;
+	q->tail = tail;
+}
+
+/**
+ * Create a copy of a formatted string.
+ * @param Format string.
+ * @param String argument.
+ * @return String. (Allocated with malloc, must be freed)
+ */
+static char* mp_serve_format(const char* fmt, const char* arg)
+{
+	const int len = snprintf(NULL, 0, fmt, arg);
+	char* str = malloc((size_t)len + 1);
+	snprintf(str, (size_t)len + 1, fmt, arg);
+	return str;
+}
+
+/**
+ * Find the entry of a formula, or the empty entry it would go in.
+ * @param Formula cache.
+ * @param Request line.
+ * @return Entry.
+ */
+static mp_serve_formula* mp_serve_cache_find(mp_serve_cache* cache, const char* line)
+{
+	const size_t table_len = MP_SERVER_MAX_FORMULAS * 2;
+	if(cache->table == NULL) cache->table = calloc(table_len, sizeof(mp_serve_formula));
+
+	uint64_t h = 14695981039346656037ull;
+	for(const char* c = line; *c != '\0'; ++c)
+	{
+		h ^= (unsigned char)*c;
+		h *= 1099511628211ull;
+	}
+
+	const size_t hash = (size_t)h;
+	for(size_t i = hash & (table_len - 1);; i = (i + 1) & (table_len - 1))
+	{
+		mp_serve_formula* f = &cache->table[i];
+		if(f->line == NULL || (f->hash == hash && strcmp(f->line, line) == 0))
+		{
+			f->hash = hash;
+			return f;
+		}
+	}
+}
+
+/**
+ * Make room in a full cache by forgetting every formula which wasn't sent
+ * again since the last time, keeping at most half of the rest.
+ * @param Formula cache.
+ */
+static void mp_serve_cache_prune(mp_serve_cache* cache)
+{
+	mp_serve_cache kept;
+	kept.table = NULL;
+	kept.len = 0;
+
+	for(size_t i = 0; i < MP_SERVER_MAX_FORMULAS * 2; ++i)
+	{
+		mp_serve_formula* f = &cache->table[i];
+		if(f->line == NULL) continue;
+
+		if(f->reused && kept.len < MP_SERVER_MAX_FORMULAS / 2)
+		{
+			mp_serve_formula* dst = mp_serve_cache_find(&kept, f->line);
+			*dst = *f;
+			dst->reused = 0;
+			++kept.len;
+			continue;
+		}
+
+		free(f->line);
+		if(f->expr != NULL) mp_tiered_destroy(f->expr);
+	}
+
+	free(cache->table);
+	*cache = kept;
+}
+
+/**
+ * Forget every formula of a cache.
+ * @param Formula cache.
+ */
+static void mp_serve_cache_clear(mp_serve_cache* cache)
+{
+	for(size_t i = 0; cache->table != NULL && i < MP_SERVER_MAX_FORMULAS * 2; ++i)
+	{
+		free(cache->table[i].line);
+		if(cache->table[i].expr != NULL) mp_tiered_destroy(cache->table[i].expr);
+	}
+	free(cache->table);
+	cache->table = NULL;
+	cache->len = 0;
+}
+
+/**
+ * Determine if every name of a request is interned, so its tokens mean
+ * the same thing in every batch.
+ * @param Request tokens.
+ * @param Number of tokens.
+ * @return 1 if they are, 0 if the request names scratch symbols.
+ */
+static char mp_serve_interned(const token* tokens, size_t len)
+{
+	for(size_t i = 0; i < len; ++i)
+		if((tokens[i].id == MP_TOKEN_VAR || tokens[i].id == MP_TOKEN_FUN) && tokens[i].index >= MP_SYMBOL_MAX)
+			return 0;
+
+	return 1;
+}
+
+// Requests evaluated against the same snapshot of the variables
+typedef struct
+{
+	/** Program holding every request of the segment. */
+	mp_program* prog;
+
+	/** Variables the segment reads. */
+	const mp_snapshot* snap;
+
+	/** First request of the segment. */
+	mp_serve_item* first;
+
+	/** Number of requests in the segment. */
+	size_t len;
+
+	/** Output index of every request, or MP_PROGRAM_ERR. */
+	size_t* outs;
+
+	/** Cached tiered expression of every request, or NULL if it is compiled into the program. */
+	mp_tiered** exprs;
+
+	/** Error of every request, or NULL. */
+	char** errs;
+
+	/** Symbol of the variable every request assigns, or MP_SYMBOL_ERR. */
+	size_t* targets;
+
+} mp_serve_segment;
+
+/**
+ * Start a new segment.
+ * @param Segment.
+ * @param First request of the segment.
+ * @param Reader slot of the worker.
+ */
+static void mp_serve_segment_begin(mp_serve_segment* seg, mp_serve_item* first, size_t reader)
+{
+	seg->prog = mp_program_create();
+	seg->snap = mp_store_acquire(mp_get_variable_store(), reader);
+	seg->first = first;
+	seg->len = 0;
+}
+
+/**
+ * Determine if a request reads a variable assigned earlier in a segment.
+ * @param Segment.
+ * @param Request tokens.
+ * @param Number of tokens.
+ * @return 1 if it does, 0 otherwise.
+ */
+static char mp_serve_segment_depends(const mp_serve_segment* seg, const token* tokens, size_t len)
+{
+	for(size_t i = 0; i < len; ++i)
+		if(tokens[i].id == MP_TOKEN_VAR)
+			for(size_t j = 0; j < seg->len; ++j)
+				if(seg->targets[j] == tokens[i].index)
+					return 1;
+
+	return 0;
+}
+
+/**
+ * Determine if a cached formula reads a variable assigned earlier in a segment.
+ * @param Segment.
+ * @param Tiered expression of the formula.
+ * @return 1 if it does, 0 otherwise.
+ */
+static char mp_serve_segment_depends_expr(const mp_serve_segment* seg, const mp_tiered* expr)
+{
+	for(size_t i = 0; i < mp_tiered_var_count(expr); ++i)
+	{
+		const size_t sym = mp_find_symbol(mp_tiered_var_name(expr, i));
+		for(size_t j = 0; j < seg->len; ++j)
+			if(seg->targets[j] == sym)
+				return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Evaluate a segment, replace its requests with responses and publish its assignments.
+ * @param Segment.
+ * @param Reader slot of the worker.
+ */
+static void mp_serve_segment_end(mp_serve_segment* seg, size_t reader)
+{
+	mp_program* prog = seg->prog;
+
+	// Bind the variables and evaluate every request at once
+	double* vars = malloc(sizeof(double) * (prog->var_len + 1));
+	double* results = malloc(sizeof(double) * (prog->out_len + 1));
+	for(size_t i = 0; i < prog->var_len; ++i)
+		if(!mp_snapshot_get(seg->snap, prog->vars[i], &vars[i]))
+			vars[i] = NAN;
+	mp_program_eval(prog, vars, results);
+
+	// Requests seen before run from their tiered expressions instead
+	double* values = malloc(sizeof(double) * (seg->len + 1));
+	double* expr_vars = NULL;
+	for(size_t i = 0; i < seg->len; ++i)
+	{
+		mp_tiered* expr = seg->exprs[i];
+		if(seg->errs[i] != NULL) continue;
+		if(expr == NULL)
+		{
+			values[i] = results[seg->outs[i]];
+			continue;
+		}
+
+		const size_t var_len = mp_tiered_var_count(expr);
+		expr_vars = realloc(expr_vars, sizeof(double) * (var_len + 1));
+		for(size_t j = 0; j < var_len; ++j)
+			if(!mp_snapshot_get(seg->snap, mp_tiered_var_name(expr, j), &expr_vars[j]))
+				expr_vars[j] = NAN;
+		values[i] = mp_tiered_eval(expr, expr_vars);
+	}
+	mp_store_release(mp_get_variable_store(), reader);
+
+	// Replace the requests with the responses
+	mp_store_update* updates = malloc(sizeof(mp_store_update) * (seg->len + 1));
+	size_t update_len = 0;
+	mp_serve_item* it = seg->first;
+	for(size_t i = 0; i < seg->len; ++i, it = it->next)
+	{
+		free(it->line);
+		if(seg->errs[i] != NULL)
+		{
+			it->line = seg->errs[i];
+			continue;
+		}
+
+		char num[32];
+		snprintf(num, sizeof(num), "%.17g", values[i]);
+		it->line = mp_serve_format("%s", num);
+
+		if(seg->targets[i] != MP_SYMBOL_ERR)
+		{
+			updates[update_len].name = mp_symbol_name(seg->targets[i]);
+			updates[update_len].val = values[i];
+			updates[update_len].remove = 0;
+			++update_len;
+		}
+	}
+
+	// Every assignment of the segment becomes visible at once
+	if(update_len != 0) mp_store_publish(mp_get_variable_store(), updates, update_len);
+
+	free(updates);
+	free(vars);
+	free(results);
+	free(values);
+	free(expr_vars);
+	mp_program_destroy(prog);
+}
+
+/**
+ * Evaluate a batch of requests, replacing every request with its response.
+ * New requests are compiled into as few programs as possible, so
+ * subexpressions shared between requests are evaluated once. Requests the
+ * worker has seen before skip lexing and compilation and run from their
+ * cached tiered expressions, which are promoted as the formula keeps coming. A request reading a variable
+ * assigned earlier in the batch starts a new program, so every request sees
+ * the assignments sent before it.
+ * @param First item of the batch.
+ * @param Reader slot of the worker.
+ * @param Formula cache of the worker.
+ */
+static void mp_serve_evaluate(mp_serve_item* batch, size_t reader, mp_serve_cache* cache)
+{
+	// Count the requests
+	size_t len = 0;
+	for(mp_serve_item* it = batch; it != NULL; it = it->next) ++len;
+
+	mp_serve_segment seg;
+	seg.outs = malloc(sizeof(size_t) * (len + 1));
+	seg.exprs = malloc(sizeof(mp_tiered*) * (len + 1));
+	seg.errs = malloc(sizeof(char*) * (len + 1));
+	seg.targets = malloc(sizeof(size_t) * (len + 1));
+	mp_serve_segment_begin(&seg, batch, reader);
+
+	// Make room between batches, so expressions in use are never freed
+	if(cache->len >= MP_SERVER_MAX_FORMULAS) mp_serve_cache_prune(cache);
+
+	// Compile every request
+	for(mp_serve_item* it = batch; it != NULL; it = it->next)
+	{
+		if(it->too_long)
+		{
+			seg.outs[seg.len] = MP_PROGRAM_ERR;
+			seg.exprs[seg.len] = NULL;
+			seg.errs[seg.len] = mp_serve_format("error: line too long%s", "");
+			seg.targets[seg.len++] = MP_SYMBOL_ERR;
+			continue;
+		}
+
+		// Formulas seen before skip lexing and compilation
+		mp_serve_formula* f = mp_serve_cache_find(cache, it->line);
+		if(f->expr != NULL)
+		{
+			f->reused = 1;
+			if(mp_serve_segment_depends_expr(&seg, f->expr))
+			{
+				mp_serve_segment_end(&seg, reader);
+				mp_serve_segment_begin(&seg, it, reader);
+			}
+
+			const size_t i = seg.len++;
+			seg.outs[i] = MP_PROGRAM_ERR;
+			seg.exprs[i] = f->expr;
+			seg.errs[i] = NULL;
+			seg.targets[i] = f->target;
+
+			for(size_t j = 0; j < mp_tiered_var_count(f->expr) && seg.errs[i] == NULL; ++j)
+			{
+				double val;
+				const char* name = mp_tiered_var_name(f->expr, j);
+				if(!mp_snapshot_get(seg.snap, name, &val))
+					seg.errs[i] = mp_serve_format("error: unable to locate variable \"%s\"", name);
+			}
+			continue;
+		}
+
+		if(!mp_lex_string(it->line))
+		{
+			seg.outs[seg.len] = MP_PROGRAM_ERR;
+			seg.exprs[seg.len] = NULL;
+			seg.errs[seg.len] = mp_serve_format("error: unexpected token%s", "");
+			seg.targets[seg.len++] = MP_SYMBOL_ERR;
+			continue;
+		}
+
+		size_t token_len;
+		const token* tokens = mp_get_polish_tokens(&token_len);
+
+		// Assignments look like "x <expression> =" in polish notation
+		size_t target = MP_SYMBOL_ERR;
+		const char assign = token_len >= 3 && tokens[0].id == MP_TOKEN_VAR && tokens[token_len - 1].id == MP_TOKEN_EQL;
+		if(assign)
+		{
+			// Assigned names outlive the batch in the variable store, so they are interned
+			target = mp_intern(mp_symbol_name(tokens[0].index));
+			++tokens;
+			token_len -= 2;
+		}
+
+		// Requests depending on earlier assignments must see them
+		if(mp_serve_segment_depends(&seg, tokens, token_len))
+		{
+			mp_serve_segment_end(&seg, reader);
+			mp_serve_segment_begin(&seg, it, reader);
+		}
+
+		const size_t i = seg.len++;
+		seg.outs[i] = MP_PROGRAM_ERR;
+		seg.exprs[i] = NULL;
+		seg.errs[i] = NULL;
+		seg.targets[i] = target;
+
+		if(assign && target == MP_SYMBOL_ERR)
+			seg.errs[i] = mp_serve_format("error: too many variables%s", "");
+		for(size_t j = 0; j < token_len && seg.errs[i] == NULL; ++j)
+			if(tokens[j].id == MP_TOKEN_EQL)
+				seg.errs[i] = mp_serve_format("error: invalid assignment%s", "");
+
+		if(seg.errs[i] == NULL)
+		{
+			const size_t var_len = seg.prog->var_len;
+			seg.outs[i] = mp_program_add_tokens(seg.prog, tokens, token_len, mp_get_parser_literals());
+			if(seg.outs[i] == MP_PROGRAM_ERR)
+				seg.errs[i] = mp_serve_format("error: invalid expression%s", "");
+
+			// Only the free variables need values, variables bound by numeric builtins are slots of their bodies
+			for(size_t j = var_len; j < seg.prog->var_len && seg.errs[i] == NULL; ++j)
+			{
+				double val;
+				if(!mp_snapshot_get(seg.snap, seg.prog->vars[j], &val))
+					seg.errs[i] = mp_serve_format("error: unable to locate variable \"%s\"", seg.prog->vars[j]);
+			}
+
+			// The missing variable keeps its slot, so later requests go in a new program
+			if(seg.errs[i] != NULL && seg.prog->var_len != var_len)
+			{
+				mp_serve_segment_end(&seg, reader);
+				mp_serve_segment_begin(&seg, it->next, reader);
+			}
+		}
+
+		// Valid formulas are remembered for next time
+		if(seg.errs[i] == NULL && f->line == NULL && cache->len < MP_SERVER_MAX_FORMULAS && mp_serve_interned(tokens, token_len))
+		{
+			const size_t line_len = strlen(it->line);
+			f->line = malloc(line_len + 1);
+			memcpy(f->line, it->line, line_len + 1);
+			f->expr = mp_tiered_create_tokens(tokens, token_len, mp_get_parser_literals(), NULL);
+			f->target = target;
+			++cache->len;
+		}
+
+		mp_flush_parser_tokens();
+	}
+
+	mp_serve_segment_end(&seg, reader);
+	free(seg.outs);
+	free(seg.exprs);
+	free(seg.errs);
+	free(seg.targets);
+
+	// Names new to this batch were only needed to compile it
+	mp_clear_scratch_symbols();
+}
+
+/**
+ * Evaluation worker thread.
+ * @param Worker.
+ * @return NULL.
+ */
+static void* mp_serve_worker_main(void* arg)
+{
+	mp_serve_worker* w = arg;
+
+	// Every thread has its own token queue and reads variables through its own reader slot
+	mp_init_parser_tokens();
+	mp_set_lexer_quiet(1);
+
+	// Client names aren't interned, so clients can't fill the symbol table
+	mp_set_lexer_scratch(1);
+	const size_t reader = mp_store_register(mp_get_variable_store());
+
+	while(1)
+	{
+		// Take everything queued since the last batch
+		pthread_mutex_lock(&w->lock);
+		while(w->queue.head == NULL && !mp_server.stop)
+			pthread_cond_wait(&w->cond, &w->lock);
+		mp_serve_item* batch = w->queue.head;
+		mp_serve_item* tail = w->queue.tail;
+		w->queue.head = NULL;
+		w->queue.tail = NULL;
+		pthread_mutex_unlock(&w->lock);
+
+		// Nothing left and stopping
+		if(batch == NULL) break;
+
+		mp_serve_evaluate(batch, reader, &w->formulas);
+
+		// Hand the responses back to the event loop
+		pthread_mutex_lock(&mp_server.done_lock);
+		mp_serve_queue_append(&mp_server.done, batch, tail);
+		pthread_mutex_unlock(&mp_server.done_lock);
+
+		const uint64_t one = 1;
+		if(write(mp_server.event_fd, &one, sizeof(one)) < 0) {}
+	}
+
+	mp_serve_cache_clear(&w->formulas);
+	mp_store_unregister(mp_get_variable_store(), reader);
+	mp_free_parser_tokens();
+	return NULL;
+}
+
+/**
+ * Determine if a connection should be read from. Clients which stopped
+ * sending aren't, and neither are clients with too many requests or
+ * responses pending, until they read their responses. (Backpressure)
+ * @param Connection.
+ * @return 1 if it should, 0 otherwise.
+ */
+static char mp_serve_readable(const mp_serve_conn* c)
+{
+	return !c->eof && c->inflight < MP_SERVER_MAX_INFLIGHT && c->out_len - c->out_off < MP_SERVER_MAX_PENDING_OUT;
+}
+
+/**
+ * Register the events a connection waits for with the event loop, if they
+ * changed. A connection waiting for nothing leaves the event loop, so level
+ * triggered events (Including hang ups) don't wake it up again while its
+ * responses are evaluated.
+ * @param Connection file descriptor.
+ */
+static void mp_serve_watch(int fd)
+{
+	mp_serve_conn* c = &mp_server.conns[fd];
+
+	struct epoll_event ev;
+	ev.events = (mp_serve_readable(c) ? EPOLLIN : 0) | (c->want_write ? EPOLLOUT : 0);
+	ev.data.fd = fd;
+	if(ev.events == c->events) return;
+
+	if(ev.events == 0) epoll_ctl(mp_server.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	else epoll_ctl(mp_server.epoll_fd, c->events != 0 ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+	c->events = ev.events;
+}
+
+/**
+ * Close a connection.
+ * @param Connection file descriptor.
+ */
+static void mp_serve_close(int fd)
+{
+	mp_serve_conn* c = &mp_server.conns[fd];
+
+	epoll_ctl(mp_server.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	close(fd);
+
+	free(c->in);
+	free(c->out);
+	c->active = 0;
+	++c->gen;
+}
+
+/**
+ * Write as much pending output as the socket accepts.
+ * @param Connection file descriptor.
+ */
+static void mp_serve_flush(int fd)
+{
+	mp_serve_conn* c = &mp_server.conns[fd];
+
+	while(c->out_off < c->out_len)
+	{
+		const ssize_t n = send(fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+		if(n > 0)
+		{
+			c->out_off += (size_t)n;
+			continue;
+		}
+
+		// Wait until the socket is writable again
+		if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			c->want_write = 1;
+			mp_serve_watch(fd);
+			return;
+		}
+
+		if(n < 0 && errno == EINTR) continue;
+
+		// Client went away
+		mp_serve_close(fd);
+		return;
+	}
+
+	// Everything was written, so reading can resume
+	c->out_len = 0;
+	c->out_off = 0;
+	c->want_write = 0;
+	mp_serve_watch(fd);
+
+	// Close once the client is done and every response was sent
+	if(c->eof && c->inflight == 0) mp_serve_close(fd);
+}
+
+/**
+ * Queue a request line for evaluation.
+ * @param Connection file descriptor.
+ * @param Line, without its newline.
+ * @param Length of the line.
+ * @param Set if the line was too long to keep. (The line is then empty)
+ */
+static void mp_serve_request(int fd, const char* line, size_t len, char too_long)
+{
+	mp_serve_conn* c = &mp_server.conns[fd];
+
+	// Strip carriage returns and skip empty lines
+	if(len > 0 && line[len - 1] == '\r') --len;
+	if(len == 0 && !too_long) return;
+
+	mp_serve_item* it = malloc(sizeof(mp_serve_item));
+	it->fd = fd;
+	it->gen = c->gen;
+	it->next = NULL;
+	it->too_long = too_long;
+	it->line = malloc(len + 1);
+	memcpy(it->line, line, len);
+	it->line[len] = '\0';
+
+	// Every request of a connection goes to the same worker, which keeps them in order
+	mp_serve_worker* w = &mp_server.workers[(size_t)fd % mp_server.worker_len];
+	mp_serve_queue_append(&w->pending, it, it);
+	++c->inflight;
+}
+
+/**
+ * Read requests from a connection and queue them for evaluation.
+ * @param Connection file descriptor.
+ */
+static void mp_serve_read(int fd)
+{
+	mp_serve_conn* c = &mp_server.conns[fd];
+
+	// Read what is available, without buffering more than the longest line
+	while(mp_serve_readable(c) && c->in_len < MP_SERVER_MAX_LINE)
+	{
+		if(c->in_cap - c->in_len < MP_SERVER_READ_SIZE)
+		{
+			c->in_cap += MP_SERVER_READ_SIZE;
+			c->in = realloc(c->in, c->in_cap);
+		}
+
+		const ssize_t n = recv(fd, c->in + c->in_len, c->in_cap - c->in_len, 0);
+		if(n > 0) c->in_len += (size_t)n;
+		else if(n == 0) c->eof = 1;
+		else if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+		else if(errno != EINTR)
+		{
+			mp_serve_close(fd);
+			return;
+		}
+	}
+
+	// Split complete lines into requests, skipping the end of a line which was too long
+	size_t start = 0;
+	for(size_t i = 0; i < c->in_len; ++i)
+	{
+		if(c->in[i] != '\n') continue;
+
+		if(!c->discard) mp_serve_request(fd, c->in + start, i - start, 0);
+		c->discard = 0;
+		start = i + 1;
+	}
+
+	// Keep the partial line
+	memmove(c->in, c->in + start, c->in_len - start);
+	c->in_len -= start;
+
+	// A partial line as long as the longest line is answered with an error right away
+	if(c->in_len >= MP_SERVER_MAX_LINE)
+	{
+		if(!c->discard) mp_serve_request(fd, "", 0, 1);
+		c->discard = 1;
+		c->in_len = 0;
+	}
+
+	// The last request doesn't need a newline
+	if(c->eof)
+	{
+		if(!c->discard) mp_serve_request(fd, c->in, c->in_len, 0);
+		c->in_len = 0;
+	}
+
+	// Stop reading once the client is done, or has too much pending
+	mp_serve_watch(fd);
+
+	if(c->eof && c->inflight == 0 && c->out_off == c->out_len) mp_serve_close(fd);
+}
+
+/**
+ * Accept every pending connection.
+ */
+static void mp_serve_accept()
+{
+	while(1)
+	{
+		const int fd = accept(mp_server.listen_fd, NULL, NULL);
+		if(fd < 0) return;
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		// Grow the connection table to fit the descriptor
+		if((size_t)fd >= mp_server.conn_cap)
+		{
+			const size_t cap = (size_t)fd * 2 + 1;
+			mp_server.conns = realloc(mp_server.conns, sizeof(mp_serve_conn) * cap);
+			memset(&mp_server.conns[mp_server.conn_cap], 0, sizeof(mp_serve_conn) * (cap - mp_server.conn_cap));
+			mp_server.conn_cap = cap;
+		}
+
+		// Reset the connection, keeping its generation
+		mp_serve_conn* c = &mp_server.conns[fd];
+		const unsigned gen = c->gen;
+		memset(c, 0, sizeof(mp_serve_conn));
+		c->gen = gen;
+		c->active = 1;
+		mp_serve_watch(fd);
+	}
+}
+
+/**
+ * Send every evaluated response back to its connection.
+ */
+static void mp_serve_deliver()
+{
+	// Reset the event counter
+	uint64_t count;
+	if(read(mp_server.event_fd, &count, sizeof(count)) < 0) {}
+
+	// Take every evaluated item
+	pthread_mutex_lock(&mp_server.done_lock);
+	mp_serve_item* it = mp_server.done.head;
+	mp_server.done.head = NULL;
+	mp_server.done.tail = NULL;
+	pthread_mutex_unlock(&mp_server.done_lock);
+
+	// Connections which received responses
+	int* dirty = NULL;
+	size_t dirty_len = 0;
+
+	while(it != NULL)
+	{
+		mp_serve_item* next = it->next;
+		mp_serve_conn* c = &mp_server.conns[it->fd];
+
+		// Drop responses for connections which were closed
+		if(c->active && c->gen == it->gen)
+		{
+			// Append the response
+			const size_t len = strlen(it->line);
+			if(c->out_cap < c->out_len + len + 1)
+			{
+				c->out_cap = (c->out_len + len + 1) * 2;
+				c->out = realloc(c->out, c->out_cap);
+			}
+			memcpy(c->out + c->out_len, it->line, len);
+			c->out[c->out_len + len] = '\n';
+			c->out_len += len + 1;
+			--c->inflight;
+
+			// Write once every response has been appended
+			if(!c->dirty)
+			{
+				dirty = realloc(dirty, sizeof(int) * (dirty_len + 1));
+				dirty[dirty_len++] = it->fd;
+				c->dirty = 1;
+			}
+		}
+
+		free(it->line);
+		free(it);
+		it = next;
+	}
+
+	for(size_t i = 0; i < dirty_len; ++i)
+	{
+		mp_server.conns[dirty[i]].dirty = 0;
+		mp_serve_flush(dirty[i]);
+	}
+
+	free(dirty);
+}
+
+/**
+ * Open the listening socket.
+ * @param Address. (See mp_serve)
+ * @return Socket, or -1 on failure.
+ */
+static int mp_serve_listen(const char* address)
+{
+	// Port numbers are all digits
+	char is_port = address[0] != '\0';
+	for(const char* p = address; *p != '\0'; ++p)
+		if(*p < '0' || *p > '9') is_port = 0;
+
+	int fd;
+	if(is_port)
+	{
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons((uint16_t)atoi(address));
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		const int yes = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		if(fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		{
+			close(fd);
+			return -1;
+		}
+	}
+	else
+	{
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if(strlen(address) >= sizeof(addr.sun_path)) return -1;
+		strcpy(addr.sun_path, address);
+
+		// Remove a stale socket file
+		unlink(address);
+		mp_server.unix_path = address;
+
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		{
+			close(fd);
+			return -1;
+		}
+	}
+
+	if(fd >= 0 && listen(fd, SOMAXCONN) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * Signal handler stopping the server.
+ * @param Signal.
+ */
+static void mp_serve_signal(int sig)
+{
+	(void)sig;
+	mp_stop_server();
+}
+
+int mp_serve(const char* address, size_t workers)
+{
+	if(address == NULL) address = MP_SERVER_DEFAULT_PORT;
+
+	// Open the listening socket
+	mp_server.unix_path = NULL;
+	mp_server.listen_fd = mp_serve_listen(address);
+	if(mp_server.listen_fd < 0)
+	{
+		printf("Unable to listen on \"%s\"\n", address);
+		return 1;
+	}
+
+	// Set up the event loop
+	mp_server.stop = 0;
+	mp_server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	mp_server.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	mp_server.conns = NULL;
+	mp_server.conn_cap = 0;
+	mp_server.done.head = NULL;
+	mp_server.done.tail = NULL;
+	pthread_mutex_init(&mp_server.done_lock, NULL);
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = mp_server.listen_fd;
+	epoll_ctl(mp_server.epoll_fd, EPOLL_CTL_ADD, mp_server.listen_fd, &ev);
+	ev.data.fd = mp_server.event_fd;
+	epoll_ctl(mp_server.epoll_fd, EPOLL_CTL_ADD, mp_server.event_fd, &ev);
+
+	// Start the workers
+	if(workers == 0)
+	{
+		const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		workers = cores > 0 ? (size_t)cores : 1;
+	}
+	if(workers > MP_STORE_MAX_READERS / 2) workers = MP_STORE_MAX_READERS / 2;
+	mp_server.worker_len = workers;
+	mp_server.workers = calloc(workers, sizeof(mp_serve_worker));
+	for(size_t i = 0; i < workers; ++i)
+	{
+		pthread_mutex_init(&mp_server.workers[i].lock, NULL);
+		pthread_cond_init(&mp_server.workers[i].cond, NULL);
+		pthread_create(&mp_server.workers[i].thread, NULL, mp_serve_worker_main, &mp_server.workers[i]);
+	}
+
+	// Stop cleanly when interrupted
+	mp_server.running = 1;
+	signal(SIGINT, mp_serve_signal);
+	signal(SIGTERM, mp_serve_signal);
+
+	printf("Listening on %s with %zu workers\n", address, workers);
+	fflush(stdout);
+
+	// Event loop
+	struct epoll_event events[MP_SERVER_MAX_EVENTS];
+	while(!mp_server.stop)
+	{
+		const int n = epoll_wait(mp_server.epoll_fd, events, MP_SERVER_MAX_EVENTS, -1);
+		if(n < 0 && errno != EINTR) break;
+
+		for(int i = 0; i < n; ++i)
+		{
+			const int fd = events[i].data.fd;
+
+			if(fd == mp_server.listen_fd) mp_serve_accept();
+			else if(fd == mp_server.event_fd) mp_serve_deliver();
+			else
+			{
+				if(mp_server.conns[fd].active && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+					mp_serve_read(fd);
+				if(mp_server.conns[fd].active && (events[i].events & EPOLLOUT))
+					mp_serve_flush(fd);
+			}
+		}
+
+		// Hand every request read this iteration to the workers in one batch each
+		for(size_t i = 0; i < workers; ++i)
+		{
+			mp_serve_worker* w = &mp_server.workers[i];
+			if(w->pending.head == NULL) continue;
+
+			pthread_mutex_lock(&w->lock);
+			mp_serve_queue_append(&w->queue, w->pending.head, w->pending.tail);
+			pthread_cond_signal(&w->cond);
+			pthread_mutex_unlock(&w->lock);
+
+			w->pending.head = NULL;
+			w->pending.tail = NULL;
+		}
+	}
+
+	// Stop the workers
+	mp_server.running = 0;
+	mp_server.stop = 1;
+	for(size_t i = 0; i < workers; ++i)
+	{
+		pthread_mutex_lock(&mp_server.workers[i].lock);
+		pthread_cond_broadcast(&mp_server.workers[i].cond);
+		pthread_mutex_unlock(&mp_server.workers[i].lock);
+	}
+	for(size_t i = 0; i < workers; ++i)
+	{
+		pthread_join(mp_server.workers[i].thread, NULL);
+		pthread_mutex_destroy(&mp_server.workers[i].lock);
+		pthread_cond_destroy(&mp_server.workers[i].cond);
+	}
+
+	// Free undelivered responses
+	while(mp_server.done.head != NULL)
+	{
+		mp_serve_item* next = mp_server.done.head->next;
+		free(mp_server.done.head->line);
+		free(mp_server.done.head);
+		mp_server.done.head = next;
+	}
+
+	// Close every connection
+	for(size_t i = 0; i < mp_server.conn_cap; ++i)
+		if(mp_server.conns[i].active)
+			mp_serve_close((int)i);
+
+	close(mp_server.listen_fd);
+	close(mp_server.event_fd);
+	if(mp_server.unix_path != NULL) unlink(mp_server.unix_path);
+	close(mp_server.epoll_fd);
+	pthread_mutex_destroy(&mp_server.done_lock);
+	free(mp_server.workers);
+	free(mp_server.conns);
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	return 0;
+}
+
+void mp_stop_server()
+{
+	if(!mp_server.running) return;
+
+	// Wake the event loop
+	mp_server.stop = 1;
+	const uint64_t one = 1;
+	if(write(mp_server.event_fd, &one, sizeof(one)) < 0) {}
+}
+
+#else
+
+int mp_serve(const char* address, size_t workers)
+{
+	(void)address;
+	(void)workers;
+	printf("Server mode requires Linux\n");
+	return 1;
+}
+
+void mp_stop_server()
+{
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef MP_SERVER_H
+#define MP_SERVER_H
+
+/**
+ * Local evaluation server. Clients send newline separated expressions
+ * and receive one newline terminated result per expression, in the
+ * order the expressions were sent. Requests may be pipelined, and the
+ * last one doesn't need a newline. Overly long lines are answered with
+ * an error instead of being buffered, and a client with too many requests
+ * or unread responses pending isn't read from until it catches up.
+ * Formulas a worker has seen before skip compilation and run from cached
+ * tiered expressions, which are promoted as they keep coming. (See tiered.h)
+ * Assignments (x = expression) respond with the assigned value and are
+ * shared with every connection. Requests read variables from a snapshot,
+ * so they never see a partially applied batch of assignments.
+ */
+
+/** Includes. */
+#include "stddef.h"
+
+/** Port used when no address is given. */
+#define MP_SERVER_DEFAULT_PORT "7979"
+
+/**
+ * Run the evaluation server until it is stopped.
+ * @param Address to listen on. A port number listens on localhost TCP,
+ * anything else is the path of a Unix domain socket. NULL uses MP_SERVER_DEFAULT_PORT.
+ * @param Number of evaluation worker threads, or 0 for one per core.
+ * @return Process exit code.
+ * @note Requires Linux (epoll). The parser must be initialized.
+ */
+extern int mp_serve(const char* address, size_t workers);
+
+/**
+ * Stop a running server. Safe to call from any thread or signal handler.
+ */
+extern void mp_stop_server();
+#endif
\ No newline at end of file
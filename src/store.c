@@ -0,0 +1,409 @@
+/** Includes. */
+#include "string.h"
+#include "stdlib.h"
+#include "stdint.h"
+#include "stdatomic.h"
+#include "store.h"
+
+/** Number of hash bits each level of a snapshot's trie consumes. */
+#define MP_STORE_NODE_BITS 4
+
+/** Number of children of an inner node. */
+#define MP_STORE_NODE_WIDTH (1 << MP_STORE_NODE_BITS)
+
+/**
+ * Node of a snapshot's hash trie. Publishing copies the path to every
+ * updated variable and shares every other node with the previous snapshot,
+ * so nodes are reference counted. (Only by writers, readers never touch counts)
+ */
+typedef struct mp_store_node
+{
+	/** Number of snapshots and nodes pointing at the node. */
+	size_t refs;
+
+	/** Variable name (Not owned), or NULL for an inner node. */
+	const char* name;
+
+	/** Hash of the name. */
+	uint64_t hash;
+
+	/** Variable value. */
+	double val;
+
+	/** Next variable with the same hash. (Leaves only) */
+	struct mp_store_node* next;
+
+	/** Children, indexed by the next bits of the hash. (Inner nodes only) */
+	struct mp_store_node* children[];
+
+} mp_store_node;
+
+// Immutable set of variables
+struct mp_snapshot
+{
+	/** Version, incremented on every publish. */
+	size_t version;
+
+	/** Root of the hash trie, or NULL if there are no variables. */
+	mp_store_node* root;
+
+	/** Number of variables. */
+	size_t len;
+
+	/** Epoch the snapshot was replaced in. */
+	size_t retired;
+
+	/** Next replaced snapshot waiting to be freed. */
+	struct mp_snapshot* next;
+};
+
+// Reader slot, kept on its own cache line
+typedef struct
+{
+	/** Epoch the reader entered in, or 0 if it doesn't hold a snapshot. */
+	_Alignas(64) _Atomic size_t epoch;
+
+	/** Set while the slot is registered. */
+	atomic_flag used;
+
+} mp_store_reader;
+
+// Variable store
+struct mp_store
+{
+	/** Current snapshot. */
+	_Atomic(mp_snapshot*) current;
+
+	/** Global epoch, incremented on every publish. Starts at 1. */
+	_Atomic size_t epoch;
+
+	/** Held by the writer currently publishing. */
+	atomic_flag lock;
+
+	/** Replaced snapshots readers might still use. (Only touched by writers) */
+	mp_snapshot* retired;
+
+	/** Reader slots. */
+	mp_store_reader readers[MP_STORE_MAX_READERS];
+};
+
+/**
+ * Hash a variable name.
+ * @param Variable name.
+ * @return Hash.
+ */
+static uint64_t mp_store_hash(const char* name)
+{
+	uint64_t h = 14695981039346656037ull;
+	for(; *name != '\0'; ++name)
+	{
+		h ^= (unsigned char)*name;
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+/**
+ * Create a leaf.
+ * @param Variable name.
+ * @param Hash of the name.
+ * @param Value.
+ * @param Next variable with the same hash, or NULL. (Gains a reference)
+ * @return New leaf without references.
+ */
+static mp_store_node* mp_store_leaf(const char* name, uint64_t hash, double val, mp_store_node* next)
+{
+	mp_store_node* leaf = malloc(sizeof(mp_store_node));
+	leaf->refs = 0;
+	leaf->name = name;
+	leaf->hash = hash;
+	leaf->val = val;
+	leaf->next = next;
+	if(next != NULL) ++next->refs;
+	return leaf;
+}
+
+/**
+ * Create an inner node.
+ * @param Node to copy the children of (Which gain a reference), or NULL for none.
+ * @return New inner node without references.
+ */
+static mp_store_node* mp_store_inner(const mp_store_node* from)
+{
+	mp_store_node* node = malloc(sizeof(mp_store_node) + sizeof(mp_store_node*) * MP_STORE_NODE_WIDTH);
+	node->refs = 0;
+	node->name = NULL;
+	node->next = NULL;
+	for(size_t i = 0; i < MP_STORE_NODE_WIDTH; ++i)
+	{
+		node->children[i] = from != NULL ? from->children[i] : NULL;
+		if(node->children[i] != NULL) ++node->children[i]->refs;
+	}
+	return node;
+}
+
+/**
+ * Drop a reference to a node, freeing it and dropping its own references
+ * once nothing points at it.
+ * @param Node, or NULL.
+ */
+static void mp_store_unref(mp_store_node* node)
+{
+	if(node == NULL || --node->refs != 0) return;
+
+	if(node->name != NULL) mp_store_unref(node->next);
+	else
+	{
+		for(size_t i = 0; i < MP_STORE_NODE_WIDTH; ++i)
+			mp_store_unref(node->children[i]);
+	}
+	free(node);
+}
+
+/**
+ * Set or remove a variable, copying the nodes on the path to it.
+ * @param Trie, or NULL if empty. (Left unchanged)
+ * @param Number of hash bits consumed above the trie.
+ * @param Variable name. (Must outlive the store)
+ * @param Hash of the name.
+ * @param Value.
+ * @param Non-zero to remove the variable instead.
+ * @param Number of variables, updated.
+ * @return New trie without references, NULL if it's empty.
+ */
+static mp_store_node* mp_store_set(
+	mp_store_node* node, 
+	size_t shift, 
+	const char* name, 
+	uint64_t hash, 
+	double val, 
+	char remove, 
+	size_t* len
+)
+{
+	if(node == NULL)
+	{
+		if(remove) return NULL;
+		++*len;
+		return mp_store_leaf(name, hash, val, NULL);
+	}
+
+	// Variables with the same hash share a list, which is copied whole
+	if(node->name != NULL && node->hash == hash)
+	{
+		mp_store_node* list = remove ? NULL : mp_store_leaf(name, hash, val, NULL);
+		char found = 0;
+		for(const mp_store_node* it = node; it != NULL; it = it->next)
+		{
+			if(strcmp(it->name, name) == 0) found = 1;
+			else list = mp_store_leaf(it->name, it->hash, it->val, list);
+		}
+		if(!found && !remove) ++*len;
+		if(found && remove) --*len;
+		return list;
+	}
+
+	// A leaf in the way of a different hash moves one level down
+	if(node->name != NULL)
+	{
+		if(remove) return node;
+
+		mp_store_node* inner = mp_store_inner(NULL);
+		inner->children[(node->hash >> shift) & (MP_STORE_NODE_WIDTH - 1)] = node;
+		++node->refs;
+		inner->refs = 1;
+
+		mp_store_node* res = mp_store_set(inner, shift, name, hash, val, remove, len);
+		mp_store_unref(inner);
+		return res;
+	}
+
+	// Replace the child the variable belongs to
+	const size_t i = (hash >> shift) & (MP_STORE_NODE_WIDTH - 1);
+	mp_store_node* child = mp_store_set(node->children[i], shift + MP_STORE_NODE_BITS, name, hash, val, remove, len);
+	if(child == node->children[i]) return node;
+
+	mp_store_node* copy = mp_store_inner(node);
+	mp_store_unref(copy->children[i]);
+	copy->children[i] = child;
+	if(child != NULL) ++child->refs;
+
+	// Leave empty nodes out
+	for(size_t j = 0; j < MP_STORE_NODE_WIDTH; ++j)
+		if(copy->children[j] != NULL)
+			return copy;
+
+	free(copy);
+	return NULL;
+}
+
+/**
+ * Create an empty snapshot.
+ * @return New snapshot.
+ */
+static mp_snapshot* mp_snapshot_create()
+{
+	return calloc(1, sizeof(mp_snapshot));
+}
+
+/**
+ * Free a snapshot, along with the nodes no other snapshot shares.
+ * @param Snapshot.
+ */
+static void mp_snapshot_destroy(mp_snapshot* snap)
+{
+	mp_store_unref(snap->root);
+	free(snap);
+}
+
+mp_store* mp_store_create()
+{
+	mp_store* store = calloc(1, sizeof(mp_store));
+	atomic_init(&store->current, mp_snapshot_create());
+	atomic_init(&store->epoch, 1);
+	atomic_flag_clear(&store->lock);
+	for(size_t i = 0; i < MP_STORE_MAX_READERS; ++i)
+	{
+		atomic_init(&store->readers[i].epoch, 0);
+		atomic_flag_clear(&store->readers[i].used);
+	}
+	return store;
+}
+
+void mp_store_destroy(mp_store* store)
+{
+	while(store->retired != NULL)
+	{
+		mp_snapshot* next = store->retired->next;
+		mp_snapshot_destroy(store->retired);
+		store->retired = next;
+	}
+
+	mp_snapshot_destroy(atomic_load(&store->current));
+	free(store);
+}
+
+size_t mp_store_register(mp_store* store)
+{
+	for(size_t i = 0; i < MP_STORE_MAX_READERS; ++i)
+		if(!atomic_flag_test_and_set(&store->readers[i].used))
+			return i;
+
+	return MP_STORE_ERR;
+}
+
+void mp_store_unregister(mp_store* store, size_t reader)
+{
+	atomic_store(&store->readers[reader].epoch, 0);
+	atomic_flag_clear(&store->readers[reader].used);
+}
+
+const mp_snapshot* mp_store_acquire(mp_store* store, size_t reader)
+{
+	// Announce the epoch before loading the snapshot, so a writer replacing
+	// the snapshot afterwards knows it can't be freed yet
+	atomic_store(&store->readers[reader].epoch, atomic_load(&store->epoch));
+	return atomic_load(&store->current);
+}
+
+void mp_store_release(mp_store* store, size_t reader)
+{
+	atomic_store_explicit(&store->readers[reader].epoch, 0, memory_order_release);
+}
+
+/**
+ * Replace the current snapshot and free replaced snapshots no reader can still use.
+ * @param Store. (Must be locked)
+ * @param New snapshot.
+ */
+static void mp_store_replace(mp_store* store, mp_snapshot* snap)
+{
+	mp_snapshot* old = atomic_exchange(&store->current, snap);
+	old->retired = atomic_fetch_add(&store->epoch, 1);
+	old->next = store->retired;
+	store->retired = old;
+
+	// Oldest epoch a reader is still in
+	size_t oldest = SIZE_MAX;
+	for(size_t i = 0; i < MP_STORE_MAX_READERS; ++i)
+	{
+		const size_t epoch = atomic_load(&store->readers[i].epoch);
+		if(epoch != 0 && epoch < oldest) oldest = epoch;
+	}
+
+	// Readers which entered after a snapshot was replaced can't see it
+	mp_snapshot** it = &store->retired;
+	while(*it != NULL)
+	{
+		if((*it)->retired < oldest)
+		{
+			mp_snapshot* freed = *it;
+			*it = freed->next;
+			mp_snapshot_destroy(freed);
+		}
+		else it = &(*it)->next;
+	}
+}
+
+void mp_store_publish(mp_store* store, const mp_store_update* updates, size_t len)
+{
+	while(atomic_flag_test_and_set_explicit(&store->lock, memory_order_acquire)) {}
+
+	const mp_snapshot* old = atomic_load(&store->current);
+	mp_snapshot* snap = mp_snapshot_create();
+	snap->version = old->version + 1;
+	snap->len = old->len;
+
+	// Apply the updates on top of the current trie, which stays untouched
+	snap->root = old->root;
+	if(snap->root != NULL) ++snap->root->refs;
+	for(size_t i = 0; i < len; ++i)
+	{
+		const mp_store_update* u = &updates[i];
+		mp_store_node* root = mp_store_set(snap->root, 0, u->name, mp_store_hash(u->name), u->val, u->remove, &snap->len);
+		if(root == snap->root) continue;
+
+		if(root != NULL) ++root->refs;
+		mp_store_unref(snap->root);
+		snap->root = root;
+	}
+
+	mp_store_replace(store, snap);
+	atomic_flag_clear_explicit(&store->lock, memory_order_release);
+}
+
+void mp_store_clear(mp_store* store)
+{
+	while(atomic_flag_test_and_set_explicit(&store->lock, memory_order_acquire)) {}
+
+	mp_snapshot* snap = mp_snapshot_create();
+	snap->version = atomic_load(&store->current)->version + 1;
+	mp_store_replace(store, snap);
+
+	atomic_flag_clear_explicit(&store->lock, memory_order_release);
+}
+
+char mp_snapshot_get(const mp_snapshot* snap, const char* name, double* val)
+{
+	const uint64_t hash = mp_store_hash(name);
+
+	// Walk down to the leaf the hash leads to
+	const mp_store_node* node = snap->root;
+	for(size_t shift = 0; node != NULL && node->name == NULL; shift += MP_STORE_NODE_BITS)
+		node = node->children[(hash >> shift) & (MP_STORE_NODE_WIDTH - 1)];
+
+	for(; node != NULL; node = node->next)
+	{
+		if(node->hash == hash && strcmp(node->name, name) == 0)
+		{
+			*val = node->val;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+size_t mp_snapshot_version(const mp_snapshot* snap)
+{
+	return snap->version;
+}
@@ -0,0 +1,117 @@
+#ifndef MP_STORE_H
+#define MP_STORE_H
+
+/**
+ * Concurrent variable store. Readers take a consistent snapshot of every
+ * variable without locking or blocking, while writers publish batches of
+ * updates which become visible all at once. Snapshots are immutable hash
+ * tries replaced on every publish, which copies only the paths to the
+ * updated variables and shares the rest with the previous snapshot; a
+ * replaced snapshot is freed once no reader can still be using it. (Epoch
+ * based reclamation)
+ */
+
+/** Includes. */
+#include "stddef.h"
+
+/** Value returned when no reader slot is available. */
+#define MP_STORE_ERR ((size_t)-1)
+
+/** Maximum number of readers registered with a store at once. */
+#define MP_STORE_MAX_READERS 256
+
+// Variable update
+typedef struct
+{
+	/** Variable name. (Not copied, so it must outlive the store, like interned symbol names) */
+	const char* name;
+
+	/** New value. */
+	double val;
+
+	/** Non-zero to remove the variable instead. */
+	char remove;
+
+} mp_store_update;
+
+// Variable store
+typedef struct mp_store mp_store;
+
+// Immutable set of variables
+typedef struct mp_snapshot mp_snapshot;
+
+/**
+ * Create an empty variable store.
+ * @return New store.
+ * @note Must be destroyed with mp_store_destroy.
+ */
+extern mp_store* mp_store_create();
+
+/**
+ * Destroy a variable store.
+ * @param Store.
+ * @note No reader may be using the store.
+ */
+extern void mp_store_destroy(mp_store* store);
+
+/**
+ * Register a reader. Every thread reading the store needs its own reader slot.
+ * @param Store.
+ * @return Reader slot, or MP_STORE_ERR if every slot is taken.
+ */
+extern size_t mp_store_register(mp_store* store);
+
+/**
+ * Unregister a reader.
+ * @param Store.
+ * @param Reader slot.
+ */
+extern void mp_store_unregister(mp_store* store, size_t reader);
+
+/**
+ * Take a snapshot of the current variables. Never blocks.
+ * @param Store.
+ * @param Reader slot.
+ * @return Snapshot, valid until mp_store_release is called for the slot.
+ * @note A reader can only hold one snapshot at a time.
+ */
+extern const mp_snapshot* mp_store_acquire(mp_store* store, size_t reader);
+
+/**
+ * Release the snapshot held by a reader.
+ * @param Store.
+ * @param Reader slot.
+ */
+extern void mp_store_release(mp_store* store, size_t reader);
+
+/**
+ * Atomically apply a batch of updates. Updates later in the batch win.
+ * @param Store.
+ * @param Updates.
+ * @param Number of updates.
+ * @note Writers are serialized with each other, but never wait for readers.
+ */
+extern void mp_store_publish(mp_store* store, const mp_store_update* updates, size_t len);
+
+/**
+ * Atomically remove every variable.
+ * @param Store.
+ */
+extern void mp_store_clear(mp_store* store);
+
+/**
+ * Get the value of a variable in a snapshot.
+ * @param Snapshot.
+ * @param Variable name.
+ * @param Pointer to write the value to.
+ * @return 1 if the variable exists, 0 otherwise.
+ */
+extern char mp_snapshot_get(const mp_snapshot* snap, const char* name, double* val);
+
+/**
+ * Get the version of a snapshot. Every publish increments the version.
+ * @param Snapshot.
+ * @return Version.
+ */
+extern size_t mp_snapshot_version(const mp_snapshot* snap);
+#endif
@@ -0,0 +1,288 @@
+/** Includes. */
+#include "string.h"
+#include "stdlib.h"
+#include "stdint.h"
+#include "stdatomic.h"
+#include "symbols.h"
+
+/** Number of names per page of the name directory. */
+#define MP_SYMBOL_PAGE_SIZE 1024
+
+/** Initial size of the hash table. */
+#define MP_SYMBOL_TABLE_INIT_SIZE 256
+
+/** Initial size of a thread's scratch hash table. */
+#define MP_SCRATCH_TABLE_INIT_SIZE 64
+
+// Hash table mapping names to symbol ids
+typedef struct mp_symbol_table
+{
+	/** Size. (Always a power of two) */
+	size_t len;
+
+	/** Symbol id of every entry. (Id + 1, 0 is empty) Stored after the hash and name. */
+	_Atomic size_t* ids;
+
+	/** Hash of every entry. */
+	size_t* hashes;
+
+	/** Table this one replaced, kept since lookups may still be reading it. */
+	struct mp_symbol_table* prev;
+
+} mp_symbol_table;
+
+/**
+ * Symbol table state. Names live in fixed pages which never move, so
+ * mp_symbol_name can read them without locking. Lookups read the hash
+ * table without locking too; a grown table replaces the old one, which
+ * stays readable. Only interning new names takes the lock.
+ */
+static struct
+{
+	/** Pages of names, indexed by symbol id / MP_SYMBOL_PAGE_SIZE. */
+	const char** pages[MP_SYMBOL_MAX / MP_SYMBOL_PAGE_SIZE];
+
+	/** Number of symbols. */
+	_Atomic size_t len;
+
+	/** Current hash table, or NULL before the first name is interned. */
+	_Atomic(mp_symbol_table*) table;
+
+	/** Held while names are added. */
+	atomic_flag lock;
+
+} mp_symbols = { .lock = ATOMIC_FLAG_INIT };
+
+/** Scratch symbols of the calling thread. (See mp_scratch_symbol) */
+static _Thread_local struct
+{
+	/** Names, indexed by symbol id - MP_SYMBOL_MAX. */
+	char** names;
+
+	/** Number of names. */
+	size_t len;
+
+	/** Number of names allocated. */
+	size_t allocated;
+
+	/** Hash table mapping names to indices. (Index + 1, 0 is empty) */
+	size_t* table;
+
+	/** Size of the hash table. (Always a power of two) */
+	size_t table_len;
+
+} mp_scratch;
+
+/**
+ * Hash a name.
+ * @param Name.
+ * @param Length of the name.
+ * @return Hash.
+ */
+static size_t mp_symbol_hash(const char* name, size_t len)
+{
+	uint64_t h = 14695981039346656037ull;
+	for(size_t i = 0; i < len; ++i)
+	{
+		h ^= (unsigned char)name[i];
+		h *= 1099511628211ull;
+	}
+	return (size_t)h;
+}
+
+/**
+ * Find the table entry of a name, or the empty entry it would go in.
+ * @param Table.
+ * @param Name.
+ * @param Length of the name.
+ * @param Hash of the name.
+ * @return Table index.
+ */
+static size_t mp_symbol_lookup(const mp_symbol_table* table, const char* name, size_t len, size_t hash)
+{
+	const size_t mask = table->len - 1;
+	for(size_t i = hash & mask;; i = (i + 1) & mask)
+	{
+		const size_t entry = atomic_load_explicit(&table->ids[i], memory_order_acquire);
+		if(entry == 0) return i;
+
+		if(table->hashes[i] == hash)
+		{
+			const char* other = mp_symbol_name(entry - 1);
+			if(strncmp(other, name, len) == 0 && other[len] == '\0') return i;
+		}
+	}
+}
+
+/**
+ * Replace the hash table with one twice the size.
+ * @note The lock must be held.
+ */
+static void mp_symbol_grow()
+{
+	mp_symbol_table* old = atomic_load_explicit(&mp_symbols.table, memory_order_relaxed);
+
+	mp_symbol_table* table = malloc(sizeof(mp_symbol_table));
+	table->len = old == NULL ? MP_SYMBOL_TABLE_INIT_SIZE : old->len * 2;
+	table->ids = calloc(table->len, sizeof(size_t));
+	table->hashes = calloc(table->len, sizeof(size_t));
+	table->prev = old;
+
+	const size_t mask = table->len - 1;
+	for(size_t i = 0; old != NULL && i < old->len; ++i)
+	{
+		const size_t entry = atomic_load_explicit(&old->ids[i], memory_order_relaxed);
+		if(entry == 0) continue;
+
+		size_t j = old->hashes[i] & mask;
+		while(atomic_load_explicit(&table->ids[j], memory_order_relaxed) != 0) j = (j + 1) & mask;
+		table->hashes[j] = old->hashes[i];
+		atomic_store_explicit(&table->ids[j], entry, memory_order_relaxed);
+	}
+
+	// Publish the filled table
+	atomic_store_explicit(&mp_symbols.table, table, memory_order_release);
+}
+
+/**
+ * Find the symbol of a name without locking.
+ * @param Name.
+ * @param Length of the name.
+ * @param Hash of the name.
+ * @return Symbol id, or MP_SYMBOL_ERR if the name isn't interned.
+ */
+static size_t mp_symbol_find(const char* name, size_t len, size_t hash)
+{
+	const mp_symbol_table* table = atomic_load_explicit(&mp_symbols.table, memory_order_acquire);
+	if(table == NULL) return MP_SYMBOL_ERR;
+
+	const size_t entry = atomic_load_explicit(&table->ids[mp_symbol_lookup(table, name, len, hash)], memory_order_acquire);
+	return entry != 0 ? entry - 1 : MP_SYMBOL_ERR;
+}
+
+size_t mp_intern(const char* name)
+{
+	return mp_intern_len(name, strlen(name));
+}
+
+size_t mp_intern_len(const char* name, size_t len)
+{
+	const size_t hash = mp_symbol_hash(name, len);
+
+	// Names which already exist don't need the lock
+	size_t sym = mp_symbol_find(name, len, hash);
+	if(sym != MP_SYMBOL_ERR) return sym;
+
+	while(atomic_flag_test_and_set_explicit(&mp_symbols.lock, memory_order_acquire)) {}
+
+	// Keep the table at most half full
+	const size_t count = atomic_load_explicit(&mp_symbols.len, memory_order_relaxed);
+	mp_symbol_table* table = atomic_load_explicit(&mp_symbols.table, memory_order_relaxed);
+	if(table == NULL || count * 2 >= table->len)
+	{
+		mp_symbol_grow();
+		table = atomic_load_explicit(&mp_symbols.table, memory_order_relaxed);
+	}
+
+	// Another thread may have added the name since the lookup
+	const size_t i = mp_symbol_lookup(table, name, len, hash);
+	const size_t entry = atomic_load_explicit(&table->ids[i], memory_order_relaxed);
+	if(entry != 0) sym = entry - 1;
+	else if(count < MP_SYMBOL_MAX)
+	{
+		// Copy the name into a new symbol
+		char* copy = malloc(len + 1);
+		memcpy(copy, name, len);
+		copy[len] = '\0';
+
+		const char*** page = &mp_symbols.pages[count / MP_SYMBOL_PAGE_SIZE];
+		if(*page == NULL) *page = malloc(sizeof(const char*) * MP_SYMBOL_PAGE_SIZE);
+		(*page)[count % MP_SYMBOL_PAGE_SIZE] = copy;
+
+		// The id goes in last, lookups read the hash and name after seeing it
+		table->hashes[i] = hash;
+		atomic_store_explicit(&table->ids[i], count + 1, memory_order_release);
+		atomic_store_explicit(&mp_symbols.len, count + 1, memory_order_release);
+		sym = count;
+	}
+
+	atomic_flag_clear_explicit(&mp_symbols.lock, memory_order_release);
+	return sym;
+}
+
+size_t mp_find_symbol(const char* name)
+{
+	return mp_find_symbol_len(name, strlen(name));
+}
+
+size_t mp_find_symbol_len(const char* name, size_t len)
+{
+	return mp_symbol_find(name, len, mp_symbol_hash(name, len));
+}
+
+size_t mp_scratch_symbol(const char* name, size_t len)
+{
+	// Interned names keep their symbol
+	const size_t hash = mp_symbol_hash(name, len);
+	const size_t sym = mp_symbol_find(name, len, hash);
+	if(sym != MP_SYMBOL_ERR) return sym;
+
+	// Keep the scratch table at most half full
+	if(mp_scratch.len * 2 >= mp_scratch.table_len)
+	{
+		free(mp_scratch.table);
+		mp_scratch.table_len = mp_scratch.table_len == 0 ? MP_SCRATCH_TABLE_INIT_SIZE : mp_scratch.table_len * 2;
+		mp_scratch.table = calloc(mp_scratch.table_len, sizeof(size_t));
+		for(size_t k = 0; k < mp_scratch.len; ++k)
+		{
+			const char* other = mp_scratch.names[k];
+			size_t i = mp_symbol_hash(other, strlen(other)) & (mp_scratch.table_len - 1);
+			while(mp_scratch.table[i] != 0) i = (i + 1) & (mp_scratch.table_len - 1);
+			mp_scratch.table[i] = k + 1;
+		}
+	}
+
+	// Look for an existing scratch symbol
+	const size_t mask = mp_scratch.table_len - 1;
+	size_t i = hash & mask;
+	for(; mp_scratch.table[i] != 0; i = (i + 1) & mask)
+	{
+		const char* other = mp_scratch.names[mp_scratch.table[i] - 1];
+		if(strncmp(other, name, len) == 0 && other[len] == '\0') return MP_SYMBOL_MAX + mp_scratch.table[i] - 1;
+	}
+	if(mp_scratch.len == MP_SYMBOL_MAX) return MP_SYMBOL_ERR;
+
+	// Add a new one
+	if(mp_scratch.len == mp_scratch.allocated)
+	{
+		mp_scratch.allocated = mp_scratch.allocated == 0 ? MP_SCRATCH_TABLE_INIT_SIZE : mp_scratch.allocated * 2;
+		mp_scratch.names = realloc(mp_scratch.names, sizeof(char*) * mp_scratch.allocated);
+	}
+	char* copy = malloc(len + 1);
+	memcpy(copy, name, len);
+	copy[len] = '\0';
+	mp_scratch.names[mp_scratch.len] = copy;
+	mp_scratch.table[i] = mp_scratch.len + 1;
+
+	return MP_SYMBOL_MAX + mp_scratch.len++;
+}
+
+void mp_clear_scratch_symbols()
+{
+	for(size_t i = 0; i < mp_scratch.len; ++i)
+		free(mp_scratch.names[i]);
+	free(mp_scratch.names);
+	free(mp_scratch.table);
+	memset(&mp_scratch, 0, sizeof(mp_scratch));
+}
+
+const char* mp_symbol_name(size_t sym)
+{
+	if(sym >= MP_SYMBOL_MAX) return mp_scratch.names[sym - MP_SYMBOL_MAX];
+	return mp_symbols.pages[sym / MP_SYMBOL_PAGE_SIZE][sym % MP_SYMBOL_PAGE_SIZE];
+}
+
+size_t mp_symbol_count()
+{
+	return atomic_load_explicit(&mp_symbols.len, memory_order_acquire);
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef MP_SYMBOLS_H
+#define MP_SYMBOLS_H
+
+/**
+ * Global symbol table. Every variable and function name is interned once
+ * and referred to by a small integer id afterwards, so identical names
+ * share storage and names compare with integer equality.
+ * Safe to use from any thread. Looking up names which already exist
+ * doesn't lock.
+ *
+ * Names from untrusted input (See mp_set_lexer_scratch) can be given
+ * scratch symbols instead, which only live on the calling thread until
+ * mp_clear_scratch_symbols, so clients can't fill the table.
+ */
+
+/** Includes. */
+#include "stddef.h"
+
+/** Value returned when a symbol can't be found or created. */
+#define MP_SYMBOL_ERR ((size_t)-1)
+
+/** Maximum number of symbols. Scratch symbols are numbered from here on. */
+#define MP_SYMBOL_MAX (1 << 22)
+
+/**
+ * Intern a name.
+ * @param Name. (Copied if the name is new)
+ * @return Symbol id, or MP_SYMBOL_ERR if the table is full.
+ */
+extern size_t mp_intern(const char* name);
+
+/**
+ * Intern a name which isn't null terminated.
+ * @param Name.
+ * @param Length of the name.
+ * @return Symbol id, or MP_SYMBOL_ERR if the table is full.
+ */
+extern size_t mp_intern_len(const char* name, size_t len);
+
+/**
+ * Find the symbol of a name without interning it.
+ * @param Name.
+ * @return Symbol id, or MP_SYMBOL_ERR if the name was never interned.
+ */
+extern size_t mp_find_symbol(const char* name);
+
+/**
+ * Find the symbol of a name which isn't null terminated, without interning it.
+ * @param Name.
+ * @param Length of the name.
+ * @return Symbol id, or MP_SYMBOL_ERR if the name was never interned.
+ */
+extern size_t mp_find_symbol_len(const char* name, size_t len);
+
+/**
+ * Get the symbol of a name without adding it to the table. Interned names
+ * keep their symbol, any other name gets a scratch symbol (MP_SYMBOL_MAX
+ * or more) owned by the calling thread.
+ * @param Name.
+ * @param Length of the name.
+ * @return Symbol id, or MP_SYMBOL_ERR if the thread has too many scratch symbols.
+ * @note Scratch symbols are only valid on the calling thread, until mp_clear_scratch_symbols.
+ */
+extern size_t mp_scratch_symbol(const char* name, size_t len);
+
+/**
+ * Forget every scratch symbol of the calling thread, freeing their names.
+ */
+extern void mp_clear_scratch_symbols();
+
+/**
+ * Get the name of a symbol.
+ * @param Symbol id.
+ * @return Name. (Valid for the rest of the program, or until mp_clear_scratch_symbols for scratch symbols)
+ */
+extern const char* mp_symbol_name(size_t sym);
+
+/**
+ * Get the number of symbols interned so far.
+ * @return Number of symbols.
+ */
+extern size_t mp_symbol_count();
+#endif
@@ -0,0 +1,680 @@
+/** Includes. */
+#include "string.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "stdatomic.h"
+#include "math.h"
+#include "parser.h"
+#include "math_funcs.h"
+#include "symbols.h"
+#include "program.h"
+#include "tiered.h"
+
+#ifdef __unix__
+#include "pthread.h"
+#define MP_TIER_THREADS
+#endif
+
+// Interpreted instruction
+typedef struct
+{
+	/** Operation. (One of the MP_TOKEN_* values) */
+	int op;
+
+	/** Number of operands popped from the value stack. */
+	size_t argc;
+
+	/** Variable slot of a variable, or function index of a function call. */
+	size_t index;
+
+	/** Value of a number. */
+	double val;
+
+} mp_tier_op;
+
+// Specialized step
+typedef struct mp_tier_step
+{
+	/** Step implementation. */
+	void (*run)(const struct mp_tier_step* s);
+
+	/** Register receiving the result. */
+	double* dst;
+
+	/** Operand registers. */
+	const double* args[MP_NODE_MAX_ARGS];
+
+	/** Called function. */
+	const mp_func* func;
+
+} mp_tier_step;
+
+// Tiered expression
+struct mp_tiered
+{
+	/** Tiering policy. */
+	mp_tier_policy policy;
+
+	/** Tokens in polish notation, kept to build the optimized tier. */
+	token* tokens;
+
+	/** Number of tokens. */
+	size_t token_len;
+
+	/** Literals of the number tokens. (Indexed by token, not the parser's pool) */
+	double* literals;
+
+	/** Symbol ids of the variables, indexed by slot. */
+	size_t* vars;
+
+	/** Number of variables. */
+	size_t var_len;
+
+	/** Interpreted instructions. */
+	mp_tier_op* ops;
+
+	/** Number of interpreted instructions. */
+	size_t op_len;
+
+	/** Value stack of the interpreter. */
+	double* stack;
+
+	/** Optimized program. */
+	mp_program* prog;
+
+	/** Registers of the optimized program, one per node. */
+	double* regs;
+
+	/** Specialized steps. */
+	mp_tier_step* steps;
+
+	/** Number of specialized steps. */
+	size_t step_len;
+
+	/** Registers of the specialized steps, one per node of the optimized program. */
+	double* step_regs;
+
+	/** Register receiving each variable in the specialized tier, or NULL if it is unused. */
+	double** var_regs;
+
+	/** Register holding the result of the specialized tier. */
+	const double* result;
+
+	/** Current tier. Stored after the data of the tier is ready. */
+	_Atomic int tier;
+
+	/** Number of executions. */
+	_Atomic size_t executions;
+
+	/** Set while a tier is being built in the background. */
+	_Atomic char building;
+
+#ifdef MP_TIER_THREADS
+	/** Background thread building a tier. */
+	pthread_t thread;
+
+	/** Set if the background thread hasn't been joined. */
+	char joinable;
+
+	/** Tier the background thread is building. */
+	int target;
+#endif
+};
+
+mp_tier_policy mp_tier_default_policy()
+{
+	mp_tier_policy policy;
+	policy.optimize_threshold = MP_TIER_OPTIMIZE_THRESHOLD;
+	policy.specialize_threshold = MP_TIER_SPECIALIZE_THRESHOLD;
+	policy.max_tier = MP_TIER_SPECIALIZED;
+	policy.background = 0;
+	return policy;
+}
+
+/**
+ * Find the slot of a variable, adding it if it's new.
+ * @param Expression.
+ * @param Symbol id of the variable name.
+ * @return Variable slot.
+ * @note Slots are handed out in order of first use, like mp_program_add_tokens does.
+ */
+static size_t mp_tiered_var_slot(mp_tiered* expr, size_t sym)
+{
+	for(size_t i = 0; i < expr->var_len; ++i)
+		if(expr->vars[i] == sym)
+			return i;
+
+	expr->vars = realloc(expr->vars, sizeof(size_t) * (expr->var_len + 1));
+	expr->vars[expr->var_len] = sym;
+
+	return expr->var_len++;
+}
+
+mp_tiered* mp_tiered_create(const char* str, const mp_tier_policy* policy)
+{
+	// Lex the expression into the parser
+	if(!mp_lex_string(str)) return NULL;
+
+	// Get the expression in polish notation
+	size_t len;
+	const token* tokens = mp_get_polish_tokens(&len);
+
+	// Compile the tokens
+	mp_tiered* expr = mp_tiered_create_tokens(tokens, len, mp_get_parser_literals(), policy);
+
+	mp_flush_parser_tokens();
+	return expr;
+}
+
+mp_tiered* mp_tiered_create_tokens(
+	const token* tokens, 
+	size_t len, 
+	const double* literals, 
+	const mp_tier_policy* policy
+)
+{
+	mp_tiered* expr = calloc(1, sizeof(mp_tiered));
+	expr->policy = policy != NULL ? *policy : mp_tier_default_policy();
+	expr->ops = malloc(sizeof(mp_tier_op) * (len + 1));
+	expr->stack = malloc(sizeof(double) * (len + 1));
+	atomic_init(&expr->tier, MP_TIER_INTERPRETED);
+	atomic_init(&expr->executions, 0);
+	atomic_init(&expr->building, 0);
+
+	// Copy the tokens, moving their literals out of the parser's pool
+	expr->tokens = malloc(sizeof(token) * (len + 1));
+	expr->literals = malloc(sizeof(double) * (len + 1));
+	expr->token_len = len;
+	for(size_t i = 0; i < len; ++i)
+	{
+		expr->tokens[i] = tokens[i];
+		if(tokens[i].id == MP_TOKEN_NUM)
+		{
+			expr->literals[i] = literals[tokens[i].index];
+			expr->tokens[i].index = (uint32_t)i;
+		}
+	}
+
+	// Convert the tokens into instructions, tracking the stack depth
+	size_t depth = 0;
+	for(size_t i = 0; i < len; ++i)
+	{
+		mp_tier_op op;
+		memset(&op, 0, sizeof(op));
+		op.op = tokens[i].id;
+
+		switch(tokens[i].id)
+		{
+		case MP_TOKEN_NUM:
+			op.val = expr->literals[i];
+			break;
+
+		case MP_TOKEN_VAR:
+			op.index = mp_tiered_var_slot(expr, tokens[i].index);
+			break;
+
+		case MP_TOKEN_NEG:
+			op.argc = 1;
+			break;
+
+		case MP_TOKEN_ADD:
+		case MP_TOKEN_SUB:
+		case MP_TOKEN_MUL:
+		case MP_TOKEN_DIV:
+		case MP_TOKEN_EXP:
+		case MP_TOKEN_LT:
+		case MP_TOKEN_LE:
+		case MP_TOKEN_GT:
+		case MP_TOKEN_GE:
+		case MP_TOKEN_EQ:
+		case MP_TOKEN_NE:
+		case MP_TOKEN_AND:
+		case MP_TOKEN_OR:
+			op.argc = 2;
+			break;
+
+		// Ternary conditions are resolved by the alternative
+		case MP_TOKEN_QST:
+			continue;
+
+		case MP_TOKEN_COL:
+			op.argc = 3;
+			break;
+
+		case MP_TOKEN_FUN:
+			op.argc = (size_t)tokens[i].argc;
+			op.index = mp_find_func_symbol(tokens[i].index, op.argc);
+			if(op.index == MP_FUNC_ERR || op.argc > MP_NODE_MAX_ARGS) goto create_failure;
+
+			// Reductions need every row at once (See mp_program_eval_broadcast)
+			if(mp_funcs[op.index].rfunc != NULL) goto create_failure;
+			break;
+
+		default:
+			goto create_failure;
+		}
+
+		// Every operation leaves one value on the stack
+		if(depth < op.argc) goto create_failure;
+		depth = depth - op.argc + 1;
+		expr->ops[expr->op_len++] = op;
+	}
+
+	// A well formed expression leaves exactly one value
+	if(depth != 1) goto create_failure;
+	return expr;
+
+	// Failure jump point
+	create_failure:
+	mp_tiered_destroy(expr);
+	return NULL;
+}
+
+#ifdef MP_TIER_THREADS
+/**
+ * Wait for a background promotion to finish.
+ * @param Expression.
+ */
+static void mp_tiered_join(mp_tiered* expr)
+{
+	if(!expr->joinable) return;
+	pthread_join(expr->thread, NULL);
+	expr->joinable = 0;
+}
+#endif
+
+void mp_tiered_destroy(mp_tiered* expr)
+{
+#ifdef MP_TIER_THREADS
+	mp_tiered_join(expr);
+#endif
+
+	if(expr->prog != NULL) mp_program_destroy(expr->prog);
+	free(expr->tokens);
+	free(expr->literals);
+	free(expr->vars);
+	free(expr->ops);
+	free(expr->stack);
+	free(expr->regs);
+	free(expr->steps);
+	free(expr->step_regs);
+	free(expr->var_regs);
+	free(expr);
+}
+
+size_t mp_tiered_var_count(const mp_tiered* expr)
+{
+	return expr->var_len;
+}
+
+const char* mp_tiered_var_name(const mp_tiered* expr, size_t slot)
+{
+	return mp_symbol_name(expr->vars[slot]);
+}
+
+int mp_tiered_tier(const mp_tiered* expr)
+{
+	return atomic_load_explicit(&expr->tier, memory_order_acquire);
+}
+
+size_t mp_tiered_executions(const mp_tiered* expr)
+{
+	return atomic_load_explicit(&expr->executions, memory_order_relaxed);
+}
+
+// Specialized step implementations
+static void mp_step_neg(const mp_tier_step* s) { *s->dst = -*s->args[0]; }
+static void mp_step_add(const mp_tier_step* s) { *s->dst = *s->args[0] + *s->args[1]; }
+static void mp_step_sub(const mp_tier_step* s) { *s->dst = *s->args[0] - *s->args[1]; }
+static void mp_step_mul(const mp_tier_step* s) { *s->dst = *s->args[0] * *s->args[1]; }
+static void mp_step_div(const mp_tier_step* s) { *s->dst = *s->args[0] / *s->args[1]; }
+static void mp_step_pow(const mp_tier_step* s) { *s->dst = pow(*s->args[0], *s->args[1]); }
+static void mp_step_lt(const mp_tier_step* s) { *s->dst = *s->args[0] < *s->args[1]; }
+static void mp_step_le(const mp_tier_step* s) { *s->dst = *s->args[0] <= *s->args[1]; }
+static void mp_step_gt(const mp_tier_step* s) { *s->dst = *s->args[0] > *s->args[1]; }
+static void mp_step_ge(const mp_tier_step* s) { *s->dst = *s->args[0] >= *s->args[1]; }
+static void mp_step_eq(const mp_tier_step* s) { *s->dst = *s->args[0] == *s->args[1]; }
+static void mp_step_ne(const mp_tier_step* s) { *s->dst = *s->args[0] != *s->args[1]; }
+static void mp_step_and(const mp_tier_step* s) { *s->dst = *s->args[0] != 0.0 && *s->args[1] != 0.0; }
+static void mp_step_or(const mp_tier_step* s) { *s->dst = *s->args[0] != 0.0 || *s->args[1] != 0.0; }
+static void mp_step_sel(const mp_tier_step* s) { *s->dst = *s->args[0] != 0.0 ? *s->args[1] : *s->args[2]; }
+static void mp_step_fun1(const mp_tier_step* s) { *s->dst = s->func->func(s->args[0]); }
+
+// Fused multiply-adds (a * b + c, c + a * b, a * b - c, c - a * b)
+static void mp_step_mul_add(const mp_tier_step* s) { *s->dst = *s->args[0] * *s->args[1] + *s->args[2]; }
+static void mp_step_add_mul(const mp_tier_step* s) { *s->dst = *s->args[2] + *s->args[0] * *s->args[1]; }
+static void mp_step_mul_sub(const mp_tier_step* s) { *s->dst = *s->args[0] * *s->args[1] - *s->args[2]; }
+static void mp_step_sub_mul(const mp_tier_step* s) { *s->dst = *s->args[2] - *s->args[0] * *s->args[1]; }
+
+static void mp_step_fma(const mp_tier_step* s) { *s->dst = MP_FMA(*s->args[0], *s->args[1], *s->args[2]); }
+
+static void mp_step_fun(const mp_tier_step* s)
+{
+	double args[MP_NODE_MAX_ARGS];
+	for(size_t i = 0; i < s->func->argc; ++i)
+		args[i] = *s->args[i];
+	*s->dst = s->func->func(args);
+}
+
+/**
+ * Build the optimized tier.
+ * @param Expression.
+ */
+static void mp_tiered_build_optimized(mp_tiered* expr)
+{
+	mp_program* prog = mp_program_create();
+	mp_program_add_tokens(prog, expr->tokens, expr->token_len, expr->literals);
+	expr->prog = mp_program_optimize(prog);
+	expr->regs = calloc(expr->prog->len + 1, sizeof(double));
+	mp_program_destroy(prog);
+}
+
+/**
+ * Build the specialized tier from the optimized program.
+ * @param Expression.
+ */
+static void mp_tiered_build_specialized(mp_tiered* expr)
+{
+	const mp_program* prog = expr->prog;
+	double* regs = malloc(sizeof(double) * (prog->len + 1));
+	double** var_regs = calloc(expr->var_len + 1, sizeof(double*));
+	mp_tier_step* steps = malloc(sizeof(mp_tier_step) * (prog->len + 1));
+	size_t step_len = 0;
+
+	// Count the users of every node
+	size_t* uses = calloc(prog->len + 1, sizeof(size_t));
+	for(size_t i = 0; i < prog->len; ++i)
+		for(size_t j = 0; j < mp_node_argc(&prog->nodes[i]); ++j)
+			++uses[prog->nodes[i].args[j]];
+	++uses[prog->outputs[0]];
+
+	// Operand of every sum or difference which is a product only it uses, or MP_PROGRAM_ERR.
+	// Those products are fused into the sum or difference instead of getting a step.
+	size_t* fused = malloc(sizeof(size_t) * (prog->len + 1));
+	char* skip = calloc(prog->len + 1, 1);
+	for(size_t i = 0; i < prog->len; ++i)
+	{
+		const mp_node* n = &prog->nodes[i];
+		fused[i] = MP_PROGRAM_ERR;
+		if(n->op != MP_TOKEN_ADD && n->op != MP_TOKEN_SUB) continue;
+
+		for(size_t j = 0; j < 2 && fused[i] == MP_PROGRAM_ERR; ++j)
+		{
+			const size_t arg = n->args[j];
+			if(prog->nodes[arg].op == MP_TOKEN_MUL && uses[arg] == 1)
+			{
+				fused[i] = j;
+				skip[arg] = 1;
+			}
+		}
+	}
+
+	for(size_t i = 0; i < prog->len; ++i)
+	{
+		const mp_node* n = &prog->nodes[i];
+		if(skip[i]) continue;
+
+		mp_tier_step s;
+		memset(&s, 0, sizeof(s));
+		s.dst = &regs[i];
+		for(size_t j = 0; j < mp_node_argc(n); ++j)
+			s.args[j] = &regs[n->args[j]];
+
+		switch(n->op)
+		{
+		// Constants are loaded once
+		case MP_TOKEN_NUM:
+			regs[i] = n->val;
+			continue;
+
+		// Variables are copied straight into their register
+		case MP_TOKEN_VAR:
+			var_regs[n->slot] = &regs[i];
+			continue;
+
+		case MP_TOKEN_ADD:
+		case MP_TOKEN_SUB:
+			if(fused[i] != MP_PROGRAM_ERR)
+			{
+				const mp_node* mul = &prog->nodes[n->args[fused[i]]];
+				s.args[0] = &regs[mul->args[0]];
+				s.args[1] = &regs[mul->args[1]];
+				s.args[2] = &regs[n->args[1 - fused[i]]];
+				if(n->op == MP_TOKEN_ADD) s.run = fused[i] == 0 ? mp_step_mul_add : mp_step_add_mul;
+				else s.run = fused[i] == 0 ? mp_step_mul_sub : mp_step_sub_mul;
+			}
+			else s.run = n->op == MP_TOKEN_ADD ? mp_step_add : mp_step_sub;
+			break;
+
+		case MP_TOKEN_NEG: s.run = mp_step_neg; break;
+		case MP_TOKEN_MUL: s.run = mp_step_mul; break;
+		case MP_TOKEN_DIV: s.run = mp_step_div; break;
+		case MP_TOKEN_EXP: s.run = mp_step_pow; break;
+		case MP_TOKEN_LT: s.run = mp_step_lt; break;
+		case MP_TOKEN_LE: s.run = mp_step_le; break;
+		case MP_TOKEN_GT: s.run = mp_step_gt; break;
+		case MP_TOKEN_GE: s.run = mp_step_ge; break;
+		case MP_TOKEN_EQ: s.run = mp_step_eq; break;
+		case MP_TOKEN_NE: s.run = mp_step_ne; break;
+		case MP_TOKEN_AND: s.run = mp_step_and; break;
+		case MP_TOKEN_OR: s.run = mp_step_or; break;
+		case MP_TOKEN_COL: s.run = mp_step_sel; break;
+		case MP_NODE_FMA: s.run = mp_step_fma; break;
+
+		// Single argument functions read their operand register in place
+		case MP_TOKEN_FUN:
+			s.func = &mp_funcs[n->slot];
+			s.run = s.func->argc == 1 ? mp_step_fun1 : mp_step_fun;
+			break;
+		}
+
+		steps[step_len++] = s;
+	}
+
+	expr->steps = steps;
+	expr->step_len = step_len;
+	expr->step_regs = regs;
+	expr->var_regs = var_regs;
+	expr->result = &regs[prog->outputs[0]];
+	free(uses);
+	free(fused);
+	free(skip);
+}
+
+/**
+ * Build a tier and make it current.
+ * @param Expression.
+ * @param Tier to build. Must be one above the current tier.
+ */
+static void mp_tiered_build(mp_tiered* expr, int tier)
+{
+	if(tier == MP_TIER_OPTIMIZED) mp_tiered_build_optimized(expr);
+	else mp_tiered_build_specialized(expr);
+	atomic_store_explicit(&expr->tier, tier, memory_order_release);
+}
+
+#ifdef MP_TIER_THREADS
+/**
+ * Background promotion thread.
+ * @param Expression.
+ * @return NULL.
+ */
+static void* mp_tiered_thread(void* arg)
+{
+	mp_tiered* expr = arg;
+	mp_tiered_build(expr, expr->target);
+	atomic_store_explicit(&expr->building, 0, memory_order_release);
+	return NULL;
+}
+#endif
+
+/**
+ * Promote an expression by one tier following its policy.
+ * @param Expression.
+ * @param Tier to promote to.
+ */
+static void mp_tiered_request(mp_tiered* expr, int tier)
+{
+#ifdef MP_TIER_THREADS
+	if(expr->policy.background)
+	{
+		// Let a running promotion finish first
+		if(atomic_load_explicit(&expr->building, memory_order_acquire)) return;
+		mp_tiered_join(expr);
+
+		// The thread might have just built the requested tier
+		if(mp_tiered_tier(expr) >= tier) return;
+
+		expr->target = tier;
+		atomic_store_explicit(&expr->building, 1, memory_order_relaxed);
+		if(pthread_create(&expr->thread, NULL, mp_tiered_thread, expr) == 0)
+		{
+			expr->joinable = 1;
+			return;
+		}
+
+		// Build in the foreground if no thread could be started
+		atomic_store_explicit(&expr->building, 0, memory_order_relaxed);
+	}
+#endif
+
+	mp_tiered_build(expr, tier);
+}
+
+void mp_tiered_promote(mp_tiered* expr, int tier)
+{
+#ifdef MP_TIER_THREADS
+	mp_tiered_join(expr);
+#endif
+
+	if(tier > expr->policy.max_tier) tier = expr->policy.max_tier;
+	for(int next = mp_tiered_tier(expr) + 1; next <= tier; ++next)
+		mp_tiered_build(expr, next);
+}
+
+/**
+ * Evaluate an expression by interpreting its instructions.
+ * @param Expression.
+ * @param Variable values, indexed by slot.
+ * @return Result.
+ */
+static double mp_tiered_eval_interpreted(mp_tiered* expr, const double* vars)
+{
+	double* stack = expr->stack;
+	size_t len = 0;
+
+	for(size_t i = 0; i < expr->op_len; ++i)
+	{
+		const mp_tier_op* op = &expr->ops[i];
+		double* args = &stack[len - op->argc];
+
+		switch(op->op)
+		{
+		case MP_TOKEN_NUM: stack[len] = op->val; break;
+		case MP_TOKEN_VAR: stack[len] = vars[op->index]; break;
+		case MP_TOKEN_NEG: args[0] = -args[0]; break;
+		case MP_TOKEN_ADD: args[0] = args[0] + args[1]; break;
+		case MP_TOKEN_SUB: args[0] = args[0] - args[1]; break;
+		case MP_TOKEN_MUL: args[0] = args[0] * args[1]; break;
+		case MP_TOKEN_DIV: args[0] = args[0] / args[1]; break;
+		case MP_TOKEN_EXP: args[0] = pow(args[0], args[1]); break;
+		case MP_TOKEN_LT: args[0] = args[0] < args[1]; break;
+		case MP_TOKEN_LE: args[0] = args[0] <= args[1]; break;
+		case MP_TOKEN_GT: args[0] = args[0] > args[1]; break;
+		case MP_TOKEN_GE: args[0] = args[0] >= args[1]; break;
+		case MP_TOKEN_EQ: args[0] = args[0] == args[1]; break;
+		case MP_TOKEN_NE: args[0] = args[0] != args[1]; break;
+		case MP_TOKEN_AND: args[0] = args[0] != 0.0 && args[1] != 0.0; break;
+		case MP_TOKEN_OR: args[0] = args[0] != 0.0 || args[1] != 0.0; break;
+		case MP_TOKEN_COL: args[0] = args[0] != 0.0 ? args[1] : args[2]; break;
+		case MP_TOKEN_FUN: args[0] = mp_funcs[op->index].func(args); break;
+		}
+
+		len = len - op->argc + 1;
+	}
+
+	return stack[0];
+}
+
+/**
+ * Evaluate an expression through its optimized program.
+ * @param Expression.
+ * @param Variable values, indexed by slot.
+ * @return Result.
+ */
+static double mp_tiered_eval_optimized(mp_tiered* expr, const double* vars)
+{
+	const mp_program* prog = expr->prog;
+	double* regs = expr->regs;
+
+	for(size_t i = 0; i < prog->len; ++i)
+	{
+		const mp_node* n = &prog->nodes[i];
+		const double a = regs[n->args[0]];
+		const double b = regs[n->args[1]];
+
+		switch(n->op)
+		{
+		case MP_TOKEN_NUM: regs[i] = n->val; break;
+		case MP_TOKEN_VAR: regs[i] = vars[n->slot]; break;
+		case MP_TOKEN_NEG: regs[i] = -a; break;
+		case MP_TOKEN_ADD: regs[i] = a + b; break;
+		case MP_TOKEN_SUB: regs[i] = a - b; break;
+		case MP_TOKEN_MUL: regs[i] = a * b; break;
+		case MP_TOKEN_DIV: regs[i] = a / b; break;
+		case MP_TOKEN_COL: regs[i] = a != 0.0 ? b : regs[n->args[2]]; break;
+
+		// Everything else is less common
+		default:
+			{
+				double args[MP_NODE_MAX_ARGS];
+				for(size_t j = 0; j < mp_node_argc(n); ++j)
+					args[j] = regs[n->args[j]];
+				regs[i] = mp_node_apply(n, args);
+			}
+			break;
+		}
+	}
+
+	return regs[prog->outputs[0]];
+}
+
+/**
+ * Evaluate an expression through its specialized steps.
+ * @param Expression.
+ * @param Variable values, indexed by slot.
+ * @return Result.
+ */
+static double mp_tiered_eval_specialized(mp_tiered* expr, const double* vars)
+{
+	for(size_t i = 0; i < expr->var_len; ++i)
+		if(expr->var_regs[i] != NULL)
+			*expr->var_regs[i] = vars[i];
+
+	const mp_tier_step* steps = expr->steps;
+	for(size_t i = 0; i < expr->step_len; ++i)
+		steps[i].run(&steps[i]);
+
+	return *expr->result;
+}
+
+double mp_tiered_eval(mp_tiered* expr, const double* vars)
+{
+	const size_t executions = atomic_fetch_add_explicit(&expr->executions, 1, memory_order_relaxed) + 1;
+	const int tier = mp_tiered_tier(expr);
+
+	// Promote the expression once it has run often enough
+	if(tier < expr->policy.max_tier)
+	{
+		const size_t threshold = tier == MP_TIER_INTERPRETED ?
+			expr->policy.optimize_threshold : expr->policy.specialize_threshold;
+		if(executions >= threshold) mp_tiered_request(expr, tier + 1);
+	}
+
+	switch(tier)
+	{
+	case MP_TIER_OPTIMIZED: return mp_tiered_eval_optimized(expr, vars);
+	case MP_TIER_SPECIALIZED: return mp_tiered_eval_specialized(expr, vars);
+	default: return mp_tiered_eval_interpreted(expr, vars);
+	}
+}
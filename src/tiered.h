@@ -0,0 +1,142 @@
+#ifndef MP_TIERED_H
+#define MP_TIERED_H
+
+/**
+ * Tiered expressions. An expression starts out cheap to create and is
+ * promoted to representations which are more expensive to build, but
+ * faster to run, once it has been executed often enough:
+ *  - MP_TIER_INTERPRETED interprets the polish notation tokens directly.
+ *  - MP_TIER_OPTIMIZED evaluates an optimized expression graph. (See mp_program_optimize)
+ *  - MP_TIER_SPECIALIZED runs a chain of specialized steps with operands
+ *    bound to registers, constants preloaded and multiply-adds merged
+ *    into single steps. (Still a multiply and an add, not fma)
+ * Every tier performs the same operations in the same order, so they
+ * produce the same results as long as the compiler doesn't contract
+ * a * b + c into a fused multiply-add. (The build disables contraction)
+ *
+ * Tiered expressions suit callers which evaluate the same expression many
+ * times one call at a time. The server keeps one per formula each worker
+ * has seen (See server.h); the REPL, scripts and CSV evaluation compile
+ * programs instead.
+ */
+
+/** Includes. */
+#include "stddef.h"
+#include "lexer.h"
+
+// Tiers
+#define MP_TIER_INTERPRETED 0
+#define MP_TIER_OPTIMIZED 1
+#define MP_TIER_SPECIALIZED 2
+
+/** Default number of executions before an expression is optimized. */
+#define MP_TIER_OPTIMIZE_THRESHOLD 16
+
+/** Default number of executions before an expression is specialized. */
+#define MP_TIER_SPECIALIZE_THRESHOLD 1024
+
+// Tiering policy
+typedef struct
+{
+	/** Number of executions before promotion to MP_TIER_OPTIMIZED. */
+	size_t optimize_threshold;
+
+	/** Number of executions before promotion to MP_TIER_SPECIALIZED. */
+	size_t specialize_threshold;
+
+	/** Highest tier the expression may be promoted to. */
+	int max_tier;
+
+	/** Build promoted tiers on a background thread instead of during evaluation. */
+	char background;
+
+} mp_tier_policy;
+
+// Tiered expression
+typedef struct mp_tiered mp_tiered;
+
+/**
+ * Get the default tiering policy.
+ * @return Policy promoting through every tier in the foreground.
+ */
+extern mp_tier_policy mp_tier_default_policy();
+
+/**
+ * Compile an expression at the interpreted tier.
+ * @param Expression string.
+ * @param Tiering policy, or NULL for the default policy.
+ * @return New expression, or NULL if the expression is invalid.
+ * @note Uses the parser's token queue, so the parser must be initialized.
+ * @note Must be destroyed with mp_tiered_destroy.
+ */
+extern mp_tiered* mp_tiered_create(const char* str, const mp_tier_policy* policy);
+
+/**
+ * Compile an expression in polish notation at the interpreted tier.
+ * @param Tokens in polish notation. (Copied)
+ * @param Number of tokens.
+ * @param Literal pool the number tokens index. (Copied, see mp_get_parser_literals)
+ * @param Tiering policy, or NULL for the default policy.
+ * @return New expression, or NULL if the expression is invalid.
+ */
+extern mp_tiered* mp_tiered_create_tokens(
+	const token* tokens, 
+	size_t len, 
+	const double* literals, 
+	const mp_tier_policy* policy
+);
+
+/**
+ * Destroy an expression, waiting for any background promotion to finish.
+ * @param Expression.
+ */
+extern void mp_tiered_destroy(mp_tiered* expr);
+
+/**
+ * Get the number of variables an expression references.
+ * @param Expression.
+ * @return Number of variable slots.
+ */
+extern size_t mp_tiered_var_count(const mp_tiered* expr);
+
+/**
+ * Get the name of a variable slot.
+ * @param Expression.
+ * @param Variable slot.
+ * @return Variable name.
+ */
+extern const char* mp_tiered_var_name(const mp_tiered* expr, size_t slot);
+
+/**
+ * Evaluate an expression, counting the execution and promoting the
+ * expression when the policy says so.
+ * @param Expression.
+ * @param Variable values, indexed by slot.
+ * @return Result.
+ * @note An expression must only be evaluated by one thread at a time.
+ */
+extern double mp_tiered_eval(mp_tiered* expr, const double* vars);
+
+/**
+ * Promote an expression immediately, ignoring the thresholds of its policy.
+ * @param Expression.
+ * @param Tier to promote to. Lower tiers are ignored.
+ */
+extern void mp_tiered_promote(mp_tiered* expr, int tier);
+
+/**
+ * Get the tier an expression currently runs at.
+ * @param Expression.
+ * @return One of the MP_TIER_* values.
+ * @note Safe to call from any thread.
+ */
+extern int mp_tiered_tier(const mp_tiered* expr);
+
+/**
+ * Get the number of times an expression has been executed.
+ * @param Expression.
+ * @return Execution count.
+ * @note Safe to call from any thread.
+ */
+extern size_t mp_tiered_executions(const mp_tiered* expr);
+#endif